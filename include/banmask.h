@@ -0,0 +1,195 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BANMASK_H
+#define BANMASK_H
+
+#include "socket.h"
+
+/** A wildcard pattern which has been looked at once, so that the common
+ * shapes of pattern ("*", "text", "text*" and "*text") can be matched
+ * without walking the wildcard matcher. Matching never allocates.
+ */
+class CoreExport MatchPattern
+{
+ public:
+	enum PatternType
+	{
+		/** Matches anything */
+		PATTERN_ANY,
+		/** No wildcards, text must equal the string */
+		PATTERN_EXACT,
+		/** Pattern was "text*" */
+		PATTERN_PREFIX,
+		/** Pattern was "*text" */
+		PATTERN_SUFFIX,
+		/** Anything else, matched with InspIRCd::Match */
+		PATTERN_WILDCARD
+	};
+
+	/** The shape of the pattern */
+	PatternType type;
+
+	/** The pattern without its leading or trailing '*' for PATTERN_PREFIX and
+	 * PATTERN_SUFFIX, or the whole pattern for PATTERN_WILDCARD.
+	 */
+	std::string text;
+
+	MatchPattern() : type(PATTERN_ANY) { }
+
+	/** Compile a pattern, replacing the one held */
+	void Compile(const std::string& pattern);
+
+	/** Match a string against the pattern
+	 * @param str The string to match, which must be NUL terminated at str[len]
+	 * @param len Length of the string
+	 * @param map The case map to compare with
+	 */
+	bool Match(const char* str, size_t len, const unsigned char* map) const;
+
+	bool Match(const std::string& str, const unsigned char* map) const
+	{
+		return Match(str.c_str(), str.length(), map);
+	}
+};
+
+/** A nick!ident\@host mask split into its parts and compiled, with the host
+ * part also parsed as a CIDR range if it is one. Channel bans and X-lines
+ * are compiled into one of these when they are set, so that checking a user
+ * against them doesn't cut up or re-parse the mask every time.
+ */
+class CoreExport BanMask
+{
+ public:
+	/** Nick pattern. If the mask didn't have exactly one '!' before the '@'
+	 * this holds the whole nick!ident pattern and split is false.
+	 */
+	MatchPattern nick;
+
+	/** Ident pattern */
+	MatchPattern ident;
+
+	/** Host pattern */
+	MatchPattern host;
+
+	/** True if the mask had an '@' in it. Masks without one match nothing. */
+	bool valid;
+
+	/** True if nick and ident hold the two halves of nick!ident */
+	bool split;
+
+	/** True if the host part is an IP range, held in cidr */
+	bool iscidr;
+
+	/** The host part as an IP range, if iscidr is true */
+	irc::sockets::cidr_mask cidr;
+
+	BanMask() : valid(false), split(true), iscidr(false) { }
+
+	/** Compile a nick!ident\@host mask */
+	BanMask(const std::string& mask) : valid(false), split(true), iscidr(false) { Compile(mask); }
+
+	/** Compile a nick!ident\@host mask, replacing the one held */
+	void Compile(const std::string& mask);
+
+	/** Compile a mask given as its three parts, replacing the one held */
+	void Compile(const std::string& nickmask, const std::string& identmask, const std::string& hostmask);
+
+	/** Check a user against the mask the way channel bans do: nick!ident must
+	 * match, and the host part must match the user's host, displayed host or IP.
+	 * The national case map is used.
+	 */
+	bool Matches(User* user) const;
+
+	/** Check whether the host part matches an IP address, as a CIDR range or as a pattern
+	 * @param ip The address as a string
+	 * @param sa The same address in binary
+	 * @param map The case map to compare with
+	 */
+	bool MatchesIP(const char* ip, const irc::sockets::sockaddrs& sa, const unsigned char* map) const
+	{
+		return (iscidr && cidr.match(sa)) || host.Match(ip, strlen(ip), map);
+	}
+
+	/** Check whether the host part matches a user's real host or IP, the way X-lines do
+	 * @param user The user to check
+	 * @param map The case map to compare with
+	 */
+	bool MatchesHost(User* user, const unsigned char* map) const;
+};
+
+/** An index of a channel's ban list, so that checking a user doesn't have to
+ * try every ban. Bans with an exact host are found by a hash of the host, IP
+ * range bans by looking the user's address up at each prefix length in use,
+ * and only the rest are tried one by one. Entries are positions in the ban list.
+ */
+class CoreExport BanIndex
+{
+	/** The ban list generation this index was built for */
+	unsigned long generation;
+
+	/** The case map the host hashes were made with */
+	const unsigned char* casemap;
+
+	/** Bans with an exact host, by hash of the host, sorted */
+	std::vector<std::pair<size_t, size_t> > hosts;
+
+	/** IP range bans, sorted by range */
+	std::vector<std::pair<irc::sockets::cidr_mask, size_t> > ranges;
+
+	/** The address families and prefix lengths used in ranges, each once */
+	std::vector<std::pair<unsigned char, unsigned char> > prefixes;
+
+	/** Bans which can only be found by trying them */
+	std::vector<size_t> others;
+
+	/** Extbans, which only modules can match */
+	std::vector<size_t> extbans;
+
+	/** Hash a host, folding case with the case map the index was built with */
+	size_t HashHost(const char* str) const;
+
+ public:
+	BanIndex() : generation(0), casemap(NULL) { }
+
+	/** Check whether the index was built from the given ban list generation
+	 * and the case map still in use
+	 */
+	bool IsCurrent(unsigned long gen) const
+	{
+		return generation == gen && casemap == national_case_insensitive_map;
+	}
+
+	/** Rebuild the index from a ban list
+	 * @param bans The ban list
+	 * @param gen The generation of the ban list
+	 */
+	void Build(const BanList& bans, unsigned long gen);
+
+	/** Check whether any ban other than an extban matches a user, without
+	 * calling modules.
+	 * @param user The user to check
+	 * @param bans The ban list the index was built from
+	 */
+	bool Matches(User* user, const BanList& bans) const;
+
+	/** Get the positions of the extbans in the ban list */
+	const std::vector<size_t>& GetExtBans() const { return extbans; }
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/** Records the lines sent by local clients to a file, so that tools/replay
+ * can send the same traffic to a test server later.
+ *
+ * The file starts with the eight bytes "IRCCAP1\n", followed by records of the form
+ *	type	one byte: 'L' for a line from a client, 'Q' when a client's connection closes
+ *	delay	microseconds since the previous record
+ *	client	number of the client, counting from 1 in the order they were first seen
+ *	length	length of the line ('L' records only)
+ *	line	the line itself, without its CR LF ('L' records only)
+ * where delay, client and length are unsigned numbers in 7 bit groups, lowest first,
+ * with the top bit of each byte set if more groups follow.
+ *
+ * Passwords given to PASS, OPER and AUTHENTICATE are replaced with "*".
+ */
+class CoreExport TrafficCapture
+{
+	/** The file being written, or NULL if there is no capture running */
+	FILE* file;
+
+	/** The name of the file being written */
+	std::string filename;
+
+	/** Most bytes to write to the file, or 0 for no limit */
+	unsigned long limit;
+
+	/** Bytes written to the file so far */
+	unsigned long written;
+
+	/** Time the last record was written */
+	timespec last;
+
+	/** Number to give the next client seen */
+	unsigned long nextclient;
+
+	/** The number each client has been given. This is not an extension item
+	 * because those have to outlive the ExtensionManager.
+	 */
+	std::map<LocalUser*, unsigned long> clients;
+
+	/** Write the type, delay and client of a record; returns false if the file is full */
+	bool WriteRecord(char type, unsigned long client, size_t length);
+
+	/** Write a number in 7 bit groups */
+	void WriteNumber(unsigned long value);
+
+ public:
+	TrafficCapture();
+	~TrafficCapture();
+
+	/** Start a capture, replacing the file if it exists, and stop any capture already running
+	 * @param name The file to write to
+	 * @param maxbytes Most bytes to write, or 0 for no limit
+	 * @return True if the file was opened; if not, errno says why
+	 */
+	bool Start(const std::string& name, unsigned long maxbytes);
+
+	/** Stop the capture, if one is running */
+	void Stop();
+
+	/** Check whether a capture is running */
+	bool IsActive() const { return file != NULL; }
+
+	/** Get the name of the file being written, if a capture is running */
+	const std::string& GetFile() const { return filename; }
+
+	/** Record a line received from a client
+	 * @param user The client who sent it
+	 * @param line The line, without its CR LF
+	 */
+	void AddLine(LocalUser* user, const std::string& line);
+
+	/** Record that a client's connection has closed */
+	void AddQuit(LocalUser* user);
+};
+
+#endif
@@ -50,6 +50,10 @@ class HostItem
  */
 class BanItem : public HostItem
 {
+ public:
+	/** The ban compiled for matching, set from data when the ban is added
+	 */
+	BanMask mask;
 };
 
 /** Holds all relevent information for a channel.
@@ -66,6 +70,10 @@ class CoreExport Channel : public Extensible
 	 */
 	void SetDefaultModes();
 
+	/** Index of the ban list, rebuilt when it is next needed after the list changes
+	 */
+	BanIndex banindex;
+
 	/** Maximum number of bans (cached)
 	 */
 	int maxbans;
@@ -120,6 +128,15 @@ class CoreExport Channel : public Extensible
 	 */
 	BanList bans;
 
+	/** Changed whenever the ban list changes, so that the ban index and the
+	 * ban check results cached on each Membership can tell they are out of date
+	 */
+	unsigned long bangeneration;
+
+	/** Called after the ban list has been changed
+	 */
+	void BanListChanged() { bangeneration++; }
+
 	/** Sets or unsets a custom mode in the channels info
 	 * @param mode The mode character to set or unset
 	 * @param mode_on True if you want to set the mode or false if you want to remove it
@@ -385,6 +402,10 @@ class CoreExport Channel : public Extensible
 	 */
 	bool CheckBan(User* user, const std::string& banmask);
 
+	/** Check a single ban from the ban list for match, using its compiled mask
+	 */
+	bool CheckBan(User* user, const BanItem& ban);
+
 	/** Get the status of an "action" type extban
 	 */
 	ModResult GetExtBanStatus(User *u, char type);
@@ -91,6 +91,8 @@ class CommandWhowas : public Command
 	CmdResult Handle(const std::vector<std::string>& parameters, User *user);
 	void AddToWhoWas(User* user);
 	std::string GetStats();
+	/** Add the memory used by the whowas list to a report */
+	void AddMemoryUsage(MemoryReport& report);
 	void PruneWhoWas(time_t t);
 	void MaintainWhoWas(time_t t);
 	~CommandWhowas();
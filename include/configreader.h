@@ -407,6 +407,45 @@ class CoreExport ServerConfig
 	 */
 	int NetBufferSize;
 
+	/** The number of I/O threads which service registered
+	 * client sockets, or 0 to service them all from the
+	 * main thread. Only read on startup.
+	 */
+	int IOThreads;
+
+	/** True to count calls to each module's hooks and the
+	 * time spent in them, for /stats h
+	 */
+	bool ProfileHooks;
+
+	/** True if log files are written by a background thread
+	 */
+	bool LogThread;
+
+	/** The most bytes of log output which may wait for the log thread
+	 */
+	unsigned long LogQueue;
+
+	/** True to wait for the log thread when LogQueue is full,
+	 * rather than dropping log lines
+	 */
+	bool LogQueueBlock;
+
+	/** If one pass through the main loop takes longer than this many
+	 * milliseconds, not counting the wait for socket events, opers
+	 * are sent a notice saying where the time went; 0 to never send one
+	 */
+	int SlowLoop;
+
+	/** The file to record client traffic to, for tools/replay, or empty
+	 * to not record it
+	 */
+	std::string CaptureFile;
+
+	/** The most bytes to write to CaptureFile, or 0 for no limit
+	 */
+	unsigned long CaptureLimit;
+
 	/** The value to be used for listen() backlogs
 	 * as default.
 	 */
@@ -124,6 +124,14 @@ class CoreExport Command : public ServiceProvider
 	 */
 	long total_bytes;
 
+	/** Time taken by each call to Handle(), used by /stats M
+	 */
+	Histogram exec_time;
+
+	/** Bytes sent to local users while this command was being handled, used by /stats M
+	 */
+	unsigned long output_bytes;
+
 	/** True if the command is disabled to non-opers
 	 */
 	bool disabled;
@@ -159,7 +167,7 @@ class CoreExport Command : public ServiceProvider
 	 */
 	Command(Module* me, const std::string &cmd, int minpara = 0, int maxpara = 0) :
 		ServiceProvider(me, cmd, SERVICE_COMMAND), flags_needed(0), min_params(minpara), max_params(maxpara),
-		use_count(0), total_bytes(0), disabled(false), works_before_reg(false), Penalty(1)
+		use_count(0), total_bytes(0), output_bytes(0), disabled(false), works_before_reg(false), Penalty(1)
 	{
 	}
 
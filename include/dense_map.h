@@ -0,0 +1,136 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DENSE_MAP_H
+#define DENSE_MAP_H
+
+#include <functional>
+#include <vector>
+#include "flat_hash.h"
+
+namespace irc
+{
+	/** Hashes a pointer by its address */
+	struct PtrHash
+	{
+		size_t operator()(const void* p) const { return reinterpret_cast<size_t>(p); }
+	};
+
+	/** A map which keeps its entries packed together in a vector, so that going
+	 * through all of them reads memory in order, with an index from each key to
+	 * its place in the vector so that keys can still be found in constant time.
+	 *
+	 * Erasing an entry moves the last entry into its place. This keeps the
+	 * vector packed, but means that entries are in no particular order, and
+	 * that erasing while iterating skips the entry moved in unless the loop
+	 * goes backwards. Inserting or erasing invalidates iterators.
+	 */
+	template<typename Key, typename T, typename Hash = PtrHash>
+	class dense_map
+	{
+	 public:
+		typedef Key key_type;
+		typedef T mapped_type;
+		typedef std::pair<Key, T> value_type;
+		typedef typename std::vector<value_type>::iterator iterator;
+		typedef typename std::vector<value_type>::const_iterator const_iterator;
+		typedef size_t size_type;
+
+	 private:
+		/** The entries, in no particular order */
+		std::vector<value_type> entries;
+
+		/** Where each key is in entries */
+		flat_hash_map<size_t, Hash, std::equal_to<Key>, Key> index;
+
+	 public:
+		iterator begin() { return entries.begin(); }
+		iterator end() { return entries.end(); }
+		const_iterator begin() const { return entries.begin(); }
+		const_iterator end() const { return entries.end(); }
+
+		size_t size() const { return entries.size(); }
+		bool empty() const { return entries.empty(); }
+
+		iterator find(const Key& key)
+		{
+			typename flat_hash_map<size_t, Hash, std::equal_to<Key>, Key>::const_iterator i = index.find(key);
+			return i == index.end() ? entries.end() : entries.begin() + i->second;
+		}
+
+		const_iterator find(const Key& key) const
+		{
+			typename flat_hash_map<size_t, Hash, std::equal_to<Key>, Key>::const_iterator i = index.find(key);
+			return i == index.end() ? entries.end() : entries.begin() + i->second;
+		}
+
+		size_t count(const Key& key) const
+		{
+			return index.count(key);
+		}
+
+		std::pair<iterator, bool> insert(const value_type& value)
+		{
+			std::pair<typename flat_hash_map<size_t, Hash, std::equal_to<Key>, Key>::iterator, bool> added =
+				index.insert(std::make_pair(value.first, entries.size()));
+			if (!added.second)
+				return std::make_pair(entries.begin() + added.first->second, false);
+			entries.push_back(value);
+			return std::make_pair(entries.end() - 1, true);
+		}
+
+		T& operator[](const Key& key)
+		{
+			return insert(value_type(key, T())).first->second;
+		}
+
+		void erase(iterator i)
+		{
+			index.erase(i->first);
+			if (i != entries.end() - 1)
+			{
+				*i = entries.back();
+				index[i->first] = i - entries.begin();
+			}
+			entries.pop_back();
+		}
+
+		size_t erase(const Key& key)
+		{
+			iterator i = find(key);
+			if (i == entries.end())
+				return 0;
+			erase(i);
+			return 1;
+		}
+
+		void clear()
+		{
+			entries.clear();
+			index.clear();
+		}
+
+		/** Get the memory used by the entries and the index, beyond the map itself */
+		size_t GetMemory() const
+		{
+			return entries.capacity() * sizeof(value_type) + index.bucket_count() * (sizeof(size_t) + sizeof(std::pair<const Key, size_t>));
+		}
+	};
+}
+
+#endif
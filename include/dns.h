@@ -446,6 +446,12 @@ class CoreExport DNS : public EventHandler
 	 * items in the hash which are still valid.
 	 */
 	int PruneCache();
+
+	/** Count the memory used by the DNS cache, for /stats z
+	 * @param bytes Set to the approximate number of bytes used
+	 * @return The number of items in the cache
+	 */
+	unsigned long GetCacheUsage(size_t& bytes);
 };
 
 #endif
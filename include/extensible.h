@@ -34,6 +34,14 @@ enum SerializeFormat
 class CoreExport ExtensionItem : public ServiceProvider, public usecountbase
 {
  public:
+	/** Value of slot for an item which has not been given one yet */
+	static const size_t NO_SLOT = static_cast<size_t>(-1);
+
+	/** The index of this item's value in every Extensible, given out by the ExtensionManager
+	 * when the item is registered or first set, and handed back when the item is destroyed.
+	 */
+	size_t slot;
+
 	ExtensionItem(const std::string& key, Module* owner);
 	virtual ~ExtensionItem();
 	/** Serialize this item into a string
@@ -53,17 +61,17 @@ class CoreExport ExtensionItem : public ServiceProvider, public usecountbase
 	virtual void free(void* item) = 0;
 
  protected:
-	/** Get the item from the internal map */
-	void* get_raw(const Extensible* container) const;
-	/** Set the item in the internal map; returns old value */
+	/** Get the item from the object's slots */
+	inline void* get_raw(const Extensible* container) const;
+	/** Set the item in the object's slots; returns old value */
 	void* set_raw(Extensible* container, void* value);
-	/** Remove the item from the internal map; returns old value */
+	/** Remove the item from the object's slots; returns old value */
 	void* unset_raw(Extensible* container);
 };
 
 /** class Extensible is the parent class of many classes such as User and Channel.
  * class Extensible implements a system which allows modules to 'extend' the class by attaching data within
- * a map associated with the object. In this way modules can store their own custom information within user
+ * slots associated with the object. In this way modules can store their own custom information within user
  * objects, channel objects and server objects, without breaking other modules (this is more sensible than using
  * a flags variable, and each module defining bits within the flag as 'theirs' as it is less prone to conflict and
  * supports arbitary data storage).
@@ -71,7 +79,49 @@ class CoreExport ExtensionItem : public ServiceProvider, public usecountbase
 class CoreExport Extensible : public classbase
 {
  public:
-	typedef std::map<reference<ExtensionItem>,void*> ExtensibleStore;
+	/** The values held by an Extensible, indexed by the slot of the item each belongs to,
+	 * so that getting a value is a bounds check and an array read. Iterating gives the
+	 * item and value of each slot which holds a value; a NULL value is the same as none.
+	 */
+	class CoreExport ExtensibleStore
+	{
+		/** The value in each slot, up to the highest slot set on this object */
+		std::vector<void*> values;
+
+		friend class ExtensionItem;
+		friend class Extensible;
+
+	 public:
+		typedef std::pair<ExtensionItem*, void*> value_type;
+
+		class CoreExport const_iterator
+		{
+			const std::vector<void*>* values;
+			size_t slot;
+			value_type current;
+
+			/** Move on to the first slot at or after this one which holds a value */
+			void Skip();
+
+		 public:
+			const_iterator(const std::vector<void*>* v, size_t s) : values(v), slot(s) { Skip(); }
+			const value_type& operator*() const { return current; }
+			const value_type* operator->() const { return &current; }
+			const_iterator& operator++() { slot++; Skip(); return *this; }
+			const_iterator operator++(int) { const_iterator tmp(*this); ++*this; return tmp; }
+			bool operator==(const const_iterator& other) const { return slot == other.slot; }
+			bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+		};
+
+		const_iterator begin() const { return const_iterator(&values, 0); }
+		const_iterator end() const { return const_iterator(&values, values.size()); }
+
+		/** Get the number of values held */
+		size_t size() const;
+
+		/** Get the memory used by the slots, beyond the store itself */
+		size_t GetMemory() const { return values.capacity() * sizeof(void*); }
+	};
 
 	// Friend access for the protected getter/setter
 	friend class ExtensionItem;
@@ -80,6 +130,9 @@ class CoreExport Extensible : public classbase
 	 * Holds all extensible metadata for the class.
 	 */
 	ExtensibleStore extensions;
+
+	/** Whether cull() has been called, so that the destructor can tell if it was missed */
+	bool culled;
  public:
 	/**
 	 * Get the extension items for iteraton (i.e. for metadata sync during netburst)
@@ -95,12 +148,33 @@ class CoreExport Extensible : public classbase
 class CoreExport ExtensionManager
 {
 	std::map<std::string, reference<ExtensionItem> > types;
+
+	/** The item given each slot, or NULL for a free slot */
+	std::vector<ExtensionItem*> slots;
  public:
+	/** Register an item under its name, and give it a slot */
 	void Register(ExtensionItem* item);
+	/** Unregister the items created by a module, including any which were given a slot without
+	 * being registered, so that their values can be removed from every object. The items keep
+	 * their slots until they are destroyed, as objects waiting to be culled may still hold values.
+	 */
 	void BeginUnregister(Module* module, std::vector<reference<ExtensionItem> >& list);
 	ExtensionItem* GetItem(const std::string& name);
+
+	/** Get the item which has been given a slot, or NULL if the slot is free */
+	ExtensionItem* GetSlotItem(size_t slot) const { return slot < slots.size() ? slots[slot] : NULL; }
+	/** Give an item the lowest free slot, if it does not have one already */
+	void AssignSlot(ExtensionItem* item);
+	/** Take back an item's slot, when it is destroyed */
+	void ReleaseSlot(ExtensionItem* item);
 };
 
+inline void* ExtensionItem::get_raw(const Extensible* container) const
+{
+	/* An item without a slot has NO_SLOT, which no object has enough slots to reach */
+	return slot < container->extensions.values.size() ? container->extensions.values[slot] : NULL;
+}
+
 /** Base class for items that are NOT synchronized between servers */
 class CoreExport LocalExtItem : public ExtensionItem
 {
@@ -0,0 +1,335 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLAT_HASH_H
+#define FLAT_HASH_H
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+
+namespace irc
+{
+	/** A hash map which keeps its entries in one array, probing linearly from
+	 * the slot the hash picks, rather than in a node for each entry. By default
+	 * keys are strings, hashed and compared under the IRC case map, like the
+	 * nick and channel hashes always have been.
+	 *
+	 * It behaves like the std::tr1::unordered_map it replaces as far as the
+	 * core uses it. Erasing an entry leaves every other iterator valid, as
+	 * entries never move except when the table grows, which invalidates
+	 * iterators just like a rehash does.
+	 */
+	template<typename T, typename Hash = irc::StrHash, typename Equal = irc::StrHashComp, typename Key = std::string>
+	class flat_hash_map
+	{
+	 public:
+		typedef Key key_type;
+		typedef T mapped_type;
+		typedef std::pair<const Key, T> value_type;
+		typedef size_t size_type;
+
+		class const_iterator;
+
+		class iterator
+		{
+			friend class flat_hash_map;
+			friend class const_iterator;
+			flat_hash_map* map;
+			size_t pos;
+			iterator(flat_hash_map* m, size_t p) : map(m), pos(p) { }
+		 public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef typename flat_hash_map::value_type value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef value_type* pointer;
+			typedef value_type& reference;
+
+			iterator() : map(NULL), pos(0) { }
+			value_type& operator*() const { return map->slots[pos]; }
+			value_type* operator->() const { return &map->slots[pos]; }
+			iterator& operator++() { pos = map->NextUsed(pos + 1); return *this; }
+			iterator operator++(int) { iterator tmp(*this); ++*this; return tmp; }
+			bool operator==(const const_iterator& other) const { return pos == other.pos; }
+			bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+		};
+
+		class const_iterator
+		{
+			friend class flat_hash_map;
+			friend class iterator;
+			const flat_hash_map* map;
+			size_t pos;
+			const_iterator(const flat_hash_map* m, size_t p) : map(m), pos(p) { }
+		 public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef const typename flat_hash_map::value_type value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef value_type* pointer;
+			typedef value_type& reference;
+
+			const_iterator() : map(NULL), pos(0) { }
+			const_iterator(const iterator& i) : map(i.map), pos(i.pos) { }
+			value_type& operator*() const { return map->slots[pos]; }
+			value_type* operator->() const { return &map->slots[pos]; }
+			const_iterator& operator++() { pos = map->NextUsed(pos + 1); return *this; }
+			const_iterator operator++(int) { const_iterator tmp(*this); ++*this; return tmp; }
+			bool operator==(const const_iterator& other) const { return pos == other.pos; }
+			bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+		};
+
+	 private:
+		/** Values of hashes[] for slots with no entry. Slots with one hold the mixed hash of the
+		 * key, which is never less than FIRST_USED, so most mismatches are found without
+		 * comparing strings.
+		 */
+		enum { SLOT_EMPTY = 0, SLOT_DELETED = 1, FIRST_USED = 2 };
+
+		/** The mixed hash of the key in each slot, or SLOT_EMPTY or SLOT_DELETED */
+		size_t* hashes;
+
+		/** Storage for the entries; only slots with a hash hold a constructed value */
+		value_type* slots;
+
+		/** Number of slots, a power of two, or 0 before the first insert */
+		size_t capacity;
+
+		/** Number of entries */
+		size_t used;
+
+		/** Number of slots marked SLOT_DELETED */
+		size_t deleted;
+
+		Hash hasher;
+		Equal equal;
+
+		/** Spread the bits of the hash around, as the hashes used for nicks differ mostly in their low bits */
+		size_t HashKey(const Key& key) const
+		{
+			size_t h = hasher(key);
+			h ^= h >> 16;
+			h *= 0x45d9f3bU;
+			h ^= h >> 16;
+			return (h < FIRST_USED) ? h + FIRST_USED : h;
+		}
+
+		/** Find the first slot at or after pos which holds an entry, or capacity if none does */
+		size_t NextUsed(size_t pos) const
+		{
+			while (pos < capacity && hashes[pos] < FIRST_USED)
+				pos++;
+			return pos;
+		}
+
+		/** Find the slot holding a key, or capacity if it isn't there */
+		size_t FindSlot(const Key& key, size_t h) const
+		{
+			if (!capacity)
+				return 0;
+			for (size_t pos = h & (capacity - 1); ; pos = (pos + 1) & (capacity - 1))
+			{
+				if (hashes[pos] == SLOT_EMPTY)
+					return capacity;
+				if (hashes[pos] == h && equal(slots[pos].first, key))
+					return pos;
+			}
+		}
+
+		/** Move the entries into a table with the given number of slots */
+		void Resize(size_t newcapacity)
+		{
+			size_t* oldhashes = hashes;
+			value_type* oldslots = slots;
+			size_t oldcapacity = capacity;
+
+			hashes = new size_t[newcapacity]();
+			slots = static_cast<value_type*>(::operator new(newcapacity * sizeof(value_type)));
+			capacity = newcapacity;
+			deleted = 0;
+
+			for (size_t i = 0; i < oldcapacity; i++)
+			{
+				if (oldhashes[i] < FIRST_USED)
+					continue;
+				size_t pos = oldhashes[i] & (capacity - 1);
+				while (hashes[pos] != SLOT_EMPTY)
+					pos = (pos + 1) & (capacity - 1);
+				hashes[pos] = oldhashes[i];
+				/* Hand the key over rather than copying it; the old entry is destroyed straight after */
+				new (&slots[pos]) value_type(Key(), oldslots[i].second);
+				std::swap(const_cast<Key&>(slots[pos].first), const_cast<Key&>(oldslots[i].first));
+				oldslots[i].~value_type();
+			}
+
+			delete[] oldhashes;
+			::operator delete(oldslots);
+		}
+
+		/** Add an entry for a key which isn't in the table yet */
+		size_t InsertNew(const value_type& value, size_t h)
+		{
+			/* Keep at least an eighth of the slots empty, so that probes stay short and always end */
+			if ((used + deleted + 1) * 8 > capacity * 7)
+			{
+				size_t newcapacity = 16;
+				while (newcapacity < (used + 1) * 2)
+					newcapacity *= 2;
+				Resize(newcapacity);
+			}
+
+			size_t pos = h & (capacity - 1);
+			while (hashes[pos] >= FIRST_USED)
+				pos = (pos + 1) & (capacity - 1);
+			if (hashes[pos] == SLOT_DELETED)
+				deleted--;
+			new (&slots[pos]) value_type(value);
+			hashes[pos] = h;
+			used++;
+			return pos;
+		}
+
+		/** Remove the entry in a slot */
+		void EraseSlot(size_t pos)
+		{
+			slots[pos].~value_type();
+			used--;
+
+			/* A slot followed by an empty one ends every probe that reaches it, so it and
+			 * any deleted slots before it can be made empty again.
+			 */
+			if (hashes[(pos + 1) & (capacity - 1)] != SLOT_EMPTY)
+			{
+				hashes[pos] = SLOT_DELETED;
+				deleted++;
+				return;
+			}
+			hashes[pos] = SLOT_EMPTY;
+			for (pos = (pos - 1) & (capacity - 1); hashes[pos] == SLOT_DELETED; pos = (pos - 1) & (capacity - 1))
+			{
+				hashes[pos] = SLOT_EMPTY;
+				deleted--;
+			}
+		}
+
+	 public:
+		flat_hash_map() : hashes(NULL), slots(NULL), capacity(0), used(0), deleted(0) { }
+
+		flat_hash_map(const flat_hash_map& other) : hashes(NULL), slots(NULL), capacity(0), used(0), deleted(0)
+		{
+			for (const_iterator i = other.begin(); i != other.end(); ++i)
+				insert(*i);
+		}
+
+		flat_hash_map& operator=(const flat_hash_map& other)
+		{
+			if (this != &other)
+			{
+				flat_hash_map copy(other);
+				swap(copy);
+			}
+			return *this;
+		}
+
+		~flat_hash_map()
+		{
+			clear();
+			delete[] hashes;
+			::operator delete(slots);
+		}
+
+		iterator begin() { return iterator(this, NextUsed(0)); }
+		iterator end() { return iterator(this, capacity); }
+		const_iterator begin() const { return const_iterator(this, NextUsed(0)); }
+		const_iterator end() const { return const_iterator(this, capacity); }
+
+		size_t size() const { return used; }
+		bool empty() const { return used == 0; }
+
+		/** Get the number of slots, used or not */
+		size_t bucket_count() const { return capacity; }
+
+		iterator find(const Key& key)
+		{
+			return iterator(this, FindSlot(key, HashKey(key)));
+		}
+
+		const_iterator find(const Key& key) const
+		{
+			return const_iterator(this, FindSlot(key, HashKey(key)));
+		}
+
+		size_t count(const Key& key) const
+		{
+			return FindSlot(key, HashKey(key)) != capacity;
+		}
+
+		std::pair<iterator, bool> insert(const value_type& value)
+		{
+			size_t h = HashKey(value.first);
+			size_t pos = FindSlot(value.first, h);
+			if (pos != capacity)
+				return std::make_pair(iterator(this, pos), false);
+			return std::make_pair(iterator(this, InsertNew(value, h)), true);
+		}
+
+		T& operator[](const Key& key)
+		{
+			size_t h = HashKey(key);
+			size_t pos = FindSlot(key, h);
+			if (pos == capacity)
+				pos = InsertNew(value_type(key, T()), h);
+			return slots[pos].second;
+		}
+
+		void erase(iterator i)
+		{
+			EraseSlot(i.pos);
+		}
+
+		size_t erase(const Key& key)
+		{
+			size_t pos = FindSlot(key, HashKey(key));
+			if (pos == capacity)
+				return 0;
+			EraseSlot(pos);
+			return 1;
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i < capacity; i++)
+			{
+				if (hashes[i] >= FIRST_USED)
+					slots[i].~value_type();
+				hashes[i] = SLOT_EMPTY;
+			}
+			used = deleted = 0;
+		}
+
+		void swap(flat_hash_map& other)
+		{
+			std::swap(hashes, other.hashes);
+			std::swap(slots, other.slots);
+			std::swap(capacity, other.capacity);
+			std::swap(used, other.used);
+			std::swap(deleted, other.deleted);
+		}
+	};
+}
+
+#endif
@@ -110,6 +110,14 @@ namespace irc
 		bool operator()(const std::string& s1, const std::string& s2) const;
 	};
 
+	/** Hashes a std::string under national_case_insensitive_map, so that
+	 * strings which StrHashComp says are equal hash the same
+	 */
+	struct CoreExport StrHash
+	{
+		size_t operator()(const std::string& s) const;
+	};
+
 	/** The irc_char_traits class is used for RFC-style comparison of strings.
 	 * This class is used to implement irc::string, a case-insensitive, RFC-
 	 * comparing string class.
@@ -0,0 +1,103 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/** A histogram of durations, for latency statistics.
+ * Durations are counted in microseconds, in buckets which double in size:
+ * bucket 0 holds durations under one microsecond, and bucket n holds
+ * durations of at least 2^(n-1) and under 2^n microseconds. Adding a
+ * duration is cheap enough to do for every event being measured.
+ */
+class CoreExport Histogram
+{
+ public:
+	/** Number of buckets; the last one also holds anything longer */
+	static const unsigned int BUCKETS = 32;
+
+ private:
+	/** Number of durations counted in each bucket */
+	unsigned long buckets[BUCKETS];
+	/** Number of durations counted */
+	unsigned long count;
+	/** Sum of the durations counted, in microseconds */
+	double total;
+	/** Longest duration counted, in microseconds */
+	unsigned long max;
+
+ public:
+	Histogram();
+
+	/** Count a duration
+	 * @param usecs The duration in microseconds
+	 */
+	void Add(unsigned long usecs);
+
+	/** Count the duration between two times
+	 * @param start The start of the duration
+	 * @param end The end of the duration; if this is before start, nothing is counted
+	 */
+	void Add(const timespec& start, const timespec& end);
+
+	/** Forget everything counted so far */
+	void Reset();
+
+	/** Get the number of durations counted */
+	unsigned long GetCount() const { return count; }
+
+	/** Get the mean duration in microseconds, or 0 if nothing has been counted */
+	unsigned long GetMean() const { return count ? (unsigned long)(total / count) : 0; }
+
+	/** Get the sum of the durations counted, in microseconds */
+	unsigned long GetTotal() const { return (unsigned long)total; }
+
+	/** Get the longest duration in microseconds */
+	unsigned long GetMax() const { return max; }
+
+	/** Get an upper bound on a percentile: the end of the bucket the percentile falls in
+	 * @param percent The percentile, from 1 to 100
+	 * @return The upper bound in microseconds, or 0 if nothing has been counted
+	 */
+	unsigned long GetPercentile(unsigned int percent) const;
+
+	/** Describe the histogram in one line, e.g. "count 12 mean 3.1ms max 9.8ms p50 <4.1ms p90 <8.2ms p99 <16ms" */
+	std::string Summary() const;
+
+	/** List the non-empty buckets by their upper bounds, e.g. "<1.0ms:3 <2.0ms:9".
+	 * @param perline Number of buckets to put in each string
+	 * @return One string per perline buckets
+	 */
+	std::vector<std::string> Buckets(unsigned int perline = 8) const;
+
+	/** Get the time between two times in microseconds, or 0 if end is before start */
+	static unsigned long Elapsed(const timespec& start, const timespec& end);
+
+	/** Read the monotonic clock, for timing something to count.
+	 * Falls back to the wall clock where there is no monotonic clock.
+	 * @param ts Set to the current time
+	 */
+	static void Now(timespec& ts);
+
+	/** Format a duration for humans, e.g. "850us", "12ms" or "3.2s"
+	 * @param usecs The duration in microseconds
+	 */
+	static std::string FormatTime(unsigned long usecs);
+};
+
+#endif
@@ -77,9 +77,14 @@ CoreExport extern InspIRCd* ServerInstance;
 #include "extensible.h"
 #include "numerics.h"
 #include "uid.h"
+#include "timer.h"
+#include "histogram.h"
+#include "memusage.h"
+#include "capture.h"
+#include "banmask.h"
+#include "stringpool.h"
 #include "users.h"
 #include "channels.h"
-#include "timer.h"
 #include "hashcomp.h"
 #include "logger.h"
 #include "usermanager.h"
@@ -92,6 +97,7 @@ CoreExport extern InspIRCd* ServerInstance;
 #include "filelogger.h"
 #include "modules.h"
 #include "threadengine.h"
+#include "iothreads.h"
 #include "configreader.h"
 #include "inspstring.h"
 #include "protocol.h"
@@ -189,6 +195,27 @@ template<typename T> inline long ConvToInt(const T &in)
 	return atol(tmp.str().c_str());
 }
 
+/** The phases of a pass through the main loop, timed separately
+ * by serverstats::statsLoopPhase
+ */
+enum LoopPhase
+{
+	/** Finishing rehashes and the once a second housekeeping */
+	LOOP_BACKGROUND,
+	/** Running timers and connecting users who are ready */
+	LOOP_TIMERS,
+	/** Handing queued output to the I/O threads, log writer and sockets */
+	LOOP_FLUSH,
+	/** Handling socket events, not counting the wait for them */
+	LOOP_EVENTS,
+	/** Deleting objects queued in the cull list */
+	LOOP_CULLS,
+	/** Running actions queued in the action list */
+	LOOP_ACTIONS,
+	/** Number of phases */
+	LOOP_PHASES
+};
+
 /** This class contains various STATS counters
  * It is used by the InspIRCd class, which internally
  * has an instance of it.
@@ -230,6 +257,15 @@ class serverstats
 	/** Total bytes of data received
 	 */
 	unsigned long statsRecv;
+	/** Time from accepting each connection to sending it RPL_WELCOME
+	 */
+	Histogram statsRegTime;
+	/** Time spent in each phase of each main loop pass
+	 */
+	Histogram statsLoopPhase[LOOP_PHASES];
+	/** Time spent in each main loop pass, not counting the wait for socket events
+	 */
+	Histogram statsLoopBusy;
 	/** Cpu usage at last sample
 	 */
 	timeval LastCPU;
@@ -243,6 +279,14 @@ class serverstats
 		statsDnsGood(0), statsDnsBad(0), statsConnects(0), statsSent(0), statsRecv(0)
 	{
 	}
+
+	/** Get the name of a main loop phase, e.g. "events"
+	 */
+	static const char* GetLoopPhaseName(LoopPhase phase)
+	{
+		static const char* const names[LOOP_PHASES] = { "background", "timers", "flush", "events", "culls", "actions" };
+		return names[phase];
+	}
 };
 
 DEFINE_HANDLER2(IsNickHandler, bool, const char*, size_t);
@@ -285,16 +329,6 @@ class CoreExport InspIRCd
 	 */
 	void IncrementUID(int pos);
 
-	/** Perform background user events such as PING checks
-	 */
-	void DoBackgroundUserStuff();
-
-	/** Returns true when all modules have done pre-registration checks on a user
-	 * @param user The user to verify
-	 * @return True if all modules have finished checking this user
-	 */
-	bool AllModulesReportReady(LocalUser* user);
-
 	/** The current time, updated in the mainloop
 	 */
 	struct timespec TIME;
@@ -385,6 +419,11 @@ class CoreExport InspIRCd
 	 */
 	ThreadEngine* Threads;
 
+	/** I/O threads which service registered client sockets, or NULL
+	 * if <performance:iothreads> is not set
+	 */
+	IOThreadPool* IOThreads;
+
 	/** The thread/class used to read config files in REHASH and on startup
 	 */
 	ConfigReaderThread* ConfigThread;
@@ -407,6 +446,10 @@ class CoreExport InspIRCd
 	 */
 	serverstats* stats;
 
+	/** Records client traffic for replaying later, when <performance:capture> is set
+	 */
+	TrafficCapture* Capture;
+
 	/**  Server Config class, holds configuration file data
 	 */
 	ServerConfig* Config;
@@ -468,9 +511,17 @@ class CoreExport InspIRCd
 	inline time_t Time() { return TIME.tv_sec; }
 	/** The fractional time at the start of this mainloop iteration (nanoseconds) */
 	inline long Time_ns() { return TIME.tv_nsec; }
+	/** The time at the start of this mainloop iteration, in seconds and nanoseconds */
+	inline const struct timespec& Time_ts() { return TIME; }
 	/** Update the current time. Don't call this unless you have reason to do so. */
 	void UpdateTime();
 
+	/** Returns true when all modules have done pre-registration checks on a user
+	 * @param user The user to verify
+	 * @return True if all modules have finished checking this user
+	 */
+	bool AllModulesReportReady(LocalUser* user);
+
 	/** Generate a random string with the given length
 	 * @param length The length in bytes
 	 * @param printable if false, the string will use characters 0-255; otherwise,
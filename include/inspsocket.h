@@ -69,6 +69,32 @@ enum BufferedSocketError
 /* Required forward declarations */
 class BufferedSocket;
 
+/** An immutable, reference counted block of outgoing data.
+ * The same buffer may sit in the send queue of any number of sockets at
+ * once, so a line sent to a large channel only needs to be rendered once.
+ * Hold these in a reference<SharedBuffer>; the buffer is freed when the
+ * last socket has finished writing it.
+ */
+class CoreExport SharedBuffer : public refcountbase
+{
+ public:
+	/** The data to be sent. Never modified once the buffer is created. */
+	const std::string data;
+
+	SharedBuffer(const std::string& text) : data(text) { }
+	/** Create a buffer holding text immediately followed by suffix */
+	SharedBuffer(const std::string& text, const std::string& suffix) : data(Concat(text, suffix)) { }
+
+ private:
+	static std::string Concat(const std::string& text, const std::string& suffix)
+	{
+		std::string result;
+		result.reserve(text.length() + suffix.length());
+		result.append(text).append(suffix);
+		return result;
+	}
+};
+
 /** Used to time out socket connections
  */
 class CoreExport SocketTimeout : public Timer
@@ -105,17 +131,32 @@ class CoreExport StreamSocket : public EventHandler
 {
 	/** Module that handles raw I/O for this socket, or NULL */
 	reference<Module> IOHook;
-	/** Private send queue. Note that individual strings may be shared
+	/** Private send queue. Note that individual buffers may be shared
+	 * with the send queues of other sockets, and must not be modified.
 	 */
-	std::deque<std::string> sendq;
+	std::deque<reference<SharedBuffer> > sendq;
 	/** Length, in bytes, of the sendq */
 	size_t sendq_len;
 	/** Error - if nonempty, the socket is dead, and this is the reason. */
 	std::string error;
  protected:
 	std::string recvq;
+	/** Offset of the first unread byte in recvq. Everything before it has
+	 * already been returned by GetNextLine(), and is discarded in one go
+	 * once OnDataReady() returns rather than once per line.
+	 */
+	std::string::size_type recvq_pos;
+	/** Discard the part of recvq which has already been read */
+	inline void CompactRecvQ()
+	{
+		if (recvq_pos)
+		{
+			recvq.erase(0, recvq_pos);
+			recvq_pos = 0;
+		}
+	}
  public:
-	StreamSocket() : sendq_len(0) {}
+	StreamSocket() : sendq_len(0), recvq_pos(0) {}
 	inline Module* GetIOHook();
 	inline void AddIOHook(Module* m);
 	inline void DelIOHook();
@@ -142,14 +183,29 @@ class CoreExport StreamSocket : public EventHandler
 	/** Send the given data out the socket, either now or when writes unblock
 	 */
 	void WriteData(const std::string& data);
+	/** Queue a shared buffer on the socket without copying its contents.
+	 * @param data The buffer to send; it may be queued on other sockets too
+	 */
+	void WriteData(SharedBuffer* data);
 	/** Convenience function: read a line from the socket
 	 * @param line The line read
 	 * @param delim The line delimiter
 	 * @return true if a line was read
 	 */
 	bool GetNextLine(std::string& line, char delim = '\n');
+	/** Get the number of bytes in recvq which have not been read yet */
+	inline std::string::size_type getRecvQSize() const { return recvq.length() - recvq_pos; }
 	/** Useful for implementing sendq exceeded */
 	inline const size_t getSendQSize() const { return sendq_len; }
+	/** Get the memory used by the send and receive queues, for /stats z.
+	 * Buffers shared with other sockets are counted in full.
+	 */
+	size_t GetQueueMemory() const;
+	/** Move the unsent contents of the sendq into a string, leaving the sendq empty.
+	 * Used when something other than this socket takes over writing to it.
+	 * @param out String to append the data to
+	 */
+	void TakeSendQ(std::string& out);
 
 	/**
 	 * Close the socket, remove from socket engine, etc
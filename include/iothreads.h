@@ -0,0 +1,127 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IOTHREADS_H
+#define IOTHREADS_H
+
+#include <vector>
+#include <string>
+#include "threadengine.h"
+
+class IOThread;
+
+/** A client socket which has been handed to an I/O thread.
+ * Fields are owned by one side only, as documented; the only field
+ * touched by both threads is sendq_len, which is updated atomically.
+ */
+class CoreExport IOConnection
+{
+ public:
+	/** The thread which services this socket */
+	IOThread* const thread;
+	/** The socket itself */
+	const int fd;
+
+	/** Main thread: the socket this belongs to, or NULL once it has been closed */
+	UserIOHandler* owner;
+	/** Main thread: output which has not been handed to the I/O thread yet */
+	std::string pending;
+	/** Main thread: true if this is in the pool's list of connections to flush */
+	bool dirty;
+	/** Main thread: true once the socket should be closed after sending pending */
+	bool closing;
+
+	/** Both threads: bytes queued by the main thread and not yet sent */
+	volatile long sendq_len;
+
+	/** I/O thread: output waiting to be sent, starting at outpos */
+	std::string outbuf;
+	std::string::size_type outpos;
+	/** I/O thread: received data after the last complete line */
+	std::string partial;
+	/** I/O thread: position in the thread's poll set */
+	size_t index;
+
+	IOConnection(IOThread* t, int newfd, UserIOHandler* eh)
+		: thread(t), fd(newfd), owner(eh), dirty(false), closing(false), sendq_len(0), outpos(0), index(0)
+	{
+	}
+};
+
+/** The I/O thread pool moves reading from and writing to client sockets off
+ * the main thread. Once a plaintext client has registered, its socket is
+ * removed from the socket engine and handed to one of the I/O threads, which
+ * does the recv() and send() calls and cuts the received data at line
+ * boundaries. Received lines are handed back to the main thread in batches,
+ * where they are parsed and executed exactly as before; all users, channels
+ * and modes are still only ever touched by the main thread.
+ */
+class CoreExport IOThreadPool
+{
+	/** The I/O threads */
+	std::vector<IOThread*> threads;
+	/** Connections with output or a close waiting to be handed to their thread */
+	std::vector<IOConnection*> dirty;
+	/** Sockets waiting to be handed to an I/O thread */
+	std::vector<UserIOHandler*> attaching;
+	/** Thread the next socket will be handed to */
+	unsigned int next;
+
+	/** Move a socket from the socket engine to an I/O thread */
+	void DoAttach(UserIOHandler* eh);
+	void MarkDirty(IOConnection* conn);
+
+ public:
+	/** Start the I/O threads
+	 * @param count Number of threads to start
+	 */
+	IOThreadPool(unsigned int count);
+
+	/** Stop the threads, after handing them any output which is still waiting */
+	~IOThreadPool();
+
+	/** Hand a socket to an I/O thread. This takes effect during the next
+	 * call to Flush(), so it is safe to call from the socket's own handlers.
+	 */
+	void Attach(UserIOHandler* eh);
+
+	/** Queue output for a socket serviced by an I/O thread
+	 * @param conn The connection to write to
+	 * @param data The data to write
+	 */
+	void Write(IOConnection* conn, const std::string& data);
+
+	/** Close a socket serviced by an I/O thread, once any queued output has been sent.
+	 * The socket's events are not reported to its owner after this call.
+	 * @param eh The socket to close
+	 * @return True if the socket was serviced by an I/O thread, false if
+	 * it is still handled by the socket engine and must be closed as usual
+	 */
+	bool Close(UserIOHandler* eh);
+
+	/** Hand all sockets, output and closes queued since the last call to
+	 * their I/O threads, waking each thread at most once. Called from the
+	 * main loop before waiting for events.
+	 */
+	void Flush();
+
+	/** Get the number of I/O threads */
+	size_t GetThreadCount() const { return threads.size(); }
+};
+
+#endif
@@ -35,6 +35,11 @@ class CoreExport FileWriter
 	 */
 	int writeops;
 
+	/** Number of lines dropped since the last one written, because the
+	 * log writer thread had too much queued
+	 */
+	unsigned long dropped;
+
  public:
 	/** The constructor takes an already opened logfile.
 	 */
@@ -91,7 +96,14 @@ class CoreExport LogStream : public classbase
 	/** Changes the loglevel for this LogStream on-the-fly.
 	 * This is needed for -nofork. But other LogStreams could use it to change loglevels.
 	 */
-	void ChangeLevel(int lvl) { this->loglvl = lvl; }
+	void ChangeLevel(int lvl);
+
+	/** Get the lowest level of message this LogStream wants. LogManager
+	 * does not format messages below the level of every stream which
+	 * would receive them, so OnLog() is only called for lower levels if
+	 * another stream for the same type wants them.
+	 */
+	int GetLevel() const { return loglvl; }
 
 	/** Called when there is stuff to log for this particular logstream. The derived class may take no action with it, or do what it
 	 * wants with the output, basically. loglevel and type are primarily for informational purposes (the level and type of the event triggered)
@@ -102,6 +114,8 @@ class CoreExport LogStream : public classbase
 
 typedef std::map<FileWriter*, int> FileLogMap;
 
+class LogWriterThread;
+
 class CoreExport LogManager
 {
  private:
@@ -126,6 +140,23 @@ class CoreExport LogManager
 	 */
 	FileLogMap FileLogs;
 
+	/** Thread which writes log files, or NULL if they are written by the main thread
+	 */
+	LogWriterThread* Writer;
+
+	/** Lowest level wanted by any LogStream, for any type
+	 */
+	int MinLevel;
+
+	/** Lowest level wanted for each type which has its own LogStreams, or
+	 * which is excluded by a LogStream for type *
+	 */
+	std::map<std::string, int> TypeLevels;
+
+	/** Lowest level wanted for any other type, i.e. by the LogStreams for type *
+	 */
+	int OtherLevel;
+
  public:
 
 	LogManager();
@@ -161,9 +192,32 @@ class CoreExport LogManager
 	}
 
 	/** Opens all logfiles defined in the configuration file using <log method="file">.
+	 * This also starts or stops the log writer thread, as set by <performance:logthread>.
 	 */
 	void OpenFileLogs();
 
+	/** Start writing log files from a background thread, so that a slow disk
+	 * cannot hold up the main loop. Lines are queued by the main thread and
+	 * handed to the thread in batches by Flush().
+	 * @param queuesize Most bytes which may be waiting to be written
+	 * @param block What to do when the queue is full: true to wait for the
+	 * thread to catch up, false to drop lines (noting how many were dropped)
+	 */
+	void StartWriter(unsigned long queuesize, bool block);
+
+	/** Stop the log writer thread, once it has written everything queued.
+	 * Log files are written by the main thread again afterwards.
+	 */
+	void StopWriter();
+
+	/** Get the log writer thread, or NULL if there is none */
+	LogWriterThread* GetWriter() { return Writer; }
+
+	/** Hand the lines queued since the last call to the log writer thread.
+	 * Called from the main loop; does nothing if there is no thread.
+	 */
+	void Flush();
+
 	/** Removes all LogStreams, meaning they have to be readded for logging to continue.
 	 * Only LogStreams that were listed in AllLogStreams are actually closed.
 	 */
@@ -197,6 +251,26 @@ class CoreExport LogManager
 	 */
 	bool DelLogType(const std::string &type, LogStream *l);
 
+	/** Check whether any LogStream would receive a message, without formatting it.
+	 * Log() does this itself, so this is only needed to avoid building the arguments
+	 * to Log() on busy code paths.
+	 * @param type Log message type (ex: "USERINPUT", "MODULE", ...)
+	 * @param loglevel Log message level (DEBUG, VERBOSE, DEFAULT, SPARSE, NONE)
+	 * @return True if a message of this type and level would be logged
+	 */
+	bool IsLogged(const std::string &type, int loglevel)
+	{
+		if (loglevel < MinLevel || Logging)
+			return false;
+		std::map<std::string, int>::const_iterator i = TypeLevels.find(type);
+		return loglevel >= (i == TypeLevels.end() ? OtherLevel : i->second);
+	}
+
+	/** Recalculate the lowest levels wanted for each type. This is done
+	 * whenever LogStreams are added or removed, or change their level.
+	 */
+	void UpdateLevels();
+
 	/** Logs an event, sending it to all LogStreams registered for the type.
 	 * @param type Log message type (ex: "USERINPUT", "MODULE", ...)
 	 * @param loglevel Log message level (DEBUG, VERBOSE, DEFAULT, SPARSE, NONE)
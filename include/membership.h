@@ -27,7 +27,13 @@ class CoreExport Membership : public Extensible
 	Channel* const chan;
 	// mode list, sorted by prefix rank, higest first
 	std::string modes;
-	Membership(User* u, Channel* c) : user(u), chan(c) {}
+	/** Whether a ban other than an extban matched the user when it was last checked */
+	bool banned;
+	/** Channel::bangeneration when banned was set, or 0 if it has never been */
+	unsigned long chanbangeneration;
+	/** User::bangeneration when banned was set */
+	unsigned long userbangeneration;
+	Membership(User* u, Channel* c) : user(u), chan(c), banned(false), chanbangeneration(0), userbangeneration(0) {}
 	inline bool hasMode(char m) const
 	{
 		return modes.find(m) != std::string::npos;
@@ -0,0 +1,85 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MEMUSAGE_H
+#define MEMUSAGE_H
+
+/** An estimate of the memory used by the server, broken down by what it is used for.
+ * The figures are approximate: they count the objects themselves, the heap
+ * storage of their strings and an allowance for each container node, but
+ * not what the allocator adds. Figures which would take too long to count
+ * exactly on a large server are extrapolated from a sample.
+ */
+class CoreExport MemoryReport
+{
+ public:
+	/** Memory used for one purpose */
+	struct Item
+	{
+		/** What the memory is used for, e.g. "users" */
+		std::string name;
+		/** Number of objects counted */
+		unsigned long count;
+		/** Estimated number of bytes used */
+		size_t bytes;
+		/** True if bytes was extrapolated from a sample */
+		bool sampled;
+	};
+
+	/** Most objects to look at when sampling */
+	static const unsigned long SAMPLE_SIZE = 1000;
+
+	/** The figures collected, in the order they were added */
+	std::vector<Item> items;
+
+	/** Count the memory used by the core, then call OnMemoryUsage in modules so they can add theirs */
+	void Collect();
+
+	/** Add a figure
+	 * @param name What the memory is used for
+	 * @param count Number of objects counted
+	 * @param bytes Estimated number of bytes used
+	 * @param sampled True if bytes was extrapolated from a sample
+	 */
+	void Add(const std::string& name, unsigned long count, size_t bytes, bool sampled = false);
+
+	/** Get the total of all figures added, in bytes */
+	size_t GetTotal() const;
+
+	/** Get the heap storage used by a string, beyond the string object itself */
+	static size_t StringSize(const std::string& str)
+	{
+		/* Short strings are stored inside the string object itself */
+		const char* data = str.data();
+		const char* object = reinterpret_cast<const char*>(&str);
+		if (data >= object && data < object + sizeof(std::string))
+			return 0;
+		return str.capacity() + 1;
+	}
+
+	/** Get the size of a node of a map, set or list holding a value of the given size */
+	static size_t NodeSize(size_t valuesize)
+	{
+		return 4 * sizeof(void*) + valuesize;
+	}
+
+	/** Format a number of bytes for humans, e.g. "512B", "12.3K" or "4.1M" */
+	static std::string FormatBytes(size_t bytes);
+};
+
+#endif
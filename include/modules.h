@@ -118,6 +118,16 @@ struct ModResult {
  */
 #define INSPIRCD_VERSION_API 1
 
+/**
+ * Counts the call to hook i of module m made in the rest of the enclosing
+ * block, when hook profiling is compiled in (USE_HOOK_PROFILING).
+ */
+#ifdef USE_HOOK_PROFILING
+#define PROFILE_HOOK(m,i) HookProfiler hook_profiler(m, i)
+#else
+#define PROFILE_HOOK(m,i)
+#endif
+
 /**
  * This #define allows us to call a method in all
  * loaded modules in a readable simple way, e.g.:
@@ -131,6 +141,7 @@ struct ModResult {
 		++safei; \
 		try \
 		{ \
+			PROFILE_HOOK(*_i, y); \
 			(*_i)->x ; \
 		} \
 		catch (CoreException& modexcept) \
@@ -156,7 +167,10 @@ do { \
 		iter_ ## n ++; \
 		try \
 		{ \
-			v = (mod_ ## n)->n args;
+			{ \
+				PROFILE_HOOK(mod_ ## n, I_ ## n); \
+				v = (mod_ ## n)->n args; \
+			}
 
 #define WHILE_EACH_HOOK(n) \
 		} \
@@ -338,7 +352,8 @@ enum Implementation
 	I_OnPostOper, I_OnSyncNetwork, I_OnSetAway, I_OnPostCommand, I_OnPostJoin,
 	I_OnWhoisLine, I_OnBuildNeighborList, I_OnGarbageCollect, I_OnSetConnectClass,
 	I_OnText, I_OnPassCompare, I_OnRunTestSuite, I_OnNamesListItem, I_OnNumeric, I_OnHookIO,
-	I_OnPreRehash, I_OnModuleRehash, I_OnSendWhoLine, I_OnChangeIdent,
+	I_OnPreRehash, I_OnModuleRehash, I_OnSendWhoLine, I_OnChangeIdent, I_OnMemoryUsage,
+	I_OnCheckExtBan,
 	I_END
 };
 
@@ -357,6 +372,21 @@ class CoreExport Module : public classbase, public usecountbase
 	 */
 	DLLManager* ModuleDLLManager;
 
+	/** Calls made to one of this module's hooks, for /stats h
+	 */
+	struct HookStats
+	{
+		/** Number of calls made */
+		unsigned long calls;
+		/** Time spent in them, in microseconds */
+		unsigned long usecs;
+	};
+
+	/** Statistics for each hook, indexed by Implementation, or NULL
+	 * if hook profiling has not counted any calls to this module
+	 */
+	HookStats* hookstats;
+
 	/** Default constructor.
 	 * Creates a module class. Don't do any type of hook registration or checks
 	 * for other modules here; do that in init().
@@ -982,6 +1012,9 @@ class CoreExport Module : public classbase, public usecountbase
 	 * If any modules return false for this function, the user is held in the waiting
 	 * state until all modules return true. For example a module which implements ident
 	 * lookups will continue to return false for a user until their ident lookup is completed.
+	 * A module which stops holding a user back should call UserManager::CheckReady() for
+	 * them, so that they are connected straight away; otherwise they are only checked
+	 * again once a second.
 	 * Note that the registration timeout for a user overrides these checks, if the registration
 	 * timeout is reached, the user is disconnected even if modules report that the user is
 	 * not ready to connect.
@@ -1056,7 +1089,10 @@ class CoreExport Module : public classbase, public usecountbase
 	virtual ModResult OnCheckChannelBan(User* user, Channel* chan);
 
 	/**
-	 * Checks for a user's match of a single ban
+	 * Checks for a user's match of a single ban. Modules which only provide
+	 * extbans should use OnCheckExtBan instead: while any module implements
+	 * this, every ban has to be passed to it, rather than only the bans which
+	 * the core's index of the ban list says might match.
 	 * @param user The user to check for match
 	 * @param chan The channel on which the match is being checked
 	 * @param mask The mask being checked
@@ -1065,6 +1101,17 @@ class CoreExport Module : public classbase, public usecountbase
 	 */
 	virtual ModResult OnCheckBan(User* user, Channel* chan, const std::string& mask);
 
+	/**
+	 * Checks for a user's match of a single extban, such as R:account.
+	 * This is called before OnCheckBan, and only for extbans.
+	 * @param user The user to check for match
+	 * @param chan The channel on which the match is being checked
+	 * @param mask The extban being checked, including its type and colon
+	 * @return MOD_RES_DENY to mark as banned, MOD_RES_ALLOW to skip the
+	 * ban check, or MOD_RES_PASSTHRU to check bans normally
+	 */
+	virtual ModResult OnCheckExtBan(User* user, Channel* chan, const std::string& mask);
+
 	/** Checks for a match on a given extban type
 	 * @return MOD_RES_DENY to mark as banned, MOD_RES_ALLOW to skip the
 	 * ban check, or MOD_RES_PASSTHRU to check bans normally
@@ -1288,8 +1335,50 @@ class CoreExport Module : public classbase, public usecountbase
 	 * @param line The raw line to send; modifiable, if empty no line will be returned.
 	 */
 	virtual void OnSendWhoLine(User* source, const std::vector<std::string>& params, User* user, std::string& line);
+
+	/** Called when the memory used by the server is being counted, for /stats z
+	 * and m_httpd_stats. Add an estimate of the memory used by any large
+	 * structures your module keeps.
+	 * @param report The report to add to with MemoryReport::Add()
+	 */
+	virtual void OnMemoryUsage(MemoryReport& report);
 };
 
+/** Times a call to a module's hook, adding it to Module::hookstats when
+ * it goes out of scope. Use the PROFILE_HOOK macro rather than this
+ * directly, so that profiling can be compiled out.
+ */
+class CoreExport HookProfiler
+{
+	/** The module called, or NULL if profiling was off when the call began */
+	Module* const mod;
+	/** The hook called */
+	const Implementation hook;
+	/** When the call began */
+	timespec start;
+
+	/** Count the call */
+	void Stop();
+
+ public:
+	/** True if calls are being counted; set from <performance:profilehooks> */
+	static bool enabled;
+
+	HookProfiler(Module* m, Implementation i) : mod(enabled ? m : NULL), hook(i)
+	{
+		if (mod)
+			Histogram::Now(start);
+	}
+
+	~HookProfiler()
+	{
+		if (mod)
+			Stop();
+	}
+
+	/** Get the name of a hook, e.g. "OnUserJoin" */
+	static const char* GetName(Implementation hook);
+};
 
 #define CONF_NO_ERROR		0x000000
 #define CONF_NOT_A_NUMBER	0x000010
@@ -150,6 +150,8 @@ class CoreExport ListenSocket : public EventHandler
 	int bind_port;
 	/** Human-readable bind description */
 	std::string bind_desc;
+	/** Maximum number of connections to accept per read event */
+	int accept_batch;
 	/** Create a new listening socket
 	 */
 	ListenSocket(ConfigTag* tag, const irc::sockets::sockaddrs& bind_to);
@@ -161,8 +163,9 @@ class CoreExport ListenSocket : public EventHandler
 	~ListenSocket();
 
 	/** Handles sockets internals crap of a connection, convenience wrapper really
+	 * @return False if there was no connection waiting to be accepted
 	 */
-	void AcceptInternal();
+	bool AcceptInternal();
 };
 
 #endif
@@ -250,12 +250,25 @@ class CoreExport SocketEngine
 
 	virtual void OnSetEvent(EventHandler* eh, int old_mask, int new_mask) = 0;
 	void SetEventMask(EventHandler* eh, int value);
+
+	/** Called by DispatchEvents() as soon as waiting for events has
+	 * finished, to update the time and set WaitEnd
+	 */
+	void WaitFinished();
 public:
 
 	unsigned long TotalEvents;
 	unsigned long ReadEvents;
 	unsigned long WriteEvents;
 	unsigned long ErrorEvents;
+	/** System calls made to wait for events, or to change which events are waited for */
+	unsigned long EngineCalls;
+
+	/** When DispatchEvents() last finished waiting for events, on the
+	 * clock read by Histogram::Now(); time spent handling the events
+	 * is measured from here
+	 */
+	timespec WaitEnd;
 
 	/** Constructor.
 	 * The constructor transparently initializes
@@ -330,7 +343,8 @@ public:
 	virtual EventHandler* GetRef(int fd);
 
 	/** Waits for events and dispatches them to handlers.  Please note that
-	 * this doesn't wait long, only a couple of milliseconds. It returns the
+	 * this doesn't wait long: at most one second, and no longer than
+	 * TimerManager::GetNextTimeout() allows. It returns the
 	 * number of events which occurred during this call.  This method will
 	 * dispatch events to their handlers by calling their
 	 * EventHandler::HandleEvent() methods with the necessary EventType
@@ -356,7 +370,9 @@ public:
 	virtual bool BoundsCheckFd(EventHandler* eh);
 
 	/** Abstraction for BSD sockets accept(2).
-	 * This function should emulate its namesake system call exactly.
+	 * This function should emulate its namesake system call exactly, except
+	 * that where accept4(2) is available the new socket is already non-blocking
+	 * and close-on-exec.
 	 * @param fd This version of the call takes an EventHandler instead of a bare file descriptor.
 	 * @return This method should return exactly the same values as the system call it emulates.
 	 */
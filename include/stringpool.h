@@ -0,0 +1,163 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "hash_map.h"
+
+/** An immutable string kept in a pool, so that every PooledString holding the
+ * same text shares one copy of it. This is used for the user fields which many
+ * users have in common, such as the server name, so that each user only holds a
+ * pointer, and so that two PooledStrings can be compared by that pointer.
+ *
+ * A PooledString can be used where a const std::string& is expected. Giving it
+ * a new value looks the value up in the pool, so these fields are cheap to read
+ * and compare but a little dearer to set. The pool is not thread safe, and must
+ * only be used from the main thread.
+ */
+class CoreExport PooledString
+{
+ public:
+	typedef std::string::size_type size_type;
+	typedef std::string::const_iterator const_iterator;
+
+	/** Hashes pool values byte for byte. The default std::string hash folds case
+	 * through national_case_insensitive_map, which modules may swap while the pool
+	 * holds entries, and pooled values are compared case sensitively anyway.
+	 */
+	struct CoreExport Hash
+	{
+		size_t operator()(const std::string& s) const;
+	};
+
+	/** Number of PooledStrings holding each value in the pool */
+	typedef nspace::hash_map<std::string, unsigned long, Hash> Pool;
+
+ private:
+	/** The pool entry holding the value, or NULL for the empty string, which isn't pooled */
+	Pool::value_type* entry;
+
+	/** Get the pool, which is created the first time it is needed and never destroyed,
+	 * so that it outlives any static PooledString
+	 */
+	static Pool& GetPool();
+
+	/** Take a reference to the pooled copy of a value, adding it to the pool if it isn't there */
+	static Pool::value_type* Acquire(const std::string& value);
+
+	/** Drop a reference to a pool entry, removing it from the pool once nothing holds it */
+	static void Release(Pool::value_type* e);
+
+	/** An empty string for the value of empty PooledStrings */
+	static const std::string empty_string;
+
+ public:
+	PooledString() : entry(NULL) { }
+
+	explicit PooledString(const std::string& value) : entry(Acquire(value)) { }
+
+	explicit PooledString(const char* value) : entry(Acquire(value)) { }
+
+	PooledString(const PooledString& other) : entry(other.entry)
+	{
+		if (entry)
+			entry->second++;
+	}
+
+	~PooledString()
+	{
+		Release(entry);
+	}
+
+	PooledString& operator=(const PooledString& other)
+	{
+		if (other.entry)
+			other.entry->second++;
+		Release(entry);
+		entry = other.entry;
+		return *this;
+	}
+
+	PooledString& operator=(const std::string& value)
+	{
+		Pool::value_type* e = Acquire(value);
+		Release(entry);
+		entry = e;
+		return *this;
+	}
+
+	PooledString& operator=(const char* value)
+	{
+		return *this = std::string(value);
+	}
+
+	/** Set the value to part of a string, like std::string::assign */
+	PooledString& assign(const std::string& value, size_type pos = 0, size_type n = std::string::npos)
+	{
+		return *this = value.substr(pos, n);
+	}
+
+	/** Get the value */
+	const std::string& str() const { return entry ? entry->first : empty_string; }
+
+	operator const std::string&() const { return str(); }
+
+	const char* c_str() const { return str().c_str(); }
+	const char* data() const { return str().data(); }
+	size_type length() const { return str().length(); }
+	size_type size() const { return str().size(); }
+	bool empty() const { return !entry; }
+	char operator[](size_type pos) const { return str()[pos]; }
+	const_iterator begin() const { return str().begin(); }
+	const_iterator end() const { return str().end(); }
+	size_type find(char c, size_type pos = 0) const { return str().find(c, pos); }
+	size_type find(const std::string& s, size_type pos = 0) const { return str().find(s, pos); }
+	size_type rfind(char c, size_type pos = std::string::npos) const { return str().rfind(c, pos); }
+	std::string substr(size_type pos = 0, size_type n = std::string::npos) const { return str().substr(pos, n); }
+
+	/** Two PooledStrings are equal exactly when they share a pool entry */
+	bool operator==(const PooledString& other) const { return entry == other.entry; }
+	bool operator!=(const PooledString& other) const { return entry != other.entry; }
+
+	/** Get the number of values in the pool */
+	static size_t GetPoolSize() { return GetPool().size(); }
+
+	/** Get the memory used by the pool, beyond the PooledStrings themselves */
+	static size_t GetPoolMemory();
+};
+
+inline bool operator==(const PooledString& a, const std::string& b) { return a.str() == b; }
+inline bool operator==(const std::string& a, const PooledString& b) { return a == b.str(); }
+inline bool operator==(const PooledString& a, const char* b) { return a.str() == b; }
+inline bool operator==(const char* a, const PooledString& b) { return a == b.str(); }
+inline bool operator!=(const PooledString& a, const std::string& b) { return a.str() != b; }
+inline bool operator!=(const std::string& a, const PooledString& b) { return a != b.str(); }
+inline bool operator!=(const PooledString& a, const char* b) { return a.str() != b; }
+inline bool operator!=(const char* a, const PooledString& b) { return a != b.str(); }
+
+inline std::string operator+(const PooledString& a, const std::string& b) { return a.str() + b; }
+inline std::string operator+(const std::string& a, const PooledString& b) { return a + b.str(); }
+inline std::string operator+(const PooledString& a, const char* b) { return a.str() + b; }
+inline std::string operator+(const char* a, const PooledString& b) { return a + b.str(); }
+inline std::string operator+(const PooledString& a, char b) { return a.str() + b; }
+inline std::string operator+(char a, const PooledString& b) { return a + b.str(); }
+
+inline std::ostream& operator<<(std::ostream& os, const PooledString& str) { return os << str.str(); }
+
+#endif
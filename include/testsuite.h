@@ -29,6 +29,19 @@ class TestSuite
 	bool DoWildTests();
 	bool DoCommaSepStreamTests();
 	bool DoSpaceSepStreamTests();
+	bool DoRecvQBenchmarks();
+	bool DoSocketEngineBenchmarks();
+	bool DoAcceptBenchmarks();
+	bool DoTimerBenchmarks();
+	bool DoLogWriterBenchmarks();
+	bool DoMicroBenchmarks();
+	bool DoHashTableBenchmarks();
+	bool DoMembershipBenchmarks();
+	bool DoIOThreadBenchmarks();
+	bool DoCaseMapTests();
+	bool DoPooledStringTests();
+	bool DoBanCacheTests();
+	bool DoExtensionSlotTests();
 };
 
 #endif
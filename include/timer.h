@@ -22,11 +22,12 @@
 #ifndef INSPIRCD_TIMER_H
 #define INSPIRCD_TIMER_H
 
-/** Timer class for one-second resolution timers
+/** Timer class for one-second or one-millisecond resolution timers
  * Timer provides a facility which allows module
  * developers to create one-shot timers. The timer
  * can be made to trigger at any time up to a one-second
- * resolution. To use Timer, inherit a class from
+ * resolution, or a one-millisecond resolution if it is
+ * created with the millisecond constructor. To use Timer, inherit a class from
  * Timer, then insert your inherited class into the
  * queue using Server::AddTimer(). The Tick() method of
  * your object (which you should override) will be called
@@ -38,12 +39,28 @@ class CoreExport Timer
 	/** The triggering time
 	 */
 	time_t trigger;
+	/** Millisecond within the triggering second, or -1 for a timer with
+	 * one-second resolution, which triggers on the first tick after the
+	 * triggering second
+	 */
+	long trigger_ms;
 	/** Number of seconds between triggers
 	 */
 	long secs;
+	/** Number of milliseconds between triggers, for a millisecond timer
+	 */
+	unsigned long msecs;
 	/** True if this is a repeating timer
 	 */
 	bool repeat;
+	/** Next timer in the same timer wheel slot
+	 */
+	Timer* next;
+	/** The pointer which points at this timer, or NULL if it is not queued
+	 */
+	Timer** prev;
+
+	friend class TimerManager;
  public:
 	/** Default constructor, initializes the triggering time
 	 * @param secs_from_now The number of seconds from now to trigger the timer
@@ -53,8 +70,29 @@ class CoreExport Timer
 	Timer(long secs_from_now, time_t now, bool repeating = false)
 	{
 		trigger = now + secs_from_now;
+		trigger_ms = -1;
 		secs = secs_from_now;
+		msecs = secs_from_now * 1000;
 		repeat = repeating;
+		next = NULL;
+		prev = NULL;
+	}
+
+	/** Constructor for a timer with one-millisecond resolution
+	 * @param msecs_from_now The number of milliseconds from now to trigger the timer
+	 * @param now The time now, usually ServerInstance->Time_ts()
+	 * @param repeating Repeat this timer every msecs_from_now milliseconds if set to true
+	 */
+	Timer(unsigned long msecs_from_now, const timespec& now, bool repeating = false)
+	{
+		unsigned long ms = now.tv_nsec / 1000000 + msecs_from_now;
+		trigger = now.tv_sec + ms / 1000;
+		trigger_ms = ms % 1000;
+		secs = msecs_from_now / 1000;
+		msecs = msecs_from_now;
+		repeat = repeating;
+		next = NULL;
+		prev = NULL;
 	}
 
 	/** Default destructor, does nothing.
@@ -68,7 +106,10 @@ class CoreExport Timer
 		return trigger;
 	}
 
-	/** Sets the trigger timeout to a new value
+	/** Sets the trigger timeout to a new value.
+	 * If the timer is already queued, the new time is picked up when
+	 * the time it was queued for comes round; it can be delayed but not
+	 * brought forward this way.
 	 */
 	virtual void SetTimer(time_t t)
 	{
@@ -77,7 +118,9 @@ class CoreExport Timer
 
 	/** Called when the timer ticks.
 	 * You should override this method with some useful code to
-	 * handle the tick event.
+	 * handle the tick event. A timer may requeue itself from here
+	 * with SetTimer() and TimerManager::AddTimer(), in which case it
+	 * is neither repeated nor deleted.
 	 */
 	virtual void Tick(time_t TIME) = 0;
 
@@ -96,6 +139,13 @@ class CoreExport Timer
 		return secs;
 	}
 
+	/** Returns the interval in milliseconds
+	 */
+	unsigned long GetMSecs()
+	{
+		return msecs;
+	}
+
 	/** Cancels the repeat state of a repeating timer.
 	 * If you call this method, then the next time your
 	 * timer ticks, it will be removed immediately after.
@@ -116,13 +166,94 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a two level timing wheel. The fine wheel has one slot
+ * per millisecond and covers the next few seconds; the coarse wheel has one
+ * slot per 1024 milliseconds and covers a little over an hour. Each slot holds
+ * a list of the timers which trigger at a time that hashes to it. Adding and
+ * deleting a timer is constant time, each tick only looks at the occupied
+ * fine slots for the time which has passed since the last one, and coarse
+ * slots are moved down into the fine wheel as their time comes near. Timers
+ * further in the future than the coarse wheel stay in their slot for as many
+ * turns of it as they need.
+ *
+ * Times inside the wheel are counted in milliseconds from the first time the
+ * manager is used, in an unsigned long which is allowed to wrap.
  */
 class CoreExport TimerManager
 {
  protected:
-	/** A list of all pending timers
+	/** Number of slots in each wheel, which must be a power of two
+	 */
+	static const unsigned int WHEEL_SIZE = 4096;
+
+	/** Milliseconds covered by each coarse slot, which must be a power of two
+	 */
+	static const unsigned int COARSE_MS = 1024;
+
+	/** Number of bits in a word of the occupied slot map
+	 */
+	static const unsigned int WORD_BITS = sizeof(unsigned long) * 8;
+
+	/** The slots of the fine wheel, indexed by time
+	 */
+	Timer* Wheel[WHEEL_SIZE];
+
+	/** The slots of the coarse wheel, indexed by time / COARSE_MS
+	 */
+	Timer* Coarse[WHEEL_SIZE];
+
+	/** One bit per slot, set when a timer is linked into it. Bits are
+	 * cleared when the slot is checked, not when a timer is deleted, so
+	 * a set bit only means the slot might be occupied.
 	 */
-	std::vector<Timer *> Timers;
+	unsigned long Occupied[WHEEL_SIZE / WORD_BITS];
+
+	/** The second which millisecond times are counted from, i.e. when the
+	 * timer manager was created
+	 */
+	time_t Epoch;
+
+	/** The time the wheel has been turned up to: every slot for a time at
+	 * or before this has been checked
+	 */
+	unsigned long Position;
+
+	/** The start of the first coarse slot which has not yet been moved
+	 * down into the fine wheel; timers due before this go in the fine wheel
+	 */
+	unsigned long CoarseEnd;
+
+	/** Number of pending timers
+	 */
+	size_t Count;
+
+	/** Convert a time to milliseconds since the epoch
+	 */
+	unsigned long ToMS(time_t sec, long ms);
+
+	/** Get the time at which a timer is next due, in milliseconds since the epoch
+	 */
+	unsigned long DueMS(Timer* T);
+
+	/** Find the next slot after Position which might hold a timer
+	 * @param limit The last time to look at
+	 * @param when Set to the time of the slot found
+	 * @return True if a slot was found at or before limit
+	 */
+	bool NextOccupied(unsigned long limit, unsigned long& when);
+
+	/** Move the coarse slots which the fine wheel now covers down into it
+	 */
+	void Cascade();
+
+	/** Link a timer into the slot for the time at which it is next due
+	 */
+	void Link(Timer* T);
+
+	/** Unlink a timer from the slot it is in
+	 */
+	static void Unlink(Timer* T);
 
  public:
 	/** Constructor
@@ -130,11 +261,24 @@ class CoreExport TimerManager
 	TimerManager();
 	~TimerManager();
 
-	/** Tick all pending Timers
+	/** Tick all pending Timers which are due at the start of the given second
 	 * @param TIME the current system time
 	 */
 	void TickTimers(time_t TIME);
 
+	/** Tick all pending Timers which are due
+	 * @param now The current system time, usually ServerInstance->Time_ts()
+	 */
+	void TickTimers(const timespec& now);
+
+	/** Get how long the socket engine may wait for events before a timer
+	 * becomes due
+	 * @param maxms The longest time to return
+	 * @return The number of milliseconds until the next timer is due,
+	 * between 0 and maxms
+	 */
+	int GetNextTimeout(int maxms);
+
 	/** Add an Timer
 	 * @param T an Timer derived class to add
 	 * @param secs_from_now You may set this to the number of seconds
@@ -150,6 +294,10 @@ class CoreExport TimerManager
 	 */
 	void DelTimer(Timer* T);
 
+	/** Get the number of pending timers
+	 */
+	size_t GetTimerCount() const { return Count; }
+
 	/** Compares two timers
 	 */
 	static bool TimerComparison( Timer *one,  Timer*two);
@@ -34,6 +34,8 @@ class DNSRequest;
 class Extensible;
 class FakeUser;
 class InspIRCd;
+class IOConnection;
+class IOThreadPool;
 class LocalUser;
 class Membership;
 class Module;
@@ -43,6 +45,7 @@ class ServerConfig;
 class ServerLimits;
 class Thread;
 class User;
+class UserIOHandler;
 class UserResolver;
 class XLine;
 class XLineManager;
@@ -52,20 +55,14 @@ struct ModResult;
 struct ResourceRecord;
 
 #include "hashcomp.h"
+#include "flat_hash.h"
+#include "dense_map.h"
 #include "base.h"
 
-#if defined(WINDOWS) && !defined(HASHMAP_DEPRECATED)
-	typedef nspace::hash_map<std::string, User*, nspace::hash_compare<std::string, std::less<std::string> > > user_hash;
-	typedef nspace::hash_map<std::string, Channel*, nspace::hash_compare<std::string, std::less<std::string> > > chan_hash;
-#else
-	#ifdef HASHMAP_DEPRECATED
-		typedef nspace::hash_map<std::string, User*, nspace::insensitive, irc::StrHashComp> user_hash;
-		typedef nspace::hash_map<std::string, Channel*, nspace::insensitive, irc::StrHashComp> chan_hash;
-	#else
-		typedef nspace::hash_map<std::string, User*, nspace::hash<std::string>, irc::StrHashComp> user_hash;
-		typedef nspace::hash_map<std::string, Channel*, nspace::hash<std::string>, irc::StrHashComp> chan_hash;
-	#endif
-#endif
+/** Nick and UUID to user maps, case insensitive */
+typedef irc::flat_hash_map<User*> user_hash;
+/** Channel name to channel map, case insensitive */
+typedef irc::flat_hash_map<Channel*> chan_hash;
 
 /** A list of failed port bindings, used for informational purposes on startup */
 typedef std::vector<std::pair<std::string, std::string> > FailedPortList;
@@ -121,8 +118,8 @@ typedef std::map<std::string, file_cache> ConfigFileCache;
  */
 typedef nspace::hash_map<std::string,Command*> Commandtable;
 
-/** Membership list of a channel */
-typedef std::map<User*, Membership*> UserMembList;
+/** Membership list of a channel, kept packed so that sending to every member reads it in order */
+typedef irc::dense_map<User*, Membership*> UserMembList;
 /** Iterator of UserMembList */
 typedef UserMembList::iterator UserMembIter;
 /** const Iterator of UserMembList */
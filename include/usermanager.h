@@ -31,6 +31,10 @@ class CoreExport UserManager
 	/** Map of local ip addresses for clone counting
 	 */
 	clonemap local_clones;
+
+	/** Local users queued by CheckReady() since the last call to DoReadyChecks()
+	 */
+	std::vector<LocalUser*> ready_checks;
  public:
 	~UserManager()
 	{
@@ -90,6 +94,25 @@ class CoreExport UserManager
 	 */
 	void QuitUser(User *user, const std::string &quitreason, const char* operreason = "");
 
+	/** Ask for a local user to be connected as soon as they have sent NICK and
+	 * USER, their DNS lookup has finished, and no module holds them back in
+	 * OnCheckReady any more. The check is made before the socket engine next
+	 * waits for events, so this is safe to call from any handler. Users which
+	 * nothing calls this for are still checked once a second.
+	 * @param user The user to check; NULL is ignored
+	 */
+	void CheckReady(LocalUser* user);
+
+	/** Remove a user from the queue of CheckReady() calls, when they are culled
+	 * @param user The user to remove
+	 */
+	void CancelReadyCheck(LocalUser* user);
+
+	/** Connect the users queued by CheckReady() which are now ready. Called
+	 * from the main loop.
+	 */
+	void DoReadyChecks();
+
 	/** Add a user to the local clone map
 	 * @param user The user to add
 	 */
@@ -254,12 +254,17 @@ class CoreExport User : public Extensible
 	/** Hostname of connection.
 	 * This should be valid as per RFC1035.
 	 */
-	std::string host;
+	PooledString host;
 
 	/** Time that the object was instantiated (used for TS calculation etc)
 	*/
 	time_t age;
 
+	/** Changed whenever the nick, ident or host changes (by InvalidateCache()),
+	 * so that ban check results cached on each Membership can tell they are out of date
+	 */
+	unsigned long bangeneration;
+
 	/** Time the connection was created, set in the constructor. This
 	 * may be different from the time the user's classbase object was
 	 * created.
@@ -290,12 +295,12 @@ class CoreExport User : public Extensible
 	/** The users ident reply.
 	 * Two characters are added to the user-defined limit to compensate for the tilde etc.
 	 */
-	std::string ident;
+	PooledString ident;
 
 	/** The host displayed to non-opers (used for cloaking etc).
 	 * This usually matches the value of User::host.
 	 */
-	std::string dhost;
+	PooledString dhost;
 
 	/** The users full name (GECOS).
 	 */
@@ -324,7 +329,7 @@ class CoreExport User : public Extensible
 
 	/** The server the user is connected to.
 	 */
-	const std::string server;
+	const PooledString server;
 
 	/** The user's away message.
 	 * If this string is empty, the user is not marked as away.
@@ -425,6 +430,11 @@ class CoreExport User : public Extensible
 	 */
 	void InvalidateCache();
 
+	/** Get the heap storage used by this user's strings, for /stats z.
+	 * Pooled strings are left out, as they are counted with the pool.
+	 */
+	size_t GetStringMemory() const;
+
 	/** Create a displayable mode string for this users snomasks
 	 * @return The notice mask character sequence
 	 */
@@ -721,9 +731,22 @@ class CoreExport UserIOHandler : public StreamSocket
 {
  public:
 	LocalUser* const user;
-	UserIOHandler(LocalUser* me) : user(me) {}
+	/** The I/O thread connection servicing this socket, or NULL if it is
+	 * serviced by the socket engine on the main thread
+	 */
+	IOConnection* conn;
+	UserIOHandler(LocalUser* me) : user(me), conn(NULL) {}
 	void OnDataReady();
 	void OnError(BufferedSocketError error);
+	void Close();
+
+	/** Called with data read by an I/O thread, which always ends in a newline
+	 * unless the client sent an overlong line
+	 * @param data The data read
+	 */
+	void OnThreadData(const std::string& data);
+	/** Get the number of bytes waiting to be sent, whichever thread is sending them */
+	size_t getSendQSize() const;
 
 	/** Adds to the user's write buffer.
 	 * You may add any amount of text up to this users sendq value, if you exceed the
@@ -731,10 +754,27 @@ class CoreExport UserIOHandler : public StreamSocket
 	 * @param data The data to add to the write buffer
 	 */
 	void AddWriteBuf(const std::string &data);
+	/** Adds a shared buffer to the user's write buffer, without copying it.
+	 * The same sendq limits apply as for AddWriteBuf(const std::string&).
+	 * @param data The buffer to add to the write buffer
+	 */
+	void AddWriteBuf(SharedBuffer* data);
 };
 
 typedef unsigned int already_sent_t;
 
+/** Checks a local user for ping and registration timeouts, and decays their
+ * flood penalty. There is one for each local user; it is scheduled for the
+ * next of these deadlines, so that users with nothing due are never looked at.
+ */
+class CoreExport UserCheckTimer : public Timer
+{
+ public:
+	LocalUser* const user;
+	UserCheckTimer(LocalUser* me);
+	void Tick(time_t now);
+};
+
 class CoreExport LocalUser : public User
 {
 	/** A list of channels the user has a pending invite to.
@@ -794,6 +834,24 @@ class CoreExport LocalUser : public User
 	 */
 	time_t nping;
 
+	/** The time the connection was accepted, for the registration time statistics
+	 */
+	timespec accepted;
+
+	/** True if this user is queued for UserManager::DoReadyChecks()
+	 */
+	bool ready_check;
+
+	/** Timer which checks this user when a deadline is due, or NULL once the user has quit
+	 */
+	UserCheckTimer* checktimer;
+
+	/** Make sure this user is checked no later than the given time,
+	 * e.g. because their flood penalty needs to decay.
+	 * @param when The latest time at which the user should be checked
+	 */
+	void ScheduleCheck(time_t when);
+
 	/** This value contains how far into the penalty threshold the user is.
 	 * This is used either to enable fake lag or for excess flood quits
 	 */
@@ -827,6 +885,29 @@ class CoreExport LocalUser : public User
 	void Write(const std::string& text);
 	void Write(const char*, ...) CUSTOM_PRINTF(2, 3);
 
+	/** Write a line prepared by MakeLine() to this user.
+	 * Use this when the same line goes to many users; the line is queued
+	 * by reference rather than being copied into every sendq.
+	 * @param line The line to send, including its CR/LF
+	 */
+	void Write(SharedBuffer* line);
+
+	/** Write a per-user prefix followed by a tail prepared by MakeLine()
+	 * to this user, for lines which differ only at the start (e.g. the
+	 * target nick of a NOTICE).
+	 * @param prefix The text to send before the shared tail
+	 * @param tail The shared tail of the line, including its CR/LF
+	 */
+	void Write(const std::string& prefix, SharedBuffer* tail);
+
+	/** Render a line of text into a buffer which can be sent to any number
+	 * of local users with Write(SharedBuffer*). The text is cropped to
+	 * MAXBUF - 2 characters and terminated with CR/LF.
+	 * @param text The line to render
+	 * @return The rendered line
+	 */
+	static reference<SharedBuffer> MakeLine(const std::string& text);
+
 	/** Returns the list of channels this user has been invited to but has not yet joined.
 	 * @return A list of channels the user is invited to
 	 */
@@ -163,6 +163,7 @@ class CoreExport KLine : public XLine
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
+		mask.Compile("*", this->identmask, this->hostmask);
 	}
 
 	/** Destructor
@@ -190,6 +191,10 @@ class CoreExport KLine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The ident and host masks compiled for matching
+	 */
+	BanMask mask;
+
 	std::string matchtext;
 };
 
@@ -211,6 +216,7 @@ class CoreExport GLine : public XLine
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
+		mask.Compile("*", this->identmask, this->hostmask);
 	}
 
 	/** Destructor
@@ -236,6 +242,10 @@ class CoreExport GLine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The ident and host masks compiled for matching
+	 */
+	BanMask mask;
+
 	std::string matchtext;
 };
 
@@ -257,6 +267,7 @@ class CoreExport ELine : public XLine
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
+		mask.Compile("*", this->identmask, this->hostmask);
 	}
 
 	~ELine()
@@ -282,6 +293,10 @@ class CoreExport ELine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The ident and host masks compiled for matching
+	 */
+	BanMask mask;
+
 	std::string matchtext;
 };
 
@@ -300,6 +315,7 @@ class CoreExport ZLine : public XLine
 	ZLine(time_t s_time, long d, std::string src, std::string re, std::string ip)
 		: XLine(s_time, d, src, re, "Z"), ipaddr(ip)
 	{
+		mask.Compile("*", "*", this->ipaddr);
 	}
 
 	/** Destructor
@@ -321,6 +337,10 @@ class CoreExport ZLine : public XLine
 	/** IP mask (no ident part)
 	 */
 	std::string ipaddr;
+
+	/** The IP mask compiled for matching
+	 */
+	BanMask mask;
 };
 
 /** QLine class
@@ -338,6 +358,7 @@ class CoreExport QLine : public XLine
 	QLine(time_t s_time, long d, std::string src, std::string re, std::string nickname)
 		: XLine(s_time, d, src, re, "Q"), nick(nickname)
 	{
+		nickpattern.Compile(this->nick);
 	}
 
 	/** Destructor
@@ -358,6 +379,10 @@ class CoreExport QLine : public XLine
 	/** Nickname mask
 	 */
 	std::string nick;
+
+	/** The nickname mask compiled for matching
+	 */
+	MatchPattern nickpattern;
 };
 
 /** XLineFactory is used to generate an XLine pointer, given just the
@@ -0,0 +1,67 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+// socketengine_uring needs wait timeouts (5.11+), and is only worth using
+// with multishot polls (5.13+). Those have no feature flag of their own, so
+// try one on a readable pipe: kernels without them fail it with -EINVAL.
+static bool probe(int fd, const struct io_uring_params& params)
+{
+	size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	char* sq = static_cast<char*>(mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING));
+	char* cq = static_cast<char*>(mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING));
+	struct io_uring_sqe* sqes = static_cast<struct io_uring_sqe*>(mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES));
+	int fds[2];
+	if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED || pipe(fds) || write(fds[1], "x", 1) != 1)
+		return false;
+
+	unsigned int tail = *reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+	unsigned int index = tail & *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	memset(&sqes[index], 0, sizeof(sqes[index]));
+	sqes[index].opcode = IORING_OP_POLL_ADD;
+	sqes[index].fd = fds[0];
+	sqes[index].poll32_events = POLLIN;
+	sqes[index].len = IORING_POLL_ADD_MULTI;
+	reinterpret_cast<unsigned int*>(sq + params.sq_off.array)[index] = index;
+	__atomic_store_n(reinterpret_cast<unsigned int*>(sq + params.sq_off.tail), tail + 1, __ATOMIC_RELEASE);
+	if (syscall(__NR_io_uring_enter, fd, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0) != 1)
+		return false;
+
+	unsigned int head = *reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+	unsigned int mask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+	const struct io_uring_cqe& cqe = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes)[head & mask];
+	return head != __atomic_load_n(reinterpret_cast<unsigned int*>(cq + params.cq_off.tail), __ATOMIC_ACQUIRE)
+		&& cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE);
+}
+
+int main() {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, 8, &params);
+	if (fd < 0)
+		return 1;
+	return !(params.features & IORING_FEAT_EXT_ARG) || !probe(fd, params);
+}
@@ -265,11 +265,17 @@ InspIRCd 1.0.x, are also allowed.
   --enable-openssl             Enable OpenSSL module [no]
   --enable-epoll               Enable epoll() where supported [set]
   --enable-kqueue              Enable kqueue() where supported [set]
+  --enable-uring               Use io_uring to wait for socket
+                               readiness instead of epoll()
+                               where supported [not set]
   --disable-epoll              Do not enable epoll(), fall back
                                to select() [not set]
   --disable-kqueue             Do not enable kqueue(), fall back
                                to select() [not set]
+  --disable-uring              Do not use io_uring [set]
   --disable-ipv6               Do not build IPv6 native InspIRCd [not set]
+  --disable-hook-profiling     Do not build in the timing of module
+                               hooks for /stats h [not set]
   --with-cc=[filename]         Use an alternative compiler to
                                build InspIRCd [g++]
   --with-maxbuf=[n]            Change the per message buffer size [512]
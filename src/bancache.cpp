@@ -59,7 +59,7 @@ BanCacheHit *BanCacheManager::GetHit(const std::string &ip)
 	{
 		if (ServerInstance->Time() > i->second->Expiry)
 		{
-			ServerInstance->Logs->Log("BANCACHE", DEBUG, "Hit on " + ip + " is out of date, removing!");
+			ServerInstance->Logs->Log("BANCACHE", DEBUG, "Hit on %s is out of date, removing!", ip.c_str());
 			RemoveHit(i->second);
 			return NULL; // out of date
 		}
@@ -98,9 +98,9 @@ unsigned int BanCacheManager::RemoveEntries(const std::string &type, bool positi
 	BanCacheHash::iterator safei;
 
 	if (positive)
-		ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing positive hits for " + type);
+		ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing positive hits for %s", type.c_str());
 	else
-		ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing negative hits for " + type);
+		ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing negative hits for %s", type.c_str());
 
 	for (BanCacheHash::iterator n = BanHash->begin(); n != BanHash->end(); )
 	{
@@ -115,7 +115,7 @@ unsigned int BanCacheManager::RemoveEntries(const std::string &type, bool positi
 			if ((positive && !b->Reason.empty()) || b->Reason.empty())
 			{
 				/* we need to remove this one. */
-				ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing a hit on " + b->IP);
+				ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCacheManager::RemoveEntries(): Removing a hit on %s", b->IP.c_str());
 				delete b;
 				b = NULL;
 				BanHash->erase(n); // WORD TO THE WISE: don't use RemoveHit here, because we MUST remove the iterator in a safe way.
@@ -0,0 +1,261 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "banmask.h"
+
+static inline bool CompareMapped(const char* str, const std::string& text, const unsigned char* map)
+{
+	const unsigned char* s = (const unsigned char*)str;
+	const unsigned char* t = (const unsigned char*)text.data();
+	for (size_t i = 0; i < text.length(); i++)
+	{
+		if (map[s[i]] != map[t[i]])
+			return false;
+	}
+	return true;
+}
+
+void MatchPattern::Compile(const std::string& pattern)
+{
+	std::string::size_type first = pattern.find_first_of("*?");
+	if (first == std::string::npos)
+	{
+		type = PATTERN_EXACT;
+		text = pattern;
+		return;
+	}
+
+	if (pattern.find_first_not_of('*') == std::string::npos)
+	{
+		type = PATTERN_ANY;
+		text.clear();
+		return;
+	}
+
+	std::string::size_type last = pattern.find_last_of("*?");
+	if (first == last && pattern[first] == '*')
+	{
+		if (first == pattern.length() - 1)
+		{
+			type = PATTERN_PREFIX;
+			text.assign(pattern, 0, first);
+			return;
+		}
+		if (first == 0)
+		{
+			type = PATTERN_SUFFIX;
+			text.assign(pattern, 1, std::string::npos);
+			return;
+		}
+	}
+
+	type = PATTERN_WILDCARD;
+	text = pattern;
+}
+
+bool MatchPattern::Match(const char* str, size_t len, const unsigned char* map) const
+{
+	switch (type)
+	{
+		case PATTERN_ANY:
+			return true;
+		case PATTERN_EXACT:
+			return len == text.length() && CompareMapped(str, text, map);
+		case PATTERN_PREFIX:
+			return len >= text.length() && CompareMapped(str, text, map);
+		case PATTERN_SUFFIX:
+			return len >= text.length() && CompareMapped(str + len - text.length(), text, map);
+		default:
+			return InspIRCd::Match(str, text.c_str(), map);
+	}
+}
+
+void BanMask::Compile(const std::string& mask)
+{
+	std::string::size_type at = mask.find('@');
+	if (at == std::string::npos)
+	{
+		valid = false;
+		return;
+	}
+
+	std::string::size_type bang = mask.find('!');
+	if (bang < at && mask.find('!', bang + 1) >= at)
+	{
+		Compile(mask.substr(0, bang), mask.substr(bang + 1, at - bang - 1), mask.substr(at + 1));
+	}
+	else
+	{
+		/* nick!ident is matched as one string, so a wildcard can take the place of the '!' */
+		Compile(mask.substr(0, at), "*", mask.substr(at + 1));
+		split = false;
+	}
+}
+
+void BanMask::Compile(const std::string& nickmask, const std::string& identmask, const std::string& hostmask)
+{
+	valid = true;
+	split = true;
+	nick.Compile(nickmask);
+	ident.Compile(identmask);
+	host.Compile(hostmask);
+
+	/* Only the part after the last '@' can be an IP range, as with irc::sockets::MatchCIDR */
+	std::string::size_type at = hostmask.rfind('@');
+	std::string range = (at == std::string::npos) ? hostmask : hostmask.substr(at + 1);
+	iscidr = false;
+	if (range.find('/') != std::string::npos)
+	{
+		cidr = irc::sockets::cidr_mask(range);
+		iscidr = (cidr.type == AF_INET || cidr.type == AF_INET6);
+	}
+}
+
+bool BanMask::Matches(User* user) const
+{
+	if (!valid)
+		return false;
+
+	const unsigned char* map = national_case_insensitive_map;
+	if (split)
+	{
+		if (!nick.Match(user->nick, map) || !ident.Match(user->ident, map))
+			return false;
+	}
+	else
+	{
+		char tomatch[MAXBUF];
+		int len = snprintf(tomatch, MAXBUF, "%s!%s", user->nick.c_str(), user->ident.c_str());
+		if (len >= MAXBUF)
+			len = MAXBUF - 1;
+		if (!nick.Match(tomatch, len, map))
+			return false;
+	}
+
+	return host.Match(user->host, map) || host.Match(user->dhost, map) || MatchesIP(user->GetIPString(), user->client_sa, map);
+}
+
+bool BanMask::MatchesHost(User* user, const unsigned char* map) const
+{
+	const char* ip = user->GetIPString();
+	if (host.Match(user->host, map) || MatchesIP(ip, user->client_sa, map))
+		return true;
+
+	/* A host that is an address other than the user's own can still fall in the range */
+	if (iscidr && user->host != ip)
+	{
+		irc::sockets::sockaddrs sa;
+		if (irc::sockets::aptosa(user->host, 0, sa))
+			return cidr.match(sa);
+	}
+	return false;
+}
+
+size_t BanIndex::HashHost(const char* str) const
+{
+	size_t hash = 2166136261U;
+	for (const unsigned char* p = (const unsigned char*)str; *p; p++)
+		hash = (hash ^ casemap[*p]) * 16777619U;
+	return hash;
+}
+
+void BanIndex::Build(const BanList& bans, unsigned long gen)
+{
+	generation = gen;
+	casemap = national_case_insensitive_map;
+	hosts.clear();
+	ranges.clear();
+	prefixes.clear();
+	others.clear();
+	extbans.clear();
+
+	for (size_t i = 0; i < bans.size(); i++)
+	{
+		const std::string& data = bans[i].data;
+		if (data.length() > 1 && data[1] == ':')
+		{
+			extbans.push_back(i);
+			continue;
+		}
+
+		const BanMask& mask = bans[i].mask;
+		if (!mask.valid)
+			continue;
+
+		bool indexed = false;
+		if (mask.iscidr)
+		{
+			ranges.push_back(std::make_pair(mask.cidr, i));
+			std::pair<unsigned char, unsigned char> prefix(mask.cidr.type, mask.cidr.length);
+			if (std::find(prefixes.begin(), prefixes.end(), prefix) == prefixes.end())
+				prefixes.push_back(prefix);
+			indexed = true;
+		}
+		if (mask.host.type == MatchPattern::PATTERN_EXACT)
+		{
+			hosts.push_back(std::make_pair(HashHost(mask.host.text.c_str()), i));
+			indexed = true;
+		}
+		if (!indexed)
+			others.push_back(i);
+	}
+
+	std::sort(hosts.begin(), hosts.end());
+	std::sort(ranges.begin(), ranges.end());
+}
+
+bool BanIndex::Matches(User* user, const BanList& bans) const
+{
+	if (!hosts.empty())
+	{
+		const char* keys[3] = { user->host.c_str(), user->dhost.c_str(), user->GetIPString() };
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			if (k == 1 && user->dhost == user->host)
+				continue;
+			std::pair<size_t, size_t> lower(HashHost(keys[k]), 0);
+			for (std::vector<std::pair<size_t, size_t> >::const_iterator i = std::lower_bound(hosts.begin(), hosts.end(), lower); i != hosts.end() && i->first == lower.first; ++i)
+			{
+				if (bans[i->second].mask.Matches(user))
+					return true;
+			}
+		}
+	}
+
+	for (std::vector<std::pair<unsigned char, unsigned char> >::const_iterator p = prefixes.begin(); p != prefixes.end(); ++p)
+	{
+		if (p->first != user->client_sa.sa.sa_family)
+			continue;
+		std::pair<irc::sockets::cidr_mask, size_t> lower(irc::sockets::cidr_mask(user->client_sa, p->second), 0);
+		for (std::vector<std::pair<irc::sockets::cidr_mask, size_t> >::const_iterator i = std::lower_bound(ranges.begin(), ranges.end(), lower); i != ranges.end() && i->first == lower.first; ++i)
+		{
+			if (bans[i->second].mask.Matches(user))
+				return true;
+		}
+	}
+
+	for (std::vector<size_t>::const_iterator i = others.begin(); i != others.end(); ++i)
+	{
+		if (bans[*i].mask.Matches(user))
+			return true;
+	}
+	return false;
+}
@@ -90,52 +90,45 @@ ServiceProvider::~ServiceProvider()
 {
 }
 
-ExtensionItem::ExtensionItem(const std::string& Key, Module* mod) : ServiceProvider(mod, Key, SERVICE_METADATA)
+ExtensionItem::ExtensionItem(const std::string& Key, Module* mod) : ServiceProvider(mod, Key, SERVICE_METADATA), slot(NO_SLOT)
 {
 }
 
 ExtensionItem::~ExtensionItem()
 {
-}
-
-void* ExtensionItem::get_raw(const Extensible* container) const
-{
-	Extensible::ExtensibleStore::const_iterator i =
-		container->extensions.find(const_cast<ExtensionItem*>(this));
-	if (i == container->extensions.end())
-		return NULL;
-	return i->second;
+	if (slot != NO_SLOT)
+		ServerInstance->Extensions.ReleaseSlot(this);
 }
 
 void* ExtensionItem::set_raw(Extensible* container, void* value)
 {
-	std::pair<Extensible::ExtensibleStore::iterator,bool> rv =
-		container->extensions.insert(std::make_pair(this, value));
-	if (rv.second)
-	{
-		return NULL;
-	}
-	else
-	{
-		void* old = rv.first->second;
-		rv.first->second = value;
-		return old;
-	}
+	if (slot == NO_SLOT)
+		ServerInstance->Extensions.AssignSlot(this);
+	std::vector<void*>& values = container->extensions.values;
+	if (slot >= values.size())
+		values.resize(slot + 1, NULL);
+	void* old = values[slot];
+	values[slot] = value;
+	return old;
 }
 
 void* ExtensionItem::unset_raw(Extensible* container)
 {
-	Extensible::ExtensibleStore::iterator i = container->extensions.find(this);
-	if (i == container->extensions.end())
+	std::vector<void*>& values = container->extensions.values;
+	if (slot >= values.size())
 		return NULL;
-	void* rv = i->second;
-	container->extensions.erase(i);
+	void* rv = values[slot];
+	values[slot] = NULL;
+	/* Keep objects which have lost their last value from walking empty slots */
+	while (!values.empty() && !values.back())
+		values.pop_back();
 	return rv;
 }
 
 void ExtensionManager::Register(ExtensionItem* item)
 {
 	types.insert(std::make_pair(item->name, item));
+	AssignSlot(item);
 }
 
 void ExtensionManager::BeginUnregister(Module* module, std::vector<reference<ExtensionItem> >& list)
@@ -146,10 +139,12 @@ void ExtensionManager::BeginUnregister(Module* module, std::vector<reference<Ext
 		std::map<std::string, reference<ExtensionItem> >::iterator me = i++;
 		ExtensionItem* item = me->second;
 		if (item->creator == module)
-		{
-			list.push_back(item);
 			types.erase(me);
-		}
+	}
+	for (std::vector<ExtensionItem*>::iterator s = slots.begin(); s != slots.end(); ++s)
+	{
+		if (*s && (*s)->creator == module)
+			list.push_back(*s);
 	}
 }
 
@@ -161,44 +156,86 @@ ExtensionItem* ExtensionManager::GetItem(const std::string& name)
 	return i->second;
 }
 
+void ExtensionManager::AssignSlot(ExtensionItem* item)
+{
+	if (item->slot != ExtensionItem::NO_SLOT)
+		return;
+	/* Reuse the lowest free slot, so that objects need as few slots as possible */
+	std::vector<ExtensionItem*>::iterator i = std::find(slots.begin(), slots.end(), (ExtensionItem*)NULL);
+	item->slot = i - slots.begin();
+	if (i == slots.end())
+		slots.push_back(item);
+	else
+		*i = item;
+}
+
+void ExtensionManager::ReleaseSlot(ExtensionItem* item)
+{
+	if (item->slot < slots.size() && slots[item->slot] == item)
+		slots[item->slot] = NULL;
+	item->slot = ExtensionItem::NO_SLOT;
+}
+
+void Extensible::ExtensibleStore::const_iterator::Skip()
+{
+	while (slot < values->size())
+	{
+		void* value = (*values)[slot];
+		ExtensionItem* item = value ? ServerInstance->Extensions.GetSlotItem(slot) : NULL;
+		if (item)
+		{
+			current = std::make_pair(item, value);
+			return;
+		}
+		slot++;
+	}
+}
+
+size_t Extensible::ExtensibleStore::size() const
+{
+	size_t count = 0;
+	for (std::vector<void*>::const_iterator i = values.begin(); i != values.end(); ++i)
+		count += (*i != NULL);
+	return count;
+}
+
 void Extensible::doUnhookExtensions(const std::vector<reference<ExtensionItem> >& toRemove)
 {
+	std::vector<void*>& values = extensions.values;
 	for(std::vector<reference<ExtensionItem> >::const_iterator i = toRemove.begin(); i != toRemove.end(); ++i)
 	{
 		ExtensionItem* item = *i;
-		ExtensibleStore::iterator e = extensions.find(item);
-		if (e != extensions.end())
+		if (item->slot < values.size() && values[item->slot])
 		{
-			item->free(e->second);
-			extensions.erase(e);
+			item->free(values[item->slot]);
+			values[item->slot] = NULL;
 		}
 	}
+	while (!values.empty() && !values.back())
+		values.pop_back();
 }
 
-static struct DummyExtensionItem : LocalExtItem
-{
-	DummyExtensionItem() : LocalExtItem("", NULL) {}
-	void free(void*) {}
-} dummy;
-
-Extensible::Extensible()
+Extensible::Extensible() : culled(false)
 {
-	extensions[&dummy] = NULL;
 }
 
 CullResult Extensible::cull()
 {
-	for(ExtensibleStore::iterator i = extensions.begin(); i != extensions.end(); ++i)
+	std::vector<void*>& values = extensions.values;
+	for (size_t slot = 0; slot < values.size(); slot++)
 	{
-		i->first->free(i->second);
+		ExtensionItem* item = values[slot] ? ServerInstance->Extensions.GetSlotItem(slot) : NULL;
+		if (item)
+			item->free(values[slot]);
 	}
-	extensions.clear();
+	values.clear();
+	culled = true;
 	return classbase::cull();
 }
 
 Extensible::~Extensible()
 {
-	if (!extensions.empty() && ServerInstance && ServerInstance->Logs)
+	if (!culled && ServerInstance && ServerInstance->Logs)
 		ServerInstance->Logs->Log("CULLLIST", DEBUG,
 			"Extensible destructor called without cull @%p", (void*)this);
 }
@@ -0,0 +1,144 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "capture.h"
+
+TrafficCapture::TrafficCapture() : file(NULL), limit(0), written(0), nextclient(1)
+{
+}
+
+TrafficCapture::~TrafficCapture()
+{
+	Stop();
+}
+
+bool TrafficCapture::Start(const std::string& name, unsigned long maxbytes)
+{
+	Stop();
+
+	file = fopen(name.c_str(), "wb");
+	if (!file)
+		return false;
+
+	filename = name;
+	limit = maxbytes;
+	written = 8;
+	nextclient = 1;
+	Histogram::Now(last);
+	fwrite("IRCCAP1\n", 1, 8, file);
+
+	ServerInstance->Logs->Log("CAPTURE", DEFAULT, "Capturing client traffic to %s", filename.c_str());
+	return true;
+}
+
+void TrafficCapture::Stop()
+{
+	if (!file)
+		return;
+	fclose(file);
+	file = NULL;
+	/* Clients are numbered afresh in each capture */
+	clients.clear();
+	ServerInstance->Logs->Log("CAPTURE", DEFAULT, "Stopped capturing client traffic to %s after %lu bytes", filename.c_str(), written);
+	filename.clear();
+}
+
+void TrafficCapture::WriteNumber(unsigned long value)
+{
+	do
+	{
+		unsigned char byte = value & 0x7F;
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+		fputc(byte, file);
+		written++;
+	} while (value);
+}
+
+bool TrafficCapture::WriteRecord(char type, unsigned long client, size_t length)
+{
+	/* The most a record header can take is a type byte and three 10 byte numbers */
+	if (limit && written + 31 + length > limit)
+	{
+		ServerInstance->SNO->WriteGlobalSno('a', "Traffic capture to %s has reached its limit of %lu bytes and has stopped", filename.c_str(), limit);
+		Stop();
+		return false;
+	}
+
+	timespec now;
+	Histogram::Now(now);
+	fputc(type, file);
+	written++;
+	WriteNumber(Histogram::Elapsed(last, now));
+	WriteNumber(client);
+	last = now;
+	return true;
+}
+
+void TrafficCapture::AddLine(LocalUser* user, const std::string& line)
+{
+	unsigned long& client = clients[user];
+	if (!client)
+		client = nextclient++;
+
+	/* Leave passwords out of the file. Lines from clients don't have a prefix.
+	 * Everything after the command is masked, except the oper name of OPER,
+	 * so that it doesn't matter how the password is spaced or quoted.
+	 */
+	std::string::size_type end = line.length();
+	std::string::size_type start = line.find_first_not_of(' ');
+	std::string::size_type space = (start == std::string::npos) ? start : line.find(' ', start);
+	if (space != std::string::npos)
+	{
+		std::string command(line, start, space - start);
+		std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+		if (command == "PASS" || command == "AUTHENTICATE")
+			end = space + 1;
+		else if (command == "OPER")
+		{
+			std::string::size_type name = line.find_first_not_of(' ', space);
+			if (name == std::string::npos || line[name] == ':')
+				end = space + 1;
+			else
+				end = std::min(line.find(' ', name), line.length() - 1) + 1;
+		}
+	}
+	size_t length = (end == line.length()) ? end : end + 1;
+
+	if (!WriteRecord('L', client, length))
+		return;
+	WriteNumber(length);
+	fwrite(line.data(), 1, end, file);
+	if (end != line.length())
+		fputc('*', file);
+	written += length;
+}
+
+void TrafficCapture::AddQuit(LocalUser* user)
+{
+	std::map<LocalUser*, unsigned long>::iterator i = clients.find(user);
+	if (i == clients.end())
+		return;
+	unsigned long client = i->second;
+	clients.erase(i);
+	WriteRecord('Q', client, 0);
+}
@@ -40,6 +40,7 @@ Channel::Channel(const std::string &cname, time_t ts)
 	this->age = ts ? ts : ServerInstance->Time();
 
 	maxbans = topicset = 0;
+	bangeneration = 1;
 	modes.reset();
 }
 
@@ -427,9 +428,61 @@ bool Channel::IsBanned(User* user)
 	if (result != MOD_RES_PASSTHRU)
 		return (result == MOD_RES_DENY);
 
-	for (BanList::iterator i = this->bans.begin(); i != this->bans.end(); i++)
+	if (bans.empty())
+		return false;
+
+	if (!banindex.IsCurrent(bangeneration))
+		banindex.Build(bans, bangeneration);
+
+	/* Whether the ordinary bans match only changes when the ban list or the
+	 * user's nick, ident or host does, so members keep the answer until then.
+	 * Extbans depend on whatever the module providing them looks at, so they
+	 * are checked every time.
+	 */
+	Membership* memb = GetUser(user);
+	bool banned;
+	if (memb && memb->chanbangeneration == bangeneration && memb->userbangeneration == user->bangeneration)
 	{
-		if (CheckBan(user, i->data))
+		banned = memb->banned;
+	}
+	else
+	{
+		if (ServerInstance->Modules->EventHandlers[I_OnCheckBan].empty())
+		{
+			banned = banindex.Matches(user, bans);
+		}
+		else
+		{
+			/* Modules such as m_cloaking match ordinary bans against more than the
+			 * index knows about. Modules which only provide extbans use OnCheckExtBan,
+			 * so they don't force this.
+			 */
+			banned = false;
+			for (BanList::iterator i = this->bans.begin(); i != this->bans.end(); i++)
+			{
+				if (i->data[1] != ':' && CheckBan(user, *i))
+				{
+					banned = true;
+					break;
+				}
+			}
+		}
+
+		if (memb)
+		{
+			memb->banned = banned;
+			memb->chanbangeneration = bangeneration;
+			memb->userbangeneration = user->bangeneration;
+		}
+	}
+
+	if (banned)
+		return true;
+
+	const std::vector<size_t>& extbans = banindex.GetExtBans();
+	for (std::vector<size_t>::const_iterator i = extbans.begin(); i != extbans.end(); ++i)
+	{
+		if (CheckBan(user, bans[*i]))
 			return true;
 	}
 	return false;
@@ -437,8 +490,11 @@ bool Channel::IsBanned(User* user)
 
 bool Channel::CheckBan(User* user, const std::string& mask)
 {
-	ModResult result;
-	FIRST_MOD_RESULT(OnCheckBan, result, (user, this, mask));
+	ModResult result = MOD_RES_PASSTHRU;
+	if (mask[1] == ':')
+		FIRST_MOD_RESULT(OnCheckExtBan, result, (user, this, mask));
+	if (result == MOD_RES_PASSTHRU)
+		FIRST_MOD_RESULT(OnCheckBan, result, (user, this, mask));
 	if (result != MOD_RES_PASSTHRU)
 		return (result == MOD_RES_DENY);
 
@@ -446,22 +502,23 @@ bool Channel::CheckBan(User* user, const std::string& mask)
 	if (mask[1] == ':')
 		return false;
 
-	std::string::size_type at = mask.find('@');
-	if (at == std::string::npos)
+	return BanMask(mask).Matches(user);
+}
+
+bool Channel::CheckBan(User* user, const BanItem& ban)
+{
+	ModResult result = MOD_RES_PASSTHRU;
+	if (ban.data[1] == ':')
+		FIRST_MOD_RESULT(OnCheckExtBan, result, (user, this, ban.data));
+	if (result == MOD_RES_PASSTHRU)
+		FIRST_MOD_RESULT(OnCheckBan, result, (user, this, ban.data));
+	if (result != MOD_RES_PASSTHRU)
+		return (result == MOD_RES_DENY);
+
+	if (ban.data[1] == ':')
 		return false;
 
-	char tomatch[MAXBUF];
-	snprintf(tomatch, MAXBUF, "%s!%s", user->nick.c_str(), user->ident.c_str());
-	std::string prefix = mask.substr(0, at);
-	if (InspIRCd::Match(tomatch, prefix, NULL))
-	{
-		std::string suffix = mask.substr(at + 1);
-		if (InspIRCd::Match(user->host, suffix, NULL) ||
-			InspIRCd::Match(user->dhost, suffix, NULL) ||
-			InspIRCd::MatchCIDR(user->GetIPString(), suffix, NULL))
-			return true;
-	}
-	return false;
+	return ban.mask.Matches(user);
 }
 
 ModResult Channel::GetExtBanStatus(User *user, char type)
@@ -470,11 +527,19 @@ ModResult Channel::GetExtBanStatus(User *user, char type)
 	FIRST_MOD_RESULT(OnExtBanCheck, rv, (user, this, type));
 	if (rv != MOD_RES_PASSTHRU)
 		return rv;
-	for (BanList::iterator i = this->bans.begin(); i != this->bans.end(); i++)
+	if (bans.empty())
+		return MOD_RES_PASSTHRU;
+
+	if (!banindex.IsCurrent(bangeneration))
+		banindex.Build(bans, bangeneration);
+
+	const std::vector<size_t>& extbans = banindex.GetExtBans();
+	for (std::vector<size_t>::const_iterator i = extbans.begin(); i != extbans.end(); ++i)
 	{
-		if (i->data[0] == type && i->data[1] == ':')
+		const std::string& data = bans[*i].data;
+		if (data[0] == type)
 		{
-			std::string val = i->data.substr(2);
+			std::string val = data.substr(2);
 			if (CheckBan(user, val))
 				return MOD_RES_DENY;
 		}
@@ -592,12 +657,13 @@ void Channel::WriteChannel(User* user, const std::string &text)
 		return;
 
 	snprintf(tb,MAXBUF,":%s %s", user->GetFullHost().c_str(), text.c_str());
-	std::string out = tb;
+	reference<SharedBuffer> out = LocalUser::MakeLine(tb);
 
 	for (UserMembIter i = userlist.begin(); i != userlist.end(); i++)
 	{
-		if (IS_LOCAL(i->first))
-			i->first->Write(out);
+		LocalUser* u = IS_LOCAL(i->first);
+		if (u)
+			u->Write(out);
 	}
 }
 
@@ -621,12 +687,13 @@ void Channel::WriteChannelWithServ(const std::string& ServName, const std::strin
 	char tb[MAXBUF];
 
 	snprintf(tb,MAXBUF,":%s %s", ServName.empty() ? ServerInstance->Config->ServerName.c_str() : ServName.c_str(), text.c_str());
-	std::string out = tb;
+	reference<SharedBuffer> out = LocalUser::MakeLine(tb);
 
 	for (UserMembIter i = userlist.begin(); i != userlist.end(); i++)
 	{
-		if (IS_LOCAL(i->first))
-			i->first->Write(out);
+		LocalUser* u = IS_LOCAL(i->first);
+		if (u)
+			u->Write(out);
 	}
 }
 
@@ -669,7 +736,6 @@ void Channel::WriteAllExcept(User* user, bool serversource, char status, CUList
 	char tb[MAXBUF];
 
 	snprintf(tb,MAXBUF,":%s %s", serversource ? ServerInstance->Config->ServerName.c_str() : user->GetFullHost().c_str(), text.c_str());
-	std::string out = tb;
 
 	this->RawWriteAllExcept(user, serversource, status, except_list, std::string(tb));
 }
@@ -683,15 +749,20 @@ void Channel::RawWriteAllExcept(User* user, bool serversource, char status, CULi
 		if (mh)
 			minrank = mh->GetPrefixRank();
 	}
+	/* Render the line once, and share it between every local member */
+	reference<SharedBuffer> line;
 	for (UserMembIter i = userlist.begin(); i != userlist.end(); i++)
 	{
-		if (IS_LOCAL(i->first) && (except_list.find(i->first) == except_list.end()))
+		LocalUser* u = IS_LOCAL(i->first);
+		if (u && (except_list.find(u) == except_list.end()))
 		{
 			/* User doesn't have the status we're after */
 			if (minrank && i->second->getRank() < minrank)
 				continue;
 
-			i->first->Write(out);
+			if (!line)
+				line = LocalUser::MakeLine(out);
+			u->Write(line);
 		}
 	}
 }
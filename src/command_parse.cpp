@@ -340,7 +340,14 @@ bool CommandParser::ProcessCommand(LocalUser *user, std::string &cmd)
 		/*
 		 * WARNING: be careful, the user may be deleted soon
 		 */
-		CmdResult result = cm->second->Handle(command_p, user);
+		Command* handler = cm->second;
+		unsigned long sent = ServerInstance->stats->statsSent;
+		timespec start, end;
+		Histogram::Now(start);
+		CmdResult result = handler->Handle(command_p, user);
+		Histogram::Now(end);
+		handler->exec_time.Add(start, end);
+		handler->output_bytes += ServerInstance->stats->statsSent - sent;
 
 		FOREACH_MOD(I_OnPostCommand,OnPostCommand(command, command_p, user, result,cmd));
 		return do_more;
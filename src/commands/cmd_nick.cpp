@@ -87,6 +87,8 @@ CmdResult CommandNick::Handle (const std::vector<std::string>& parameters, User
 			if (MOD_RESULT == MOD_RES_DENY)
 				return CMD_FAILURE;
 
+			ServerInstance->Users->CheckReady(IS_LOCAL(user));
+
 			// return early to not penalize new users
 			return CMD_SUCCESS;
 		}
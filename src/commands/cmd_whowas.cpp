@@ -109,6 +109,25 @@ std::string CommandWhowas::GetStats()
 	return "Whowas entries: " +ConvToStr(whowas_size)+" ("+ConvToStr(whowas_bytes)+" bytes)";
 }
 
+void CommandWhowas::AddMemoryUsage(MemoryReport& report)
+{
+	unsigned long entries = 0;
+	size_t bytes = whowas_fifo.size() * sizeof(whowas_users_fifo::value_type);
+	for (whowas_users::iterator i = whowas.begin(); i != whowas.end(); ++i)
+	{
+		whowas_set* n = i->second;
+		bytes += MemoryReport::NodeSize(sizeof(whowas_users::value_type)) + sizeof(whowas_set) + n->size() * sizeof(WhoWasGroup*);
+		for (whowas_set::iterator j = n->begin(); j != n->end(); ++j)
+		{
+			WhoWasGroup* g = *j;
+			bytes += sizeof(WhoWasGroup) + MemoryReport::StringSize(g->host) + MemoryReport::StringSize(g->dhost) +
+				MemoryReport::StringSize(g->ident) + MemoryReport::StringSize(g->server) + MemoryReport::StringSize(g->gecos);
+		}
+		entries += n->size();
+	}
+	report.Add("whowas", entries, bytes);
+}
+
 void CommandWhowas::AddToWhoWas(User* user)
 {
 	/* if whowas disabled */
@@ -322,6 +341,16 @@ class ModuleWhoWas : public Module
 		ServerInstance->AddCommand(&cmd);
 	}
 
+	void init()
+	{
+		ServerInstance->Modules->Attach(I_OnMemoryUsage, this);
+	}
+
+	void OnMemoryUsage(MemoryReport& report)
+	{
+		cmd.AddMemoryUsage(report);
+	}
+
 	void OnRequest(Request& request)
 	{
 		WhowasRequest& req = static_cast<WhowasRequest&>(request);
@@ -479,6 +479,14 @@ void ServerConfig::Fill()
 	AdminNick = ConfValue("admin")->getString("nick", "admin");
 	ModPath = ConfValue("path")->getString("moduledir", MOD_PATH);
 	NetBufferSize = ConfValue("performance")->getInt("netbuffersize", 10240);
+	IOThreads = ConfValue("performance")->getInt("iothreads", 0);
+	ProfileHooks = ConfValue("performance")->getBool("profilehooks");
+	LogThread = ConfValue("performance")->getBool("logthread");
+	LogQueue = ConfValue("performance")->getInt("logqueue", 4 * 1024 * 1024);
+	LogQueueBlock = (ConfValue("performance")->getString("logoverflow", "drop") == "block");
+	SlowLoop = ConfValue("performance")->getInt("slowloop", 100);
+	CaptureFile = ConfValue("performance")->getString("capture");
+	CaptureLimit = ConfValue("performance")->getInt("capturelimit", 0);
 	dns_timeout = ConfValue("dns")->getInt("timeout", 5);
 	DisabledCommands = ConfValue("disabled")->getString("commands", "");
 	DisabledDontExist = ConfValue("disabled")->getBool("fakenonexistant");
@@ -522,6 +530,12 @@ void ServerConfig::Fill()
 	range(MaxConn, 0, SOMAXCONN, SOMAXCONN, "<performance:somaxconn>");
 	range(MaxTargets, 1, 31, 20, "<security:maxtargets>");
 	range(NetBufferSize, 1024, 65534, 10240, "<performance:netbuffersize>");
+#ifdef WINDOWS
+	IOThreads = 0;
+#endif
+	range(IOThreads, 0, 64, 0, "<performance:iothreads>");
+	range(SlowLoop, 0, 60000, 100, "<performance:slowloop>");
+	range(LogQueue, 64 * 1024, 1024 * 1024 * 1024, 4 * 1024 * 1024, "<performance:logqueue>");
 	range(WhoWasGroupSize, 0, 10000, 10, "<whowas:groupsize>");
 	range(WhoWasMaxGroups, 0, 1000000, 10240, "<whowas:maxgroups>");
 	range(WhoWasMaxKeep, 3600, INT_MAX, 3600, "<whowas:maxkeep>");
@@ -675,7 +689,14 @@ void ServerConfig::Apply(ServerConfig* old, const std::string &useruid)
 
 	// write once here, to try it out and make sure its ok
 	if (valid)
+	{
 		ServerInstance->WritePID(this->PID);
+		HookProfiler::enabled = ProfileHooks;
+		if (CaptureFile.empty())
+			ServerInstance->Capture->Stop();
+		else if (CaptureFile != ServerInstance->Capture->GetFile() && !ServerInstance->Capture->Start(CaptureFile, CaptureLimit))
+			errstr << "Unable to open traffic capture file " << CaptureFile << ": " << strerror(errno) << "\n";
+	}
 
 	if (old)
 	{
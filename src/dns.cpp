@@ -307,6 +307,18 @@ int DNS::PruneCache()
 	return n;
 }
 
+unsigned long DNS::GetCacheUsage(size_t& bytes)
+{
+	bytes = 0;
+	for (dnscache::iterator i = this->cache->begin(); i != this->cache->end(); i++)
+	{
+		/* irc::string has the same layout as std::string */
+		bytes += MemoryReport::NodeSize(sizeof(dnscache::value_type)) + MemoryReport::StringSize(i->second.data);
+		bytes += i->first.capacity() < sizeof(irc::string) ? 0 : i->first.capacity() + 1;
+	}
+	return this->cache->size();
+}
+
 void DNS::Rehash()
 {
 	if (this->GetFd() > -1)
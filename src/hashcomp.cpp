@@ -25,6 +25,9 @@
 #include "inspircd.h"
 #include "hashcomp.h"
 #include "hash_map.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /******************************************************
  *
@@ -109,6 +112,157 @@ unsigned const char rfc_case_sensitive_map[256] = {
         241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255
 };
 
+/* The rfc1459 and ascii case maps only lower one run of bytes, from 'A' up to ']' or 'Z', by
+ * setting bit 5. Strings folded with either of them can be hashed and compared a word or
+ * an SSE2 vector at a time without looking each byte up. Any other map, such as one loaded
+ * by m_nationalchars, is still looked up a byte at a time. The hash only depends on the
+ * folded bytes, so both ways give the same hash for the same string.
+ */
+namespace
+{
+	/** A byte of ones in every byte of a word */
+	const size_t ONES = ~(size_t)0 / 255;
+
+	/** The top bit of every byte of a word */
+	const size_t HIGHBITS = ONES * 0x80;
+
+	/** An odd multiplier with bits set throughout the word, whatever its size */
+	const size_t MULTIPLIER = (size_t)0x9E3779B9 * (size_t)0x85EBCA6B;
+
+	/** Get the last byte national_case_insensitive_map lowers if it is one of the maps
+	 * which only lower 'A' up to that byte, or 0 if the map has to be looked up
+	 */
+	inline unsigned char FoldLimit()
+	{
+		if (national_case_insensitive_map == rfc_case_insensitive_map)
+			return ']';
+		if (national_case_insensitive_map == ascii_case_insensitive_map)
+			return 'Z';
+		return 0;
+	}
+
+	/** Lower every byte of a word from 'A' to limit, as the case map would */
+	inline size_t FoldWord(size_t word, unsigned char limit)
+	{
+		/* With the top bits cleared, adding to each byte can't carry into the next one */
+		size_t low = word & ~HIGHBITS;
+		size_t atleast = low + ONES * (0x80 - 'A');
+		size_t above = low + ONES * (0x7F - limit);
+		return word | ((atleast & ~above & ~word & HIGHBITS) >> 2);
+	}
+
+	inline size_t LoadWord(const unsigned char* str)
+	{
+		size_t word;
+		memcpy(&word, str, sizeof(word));
+		return word;
+	}
+
+	/** Read a word of bytes through a case map */
+	inline size_t LoadMappedWord(const unsigned char* str, const unsigned char* map)
+	{
+		unsigned char bytes[sizeof(size_t)];
+		for (size_t i = 0; i < sizeof(size_t); i++)
+			bytes[i] = map[str[i]];
+		return LoadWord(bytes);
+	}
+
+	/** Fold the bytes left over after the last whole word into a word, lowering 'A' to limit */
+	inline size_t FoldTail(const unsigned char* str, size_t len, unsigned char limit)
+	{
+		size_t word = 0;
+		for (size_t i = 0; i < len; i++)
+			word = (word << 8) | ((str[i] >= 'A' && str[i] <= limit) ? (str[i] | 0x20) : str[i]);
+		return word;
+	}
+
+	/** Fold the bytes left over after the last whole word into a word through a case map */
+	inline size_t MapTail(const unsigned char* str, size_t len, const unsigned char* map)
+	{
+		size_t word = 0;
+		for (size_t i = 0; i < len; i++)
+			word = (word << 8) | map[str[i]];
+		return word;
+	}
+
+	inline size_t MixWord(size_t hash, size_t word)
+	{
+		hash = (hash ^ word) * MULTIPLIER;
+		return hash ^ (hash >> (sizeof(size_t) * 4));
+	}
+
+#ifdef __SSE2__
+	/** Lower every byte of a vector from 'A' to limit, as the case map would */
+	inline __m128i FoldVector(__m128i bytes, unsigned char limit)
+	{
+		/* Move 'A' down to -128, so that one signed compare finds the bytes in the range */
+		__m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8((char)('A' + 0x80)));
+		__m128i inrange = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(limit - 'A' + 1 - 0x80)));
+		return _mm_or_si128(bytes, _mm_and_si128(inrange, _mm_set1_epi8(0x20)));
+	}
+
+	inline __m128i LoadVector(const unsigned char* str)
+	{
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+	}
+#endif
+
+	/** Hash a string under national_case_insensitive_map */
+	size_t HashFolded(const char* data, size_t len)
+	{
+		const unsigned char* str = reinterpret_cast<const unsigned char*>(data);
+		size_t hash = len;
+		unsigned char limit = FoldLimit();
+
+		if (!limit)
+		{
+			for (; len >= sizeof(size_t); str += sizeof(size_t), len -= sizeof(size_t))
+				hash = MixWord(hash, LoadMappedWord(str, national_case_insensitive_map));
+			return len ? MixWord(hash, MapTail(str, len, national_case_insensitive_map)) : hash;
+		}
+
+#ifdef __SSE2__
+		for (; len >= 16; str += 16, len -= 16)
+		{
+			size_t words[16 / sizeof(size_t)];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(words), FoldVector(LoadVector(str), limit));
+			for (size_t i = 0; i < 16 / sizeof(size_t); i++)
+				hash = MixWord(hash, words[i]);
+		}
+#endif
+		for (; len >= sizeof(size_t); str += sizeof(size_t), len -= sizeof(size_t))
+			hash = MixWord(hash, FoldWord(LoadWord(str), limit));
+		return len ? MixWord(hash, FoldTail(str, len, limit)) : hash;
+	}
+
+	/** Skip the start of two strings which is the same once folded by the current map and
+	 * holds no NUL, a word or vector at a time. Leaves the part that is left to compare.
+	 */
+	void SkipEqualFolded(const unsigned char*& str1, const unsigned char*& str2, size_t& len, unsigned char limit)
+	{
+#ifdef __SSE2__
+		const __m128i zero = _mm_setzero_si128();
+		for (; len >= 16; str1 += 16, str2 += 16, len -= 16)
+		{
+			__m128i first = FoldVector(LoadVector(str1), limit);
+			__m128i second = FoldVector(LoadVector(str2), limit);
+			__m128i stop = _mm_or_si128(_mm_cmpeq_epi8(first, zero), _mm_cmpeq_epi8(second, zero));
+			if (_mm_movemask_epi8(_mm_andnot_si128(stop, _mm_cmpeq_epi8(first, second))) != 0xFFFF)
+				return;
+		}
+#endif
+		for (; len >= sizeof(size_t); str1 += sizeof(size_t), str2 += sizeof(size_t), len -= sizeof(size_t))
+		{
+			size_t first = LoadWord(str1);
+			size_t second = LoadWord(str2);
+			/* Any NUL byte in the first word sets a top bit here; if the words are equal, so is the second */
+			size_t hasnul = (first - ONES) & ~first & HIGHBITS;
+			if (hasnul || FoldWord(first, limit) != FoldWord(second, limit))
+				return;
+		}
+	}
+}
+
 /* convert a string to lowercase. Note following special circumstances
  * taken from RFC 1459. Many "official" server branches still hold to this
  * rule so i will too;
@@ -137,16 +291,7 @@ void nspace::strlower(char *n)
 	#endif
 #endif
 {
-	/* XXX: NO DATA COPIES! :)
-	 * The hash function here is practically
-	 * a copy of the one in STL's hash_fun.h,
-	 * only with *x replaced with national_case_insensitive_map[*x].
-	 * This avoids a copy to use hash<const char*>
-	 */
-	register size_t t = 0;
-	for (std::string::const_iterator x = s.begin(); x != s.end(); ++x) /* ++x not x++, as its faster */
-		t = 5 * t + national_case_insensitive_map[(unsigned char)*x];
-	return t;
+	return HashFolded(s.data(), s.length());
 }
 
 
@@ -156,16 +301,25 @@ void nspace::strlower(char *n)
 	size_t CoreExport irc::hash::operator()(const irc::string &s) const
 #endif
 {
-	register size_t t = 0;
-	for (irc::string::const_iterator x = s.begin(); x != s.end(); ++x) /* ++x not x++, as its faster */
-		t = 5 * t + national_case_insensitive_map[(unsigned char)*x];
-	return t;
+	return HashFolded(s.data(), s.length());
+}
+
+size_t irc::StrHash::operator()(const std::string& s) const
+{
+	return HashFolded(s.data(), s.length());
 }
 
 bool irc::StrHashComp::operator()(const std::string& s1, const std::string& s2) const
 {
 	const unsigned char* n1 = (const unsigned char*)s1.c_str();
 	const unsigned char* n2 = (const unsigned char*)s2.c_str();
+	unsigned char limit = FoldLimit();
+	if (limit)
+	{
+		/* Both strings are NUL terminated, so only the length of the shorter can be read */
+		size_t len = std::min(s1.length(), s2.length());
+		SkipEqualFolded(n1, n2, len, limit);
+	}
 	for (; *n1 && *n2; n1++, n2++)
 		if (national_case_insensitive_map[*n1] != national_case_insensitive_map[*n2])
 			return false;
@@ -200,6 +354,16 @@ bool irc::irc_char_traits::lt(char c1st, char c2nd)
 
 int irc::irc_char_traits::compare(const char* str1, const char* str2, size_t n)
 {
+	unsigned char limit = FoldLimit();
+	if (limit)
+	{
+		const unsigned char* n1 = (const unsigned char*)str1;
+		const unsigned char* n2 = (const unsigned char*)str2;
+		SkipEqualFolded(n1, n2, n, limit);
+		str1 = (const char*)n1;
+		str2 = (const char*)n2;
+	}
+
 	for(unsigned int i = 0; i < n; i++)
 	{
 		if(national_case_insensitive_map[(unsigned char)*str1] > national_case_insensitive_map[(unsigned char)*str2])
@@ -0,0 +1,158 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "histogram.h"
+
+Histogram::Histogram()
+{
+	Reset();
+}
+
+void Histogram::Reset()
+{
+	for (unsigned int i = 0; i < BUCKETS; i++)
+		buckets[i] = 0;
+	count = 0;
+	total = 0;
+	max = 0;
+}
+
+void Histogram::Add(unsigned long usecs)
+{
+	unsigned int bucket = 0;
+	for (unsigned long v = usecs; v && bucket < BUCKETS - 1; v >>= 1)
+		bucket++;
+
+	buckets[bucket]++;
+	count++;
+	total += usecs;
+	if (usecs > max)
+		max = usecs;
+}
+
+void Histogram::Add(const timespec& start, const timespec& end)
+{
+	if (end.tv_sec < start.tv_sec || (end.tv_sec == start.tv_sec && end.tv_nsec < start.tv_nsec))
+		return;
+	Add(Elapsed(start, end));
+}
+
+unsigned long Histogram::Elapsed(const timespec& start, const timespec& end)
+{
+	if (end.tv_sec < start.tv_sec || (end.tv_sec == start.tv_sec && end.tv_nsec < start.tv_nsec))
+		return 0;
+	return (unsigned long)(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+unsigned long Histogram::GetPercentile(unsigned int percent) const
+{
+	if (!count)
+		return 0;
+
+	/* The rank of the duration we want, counting from 1 */
+	unsigned long rank = (unsigned long)((double)count * percent / 100);
+	if (rank < 1)
+		rank = 1;
+
+	unsigned long seen = 0;
+	for (unsigned int i = 0; i < BUCKETS - 1; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return 1UL << i;
+	}
+	return max;
+}
+
+void Histogram::Now(timespec& ts)
+{
+#ifdef HAS_CLOCK_GETTIME
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	ts.tv_sec = tv.tv_sec;
+	ts.tv_nsec = tv.tv_usec * 1000;
+#endif
+}
+
+std::string Histogram::FormatTime(unsigned long usecs)
+{
+	char buf[32];
+	if (usecs < 1000)
+		snprintf(buf, sizeof(buf), "%luus", usecs);
+	else if (usecs < 10000)
+		snprintf(buf, sizeof(buf), "%.1fms", usecs / 1000.0);
+	else if (usecs < 1000000)
+		snprintf(buf, sizeof(buf), "%lums", usecs / 1000);
+	else if (usecs < 10000000)
+		snprintf(buf, sizeof(buf), "%.1fs", usecs / 1000000.0);
+	else
+		snprintf(buf, sizeof(buf), "%lus", usecs / 1000000);
+	return buf;
+}
+
+std::string Histogram::Summary() const
+{
+	std::string ret = "count " + ConvToStr(count);
+	if (!count)
+		return ret;
+
+	ret.append(" mean ").append(FormatTime(GetMean()));
+	ret.append(" max ").append(FormatTime(max));
+	ret.append(" p50 <").append(FormatTime(GetPercentile(50)));
+	ret.append(" p90 <").append(FormatTime(GetPercentile(90)));
+	ret.append(" p99 <").append(FormatTime(GetPercentile(99)));
+	return ret;
+}
+
+std::vector<std::string> Histogram::Buckets(unsigned int perline) const
+{
+	std::vector<std::string> ret;
+	std::string line;
+	unsigned int inline_count = 0;
+
+	for (unsigned int i = 0; i < BUCKETS; i++)
+	{
+		if (!buckets[i])
+			continue;
+
+		if (inline_count == perline)
+		{
+			ret.push_back(line);
+			line.clear();
+			inline_count = 0;
+		}
+
+		if (!line.empty())
+			line.push_back(' ');
+		if (i == BUCKETS - 1)
+			line.append(">=").append(FormatTime(1UL << (i - 1)));
+		else
+			line.append("<").append(FormatTime(1UL << i));
+		line.append(":").append(ConvToStr(buckets[i]));
+		inline_count++;
+	}
+
+	if (!line.empty())
+		ret.push_back(line);
+	return ret;
+}
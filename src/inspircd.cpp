@@ -122,6 +122,8 @@ void InspIRCd::Cleanup()
 	}
 
 	GlobalCulls.Apply();
+	/* Hand the I/O threads the last output and closes of their clients, and stop them */
+	DeleteZero(this->IOThreads);
 	Modules->UnloadAll();
 
 	/* Delete objects dynamically allocated in constructor (destructor would be more appropriate, but we're likely exiting) */
@@ -136,6 +138,7 @@ void InspIRCd::Cleanup()
 	DeleteZero(this->XLines);
 	DeleteZero(this->Parser);
 	DeleteZero(this->stats);
+	DeleteZero(this->Capture);
 	DeleteZero(this->Modules);
 	DeleteZero(this->BanCache);
 	DeleteZero(this->SNO);
@@ -344,6 +347,7 @@ InspIRCd::InspIRCd(int argc, char** argv) :
 	// Initialize so that if we exit before proper initialization they're not deleted
 	this->Logs = 0;
 	this->Threads = 0;
+	this->IOThreads = 0;
 	this->PI = 0;
 	this->Users = 0;
 	this->chanlist = 0;
@@ -352,6 +356,7 @@ InspIRCd::InspIRCd(int argc, char** argv) :
 	this->BanCache = 0;
 	this->Modules = 0;
 	this->stats = 0;
+	this->Capture = 0;
 	this->Timers = 0;
 	this->Parser = 0;
 	this->XLines = 0;
@@ -388,6 +393,7 @@ InspIRCd::InspIRCd(int argc, char** argv) :
 	this->BanCache = new BanCacheManager;
 	this->Modules = new ModuleManager();
 	this->stats = new serverstats();
+	this->Capture = new TrafficCapture;
 	this->Timers = new TimerManager;
 	this->Parser = new CommandParser;
 	this->XLines = new XLineManager;
@@ -715,6 +721,10 @@ InspIRCd::InspIRCd(int argc, char** argv) :
 	}
 #endif
 
+	/* Threads must be started after forking */
+	if (Config->IOThreads)
+		this->IOThreads = new IOThreadPool(Config->IOThreads);
+
 	this->WritePID(Config->PID);
 }
 
@@ -730,6 +740,71 @@ void InspIRCd::UpdateTime()
 #endif
 }
 
+/** Times each phase of a pass through the main loop
+ */
+class LoopTimer
+{
+	/** When the current phase began */
+	timespec mark;
+	/** Time spent in each phase of this pass, in microseconds */
+	unsigned long usecs[LOOP_PHASES];
+	/** When opers were last told about a slow pass */
+	time_t lastnotice;
+
+ public:
+	LoopTimer() : lastnotice(0)
+	{
+	}
+
+	/** Start timing a pass */
+	void Start()
+	{
+		Histogram::Now(mark);
+	}
+
+	/** Time the next phase from a given time rather than from the end of the last one
+	 * @param from When the next phase began
+	 */
+	void Resume(const timespec& from)
+	{
+		mark = from;
+	}
+
+	/** Finish timing a phase; the next one begins now
+	 * @param phase The phase which has finished
+	 */
+	void End(LoopPhase phase)
+	{
+		timespec now;
+		Histogram::Now(now);
+		usecs[phase] = Histogram::Elapsed(mark, now);
+		mark = now;
+	}
+
+	/** Finish timing a pass: count it, and tell opers if it was slow */
+	void Finish()
+	{
+		unsigned long busy = 0;
+		for (int i = 0; i < LOOP_PHASES; i++)
+		{
+			ServerInstance->stats->statsLoopPhase[i].Add(usecs[i]);
+			busy += usecs[i];
+		}
+		ServerInstance->stats->statsLoopBusy.Add(busy);
+
+		int slowloop = ServerInstance->Config->SlowLoop;
+		if (!slowloop || busy < (unsigned long)slowloop * 1000 || lastnotice == ServerInstance->Time())
+			return;
+
+		/* At most one notice a second, so a server which has fallen behind doesn't make things worse */
+		lastnotice = ServerInstance->Time();
+		std::string phases;
+		for (int i = 0; i < LOOP_PHASES; i++)
+			phases.append(" ").append(serverstats::GetLoopPhaseName((LoopPhase)i)).append(" ").append(Histogram::FormatTime(usecs[i]));
+		ServerInstance->SNO->WriteToSnoMask('d', "Main loop pass took %s:%s", Histogram::FormatTime(busy).c_str(), phases.c_str());
+	}
+};
+
 int InspIRCd::Run()
 {
 	/* See if we're supposed to be running the test suite rather than entering the mainloop */
@@ -742,6 +817,7 @@ int InspIRCd::Run()
 
 	UpdateTime();
 	time_t OLDTIME = TIME.tv_sec;
+	LoopTimer looptimer;
 
 	while (true)
 	{
@@ -753,6 +829,8 @@ int InspIRCd::Run()
 		static char window_title[100];
 #endif
 
+		looptimer.Start();
+
 		/* Check if there is a config thread which has finished executing but has not yet been freed */
 		if (this->ConfigThread && this->ConfigThread->IsDone())
 		{
@@ -800,15 +878,20 @@ int InspIRCd::Run()
 				FOREACH_MOD(I_OnGarbageCollect, OnGarbageCollect());
 			}
 
-			Timers->TickTimers(TIME.tv_sec);
-			this->DoBackgroundUserStuff();
-
 			if ((TIME.tv_sec % 5) == 0)
 			{
 				FOREACH_MOD(I_OnBackgroundTimer,OnBackgroundTimer(TIME.tv_sec));
 				SNO->FlushSnotices();
 			}
 		}
+		looptimer.End(LOOP_BACKGROUND);
+
+		/* Timers have millisecond resolution, so they are checked on every
+		 * pass; the socket engine only waits until the next one is due.
+		 */
+		Timers->TickTimers(Time_ts());
+		this->Users->DoReadyChecks();
+		looptimer.End(LOOP_TIMERS);
 
 		/* Call the socket engine to wait on the active
 		 * file descriptors. The socket engine has everything's
@@ -817,12 +900,21 @@ int InspIRCd::Run()
 		 * This will cause any read or write events to be
 		 * dispatched to their handlers.
 		 */
+		if (this->IOThreads)
+			this->IOThreads->Flush();
+		this->Logs->Flush();
 		this->SE->DispatchTrialWrites();
+		looptimer.End(LOOP_FLUSH);
 		this->SE->DispatchEvents();
+		looptimer.Resume(this->SE->WaitEnd);
+		looptimer.End(LOOP_EVENTS);
 
 		/* if any users were quit, take them out */
 		GlobalCulls.Apply();
+		looptimer.End(LOOP_CULLS);
 		AtomicActions.Run();
+		looptimer.End(LOOP_ACTIONS);
+		looptimer.Finish();
 
 		if (this->s_signal)
 		{
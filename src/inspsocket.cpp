@@ -162,12 +162,14 @@ CullResult StreamSocket::cull()
 
 bool StreamSocket::GetNextLine(std::string& line, char delim)
 {
-	std::string::size_type i = recvq.find(delim);
+	std::string::size_type i = recvq.find(delim, recvq_pos);
 	if (i == std::string::npos)
 		return false;
-	line = recvq.substr(0, i);
-	// TODO is this the most efficient way to split?
-	recvq = recvq.substr(i + 1);
+	line.assign(recvq, recvq_pos, i - recvq_pos);
+	// Only move the read cursor here; DoRead() discards the consumed
+	// data once per batch, which avoids copying the rest of the queue
+	// for every line.
+	recvq_pos = i + 1;
 	return true;
 }
 
@@ -187,7 +189,10 @@ void StreamSocket::DoRead()
 			return;
 		}
 		if (rv > 0)
+		{
 			OnDataReady();
+			CompactRecvQ();
+		}
 		if (rv < 0)
 			SetError("Read Error"); // will not overwrite a better error message
 	}
@@ -200,12 +205,14 @@ void StreamSocket::DoRead()
 			ServerInstance->SE->ChangeEventMask(this, FD_WANT_FAST_READ | FD_ADD_TRIAL_READ);
 			recvq.append(ReadBuffer, n);
 			OnDataReady();
+			CompactRecvQ();
 		}
 		else if (n > 0)
 		{
 			ServerInstance->SE->ChangeEventMask(this, FD_WANT_FAST_READ);
 			recvq.append(ReadBuffer, n);
 			OnDataReady();
+			CompactRecvQ();
 		}
 		else if (n == 0)
 		{
@@ -250,7 +257,12 @@ void StreamSocket::DoWrite()
 		{
 			while (error.empty() && !sendq.empty())
 			{
-				if (sendq.size() > 1 && sendq[0].length() < 1024)
+				// The IOHook may modify the string it is handed, while the
+				// buffers in the sendq may be shared with other sockets, so
+				// always give it a private copy.
+				std::string front;
+				size_t items = 1;
+				if (sendq.size() > 1 && sendq[0]->data.length() < 1024)
 				{
 					// Avoid multiple repeated SSL encryption invocations
 					// This adds a single copy of the queue, but avoids
@@ -259,14 +271,15 @@ void StreamSocket::DoWrite()
 					//
 					// The length limit of 1024 is to prevent merging strings
 					// more than once when writes begin to block.
-					std::string tmp;
-					tmp.reserve(sendq_len);
-					for(unsigned int i=0; i < sendq.size(); i++)
-						tmp.append(sendq[i]);
-					sendq.clear();
-					sendq.push_back(tmp);
+					items = sendq.size();
+					front.reserve(sendq_len);
+					for(unsigned int i=0; i < items; i++)
+						front.append(sendq[i]->data);
+				}
+				else
+				{
+					front = sendq.front()->data;
 				}
-				std::string& front = sendq.front();
 				int itemlen = front.length();
 				if (IOHook)
 				{
@@ -275,7 +288,7 @@ void StreamSocket::DoWrite()
 					{
 						// consumed the entire string, and is ready for more
 						sendq_len -= itemlen;
-						sendq.pop_front();
+						sendq.erase(sendq.begin(), sendq.begin() + items);
 					}
 					else if (rv == 0)
 					{
@@ -283,7 +296,11 @@ void StreamSocket::DoWrite()
 						// IOHook has requested unblock notification from the socketengine
 
 						// Since it is possible that a partial write took place, adjust sendq_len
+						// and keep whatever is left of the string at the head of the queue
 						sendq_len = sendq_len - itemlen + front.length();
+						sendq.erase(sendq.begin(), sendq.begin() + items);
+						if (!front.empty())
+							sendq.push_front(new SharedBuffer(front));
 						return;
 					}
 					else
@@ -312,14 +329,15 @@ void StreamSocket::DoWrite()
 					else if (rv < itemlen)
 					{
 						ServerInstance->SE->ChangeEventMask(this, FD_WANT_FAST_WRITE | FD_WRITE_WILL_BLOCK);
-						front = front.substr(itemlen - rv);
+						sendq.erase(sendq.begin(), sendq.begin() + items);
+						sendq.push_front(new SharedBuffer(front.substr(rv)));
 						sendq_len -= rv;
 						return;
 					}
 					else
 					{
 						sendq_len -= itemlen;
-						sendq.pop_front();
+						sendq.erase(sendq.begin(), sendq.begin() + items);
 						if (sendq.empty())
 							ServerInstance->SE->ChangeEventMask(this, FD_WANT_EDGE_WRITE);
 					}
@@ -356,9 +374,10 @@ void StreamSocket::DoWrite()
 			iovec* iovecs = new iovec[bufcount];
 			for(int i=0; i < bufcount; i++)
 			{
-				iovecs[i].iov_base = const_cast<char*>(sendq[i].data());
-				iovecs[i].iov_len = sendq[i].length();
-				rv_max += sendq[i].length();
+				const std::string& data = sendq[i]->data;
+				iovecs[i].iov_base = const_cast<char*>(data.data());
+				iovecs[i].iov_len = data.length();
+				rv_max += data.length();
 			}
 			int rv = writev(fd, iovecs, bufcount);
 			delete[] iovecs;
@@ -381,7 +400,7 @@ void StreamSocket::DoWrite()
 				sendq_len -= rv;
 				while (rv > 0 && !sendq.empty())
 				{
-					std::string& front = sendq.front();
+					const std::string& front = sendq.front()->data;
 					if (front.length() <= (size_t)rv)
 					{
 						// this string got fully written out
@@ -390,8 +409,9 @@ void StreamSocket::DoWrite()
 					}
 					else
 					{
-						// stopped in the middle of this string
-						front = front.substr(rv);
+						// stopped in the middle of this string. The buffer may be
+						// shared, so replace our reference with the unwritten tail.
+						sendq.front() = new SharedBuffer(front.substr(rv));
 						rv = 0;
 					}
 				}
@@ -437,12 +457,43 @@ void StreamSocket::WriteData(const std::string &data)
 	}
 
 	/* Append the data to the back of the queue ready for writing */
-	sendq.push_back(data);
+	sendq.push_back(new SharedBuffer(data));
 	sendq_len += data.length();
 
 	ServerInstance->SE->ChangeEventMask(this, FD_ADD_TRIAL_WRITE);
 }
 
+void StreamSocket::TakeSendQ(std::string& out)
+{
+	for (std::deque<reference<SharedBuffer> >::iterator i = sendq.begin(); i != sendq.end(); ++i)
+		out.append((*i)->data);
+	sendq.clear();
+	sendq_len = 0;
+}
+
+size_t StreamSocket::GetQueueMemory() const
+{
+	size_t bytes = MemoryReport::StringSize(recvq) + sendq.size() * sizeof(reference<SharedBuffer>);
+	for (std::deque<reference<SharedBuffer> >::const_iterator i = sendq.begin(); i != sendq.end(); ++i)
+		bytes += sizeof(SharedBuffer) + MemoryReport::StringSize((*i)->data);
+	return bytes;
+}
+
+void StreamSocket::WriteData(SharedBuffer* data)
+{
+	if (fd < 0)
+	{
+		ServerInstance->Logs->Log("SOCKET", DEBUG, "Attempt to write data to dead socket: %s",
+			data->data.c_str());
+		return;
+	}
+
+	sendq.push_back(data);
+	sendq_len += data->data.length();
+
+	ServerInstance->SE->ChangeEventMask(this, FD_ADD_TRIAL_WRITE);
+}
+
 void SocketTimeout::Tick(time_t)
 {
 	ServerInstance->Logs->Log("SOCKET", DEBUG,"SocketTimeout::Tick");
@@ -0,0 +1,567 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "iothreads.h"
+
+#ifndef WINDOWS
+#include <poll.h>
+#include <fcntl.h>
+#endif
+
+static inline void AtomicAdd(volatile long& value, long delta)
+{
+#ifdef WINDOWS
+	InterlockedExchangeAdd(&value, delta);
+#else
+	__sync_fetch_and_add(&value, delta);
+#endif
+}
+
+/** Work handed from the main thread to an I/O thread */
+struct IOOp
+{
+	enum Type { ADD = 1, CLOSE = 2 };
+	IOConnection* conn;
+	/** Combination of Type flags */
+	int flags;
+	/** Output to send */
+	std::string data;
+};
+
+/** Something which happened on an I/O thread, to be handled on the main thread */
+struct IOEvent
+{
+	enum Type { READ, FAIL, CLOSED };
+	IOConnection* conn;
+	Type type;
+	/** Received lines for READ, the error message for FAIL */
+	std::string data;
+};
+
+/** A thread which reads from and writes to a share of the client sockets.
+ * It waits for its sockets and for a wakeup pipe with poll(); it never
+ * calls into the rest of the ircd.
+ */
+class IOThread : public SocketThread
+{
+	/** Main thread to I/O thread: queued work, protected by the queue lock */
+	std::vector<IOOp> inbox;
+	/** I/O thread to main thread: queued events, protected by the queue lock */
+	std::vector<IOEvent> outbox;
+	/** True if the wakeup pipe has been written to since the thread last looked at the inbox */
+	bool woken;
+	/** Wakeup pipe, read by the I/O thread */
+	int wakefd[2];
+	/** Size of the buffer used for each recv() */
+	const size_t bufsize;
+
+#ifndef WINDOWS
+	/** I/O thread: the sockets, after the wakeup pipe at index 0 */
+	std::vector<pollfd> pfds;
+#endif
+	/** I/O thread: connections, in the same order as pfds (offset by one) */
+	std::vector<IOConnection*> conns;
+
+	void Add(IOConnection* conn);
+	void Remove(IOConnection* conn);
+	void Fail(IOConnection* conn, const std::string& reason, std::vector<IOEvent>& events);
+	void DoRead(IOConnection* conn, char* buffer, std::vector<IOEvent>& events);
+	void DoWrite(IOConnection* conn, std::vector<IOEvent>& events);
+	void RunOps(std::vector<IOOp>& ops, std::vector<IOEvent>& events);
+	void Wake();
+
+ public:
+	/** Main thread: work staged by IOThreadPool::Flush() */
+	std::vector<IOOp> staged;
+
+	IOThread(size_t readsize);
+	~IOThread();
+
+	/** Hand the staged work to the thread and wake it up */
+	void Post();
+
+	/** Delete the connections still owned by the thread. Only call this once the thread has exited. */
+	void DeleteConnections();
+
+	void Run();
+	void OnNotify();
+	void SetExitFlag();
+};
+
+IOThread::IOThread(size_t readsize) : woken(false), bufsize(readsize)
+{
+#ifndef WINDOWS
+	if (pipe(wakefd))
+		throw CoreException("Could not create pipe " + std::string(strerror(errno)));
+	fcntl(wakefd[0], F_SETFL, O_NONBLOCK);
+	fcntl(wakefd[1], F_SETFL, O_NONBLOCK);
+
+	pollfd wake;
+	wake.fd = wakefd[0];
+	wake.events = POLLIN;
+	wake.revents = 0;
+	pfds.push_back(wake);
+#else
+	throw CoreException("I/O threads are not supported on Windows");
+#endif
+}
+
+IOThread::~IOThread()
+{
+	close(wakefd[0]);
+	close(wakefd[1]);
+}
+
+void IOThread::Wake()
+{
+	static const char dummy = '*';
+	if (write(wakefd[1], &dummy, 1) < 0)
+	{
+		// the pipe is full, so the thread will wake up anyway
+	}
+}
+
+void IOThread::SetExitFlag()
+{
+	SocketThread::SetExitFlag();
+	Wake();
+}
+
+void IOThread::Post()
+{
+	LockQueue();
+	if (inbox.empty())
+	{
+		inbox.swap(staged);
+	}
+	else
+	{
+		for (std::vector<IOOp>::iterator i = staged.begin(); i != staged.end(); ++i)
+		{
+			inbox.push_back(IOOp());
+			inbox.back().conn = i->conn;
+			inbox.back().flags = i->flags;
+			inbox.back().data.swap(i->data);
+		}
+		staged.clear();
+	}
+	bool wake = !woken;
+	woken = true;
+	UnlockQueue();
+
+	if (wake)
+		Wake();
+}
+
+void IOThread::OnNotify()
+{
+	std::vector<IOEvent> events;
+	LockQueue();
+	events.swap(outbox);
+	UnlockQueue();
+
+	for (std::vector<IOEvent>::iterator i = events.begin(); i != events.end(); ++i)
+	{
+		IOConnection* conn = i->conn;
+		if (i->type == IOEvent::CLOSED)
+		{
+			// nothing refers to it any more
+			delete conn;
+			continue;
+		}
+
+		UserIOHandler* eh = conn->owner;
+		if (!eh)
+			continue;
+
+		if (i->type == IOEvent::FAIL)
+		{
+			eh->SetError(i->data);
+			eh->OnError(I_ERR_OTHER);
+		}
+		else
+		{
+			eh->OnThreadData(i->data);
+		}
+	}
+}
+
+#ifndef WINDOWS
+
+void IOThread::Add(IOConnection* conn)
+{
+	conn->index = conns.size();
+	conns.push_back(conn);
+
+	pollfd p;
+	p.fd = conn->fd;
+	p.events = POLLIN;
+	p.revents = 0;
+	pfds.push_back(p);
+}
+
+void IOThread::Remove(IOConnection* conn)
+{
+	// move the last connection into the hole
+	size_t index = conn->index;
+	IOConnection* last = conns.back();
+	conns[index] = last;
+	pfds[index + 1] = pfds.back();
+	last->index = index;
+	conns.pop_back();
+	pfds.pop_back();
+}
+
+void IOThread::Fail(IOConnection* conn, const std::string& reason, std::vector<IOEvent>& events)
+{
+	// stop polling it; the main thread will close it. Output which
+	// was waiting can never be sent now, so it no longer counts.
+	pfds[conn->index + 1].fd = -1;
+	AtomicAdd(conn->sendq_len, -(long)(conn->outbuf.length() - conn->outpos));
+	conn->outbuf.clear();
+	conn->outpos = 0;
+
+	events.push_back(IOEvent());
+	events.back().conn = conn;
+	events.back().type = IOEvent::FAIL;
+	events.back().data = reason;
+}
+
+void IOThread::DoRead(IOConnection* conn, char* buffer, std::vector<IOEvent>& events)
+{
+	int n = recv(conn->fd, buffer, bufsize, 0);
+	if (n > 0)
+	{
+		std::string& partial = conn->partial;
+		partial.append(buffer, n);
+
+		// Hand over everything up to the last complete line. A client which
+		// sends a lot without a newline is handed over anyway, so that the
+		// main thread's recvq limits still apply to it.
+		std::string::size_type eol = partial.rfind('\n');
+		std::string::size_type len = (eol == std::string::npos ? 0 : eol + 1);
+		if (len == 0 && partial.length() >= MAXBUF)
+			len = partial.length();
+		if (len == 0)
+			return;
+
+		events.push_back(IOEvent());
+		IOEvent& ev = events.back();
+		ev.conn = conn;
+		ev.type = IOEvent::READ;
+		if (len == partial.length())
+		{
+			ev.data.swap(partial);
+		}
+		else
+		{
+			ev.data.assign(partial, 0, len);
+			partial.erase(0, len);
+		}
+	}
+	else if (n == 0)
+	{
+		Fail(conn, "Connection closed", events);
+	}
+	else if (errno != EAGAIN && errno != EINTR)
+	{
+		Fail(conn, strerror(errno), events);
+	}
+}
+
+void IOThread::DoWrite(IOConnection* conn, std::vector<IOEvent>& events)
+{
+	pollfd& p = pfds[conn->index + 1];
+	if (p.fd < 0)
+		return;
+
+	while (conn->outpos < conn->outbuf.length())
+	{
+		int n = send(conn->fd, conn->outbuf.data() + conn->outpos, conn->outbuf.length() - conn->outpos, 0);
+		if (n > 0)
+		{
+			conn->outpos += n;
+			AtomicAdd(conn->sendq_len, -n);
+		}
+		else if (n == 0 || errno == EAGAIN)
+		{
+			break;
+		}
+		else if (errno != EINTR)
+		{
+			Fail(conn, strerror(errno), events);
+			return;
+		}
+	}
+
+	if (conn->outpos == conn->outbuf.length())
+	{
+		conn->outbuf.clear();
+		conn->outpos = 0;
+		p.events = POLLIN;
+	}
+	else
+	{
+		p.events = POLLIN | POLLOUT;
+	}
+}
+
+void IOThread::RunOps(std::vector<IOOp>& ops, std::vector<IOEvent>& events)
+{
+	for (std::vector<IOOp>::iterator i = ops.begin(); i != ops.end(); ++i)
+	{
+		IOConnection* conn = i->conn;
+		if (i->flags & IOOp::ADD)
+			Add(conn);
+
+		if (!i->data.empty() && pfds[conn->index + 1].fd < 0)
+		{
+			// written before the main thread saw the failure; drop it as Fail() did the rest
+			AtomicAdd(conn->sendq_len, -(long)i->data.length());
+		}
+		else if (!i->data.empty())
+		{
+			if (conn->outbuf.empty())
+				conn->outbuf.swap(i->data);
+			else
+				conn->outbuf.append(i->data);
+			DoWrite(conn, events);
+		}
+
+		if (i->flags & IOOp::CLOSE)
+		{
+			// Whatever could not be sent by now is lost, as with StreamSocket::Close()
+			shutdown(conn->fd, 2);
+			close(conn->fd);
+			Remove(conn);
+
+			events.push_back(IOEvent());
+			events.back().conn = conn;
+			events.back().type = IOEvent::CLOSED;
+		}
+	}
+	ops.clear();
+}
+
+void IOThread::Run()
+{
+	std::vector<char> buffer(bufsize);
+	std::vector<IOOp> ops;
+	std::vector<IOEvent> events;
+
+	while (true)
+	{
+		if (poll(&pfds[0], pfds.size(), -1) < 0 && errno != EINTR)
+			break;
+
+		if (pfds[0].revents)
+		{
+			char dummy[128];
+			while (read(wakefd[0], dummy, sizeof(dummy)) > 0)
+				;
+		}
+
+		// Walk backwards, so that closing a socket does not skip one
+		for (size_t i = pfds.size() - 1; i > 0; i--)
+		{
+			short revents = pfds[i].revents;
+			if (!revents || pfds[i].fd < 0)
+				continue;
+			IOConnection* conn = conns[i - 1];
+			if (revents & POLLOUT)
+				DoWrite(conn, events);
+			if ((revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) && pfds[i].fd >= 0)
+				DoRead(conn, &buffer[0], events);
+		}
+
+		LockQueue();
+		ops.swap(inbox);
+		woken = false;
+		bool exiting = GetExitFlag();
+		UnlockQueue();
+
+		RunOps(ops, events);
+
+		if (!events.empty())
+		{
+			LockQueue();
+			bool notify = outbox.empty();
+			if (notify)
+			{
+				outbox.swap(events);
+			}
+			else
+			{
+				for (std::vector<IOEvent>::iterator i = events.begin(); i != events.end(); ++i)
+				{
+					outbox.push_back(IOEvent());
+					outbox.back().conn = i->conn;
+					outbox.back().type = i->type;
+					outbox.back().data.swap(i->data);
+				}
+			}
+			UnlockQueue();
+			events.clear();
+			if (notify)
+				NotifyParent();
+		}
+
+		if (exiting)
+			break;
+	}
+
+	// The ircd is shutting down; give every client one last chance to get its output
+	for (std::vector<IOConnection*>::iterator i = conns.begin(); i != conns.end(); ++i)
+	{
+		DoWrite(*i, events);
+		shutdown((*i)->fd, 2);
+		close((*i)->fd);
+	}
+}
+
+#else
+
+void IOThread::Run()
+{
+}
+
+#endif
+
+void IOThread::DeleteConnections()
+{
+	for (std::vector<IOConnection*>::iterator i = conns.begin(); i != conns.end(); ++i)
+		delete *i;
+	conns.clear();
+
+	// closed connections the main thread never got to hear about
+	for (std::vector<IOEvent>::iterator i = outbox.begin(); i != outbox.end(); ++i)
+		if (i->type == IOEvent::CLOSED)
+			delete i->conn;
+	outbox.clear();
+}
+
+IOThreadPool::IOThreadPool(unsigned int count) : next(0)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		IOThread* thread = new IOThread(ServerInstance->Config->NetBufferSize);
+		threads.push_back(thread);
+		ServerInstance->Threads->Start(thread);
+	}
+}
+
+IOThreadPool::~IOThreadPool()
+{
+	Flush();
+	for (std::vector<IOThread*>::iterator i = threads.begin(); i != threads.end(); ++i)
+	{
+		IOThread* thread = *i;
+		thread->join();
+		thread->DeleteConnections();
+		delete thread;
+	}
+}
+
+void IOThreadPool::Attach(UserIOHandler* eh)
+{
+	attaching.push_back(eh);
+}
+
+void IOThreadPool::DoAttach(UserIOHandler* eh)
+{
+	IOThread* thread = threads[next++ % threads.size()];
+	ServerInstance->SE->DelFd(eh);
+
+	IOConnection* conn = new IOConnection(thread, eh->GetFd(), eh);
+	eh->TakeSendQ(conn->pending);
+	AtomicAdd(conn->sendq_len, conn->pending.length());
+	eh->conn = conn;
+
+	// The ADD is sent along with the first flush, even if there is no output
+	thread->staged.push_back(IOOp());
+	thread->staged.back().conn = conn;
+	thread->staged.back().flags = IOOp::ADD;
+	thread->staged.back().data.swap(conn->pending);
+}
+
+void IOThreadPool::MarkDirty(IOConnection* conn)
+{
+	if (!conn->dirty)
+	{
+		conn->dirty = true;
+		dirty.push_back(conn);
+	}
+}
+
+void IOThreadPool::Write(IOConnection* conn, const std::string& data)
+{
+	conn->pending.append(data);
+	AtomicAdd(conn->sendq_len, data.length());
+	MarkDirty(conn);
+}
+
+bool IOThreadPool::Close(UserIOHandler* eh)
+{
+	IOConnection* conn = eh->conn;
+	if (!conn)
+	{
+		// it may still be waiting to be attached
+		std::vector<UserIOHandler*>::iterator i = std::find(attaching.begin(), attaching.end(), eh);
+		if (i != attaching.end())
+			attaching.erase(i);
+		return false;
+	}
+
+	conn->owner = NULL;
+	conn->closing = true;
+	MarkDirty(conn);
+	eh->conn = NULL;
+	eh->SetFd(-1);
+	return true;
+}
+
+void IOThreadPool::Flush()
+{
+	for (std::vector<UserIOHandler*>::iterator i = attaching.begin(); i != attaching.end(); ++i)
+	{
+		if (!(*i)->user->quitting)
+			DoAttach(*i);
+	}
+	attaching.clear();
+
+	for (std::vector<IOConnection*>::iterator i = dirty.begin(); i != dirty.end(); ++i)
+	{
+		IOConnection* conn = *i;
+		std::vector<IOOp>& staged = conn->thread->staged;
+		staged.push_back(IOOp());
+		staged.back().conn = conn;
+		staged.back().flags = conn->closing ? IOOp::CLOSE : 0;
+		staged.back().data.swap(conn->pending);
+		conn->dirty = false;
+	}
+	dirty.clear();
+
+	for (std::vector<IOThread*>::iterator i = threads.begin(); i != threads.end(); ++i)
+	{
+		if (!(*i)->staged.empty())
+			(*i)->Post();
+	}
+}
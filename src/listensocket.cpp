@@ -21,10 +21,17 @@
 #include "inspircd.h"
 #include "socket.h"
 #include "socketengine.h"
+#ifndef WINDOWS
+#include <netinet/tcp.h>
+#endif
 
 ListenSocket::ListenSocket(ConfigTag* tag, const irc::sockets::sockaddrs& bind_to)
 	: bind_tag(tag)
 {
+	accept_batch = tag->getInt("acceptbatch", 16);
+	if (accept_batch < 1)
+		accept_batch = 1;
+
 	irc::sockets::satoap(bind_to, bind_addr, bind_port);
 	bind_desc = irc::sockets::satouser(bind_to);
 
@@ -34,10 +41,27 @@ ListenSocket::ListenSocket(ConfigTag* tag, const irc::sockets::sockaddrs& bind_t
 		return;
 
 	ServerInstance->SE->SetReuse(fd);
+#ifdef SO_REUSEPORT
+	if (tag->getInt("listeners", 1) > 1)
+	{
+		/* Several sockets are bound to this address, and the kernel
+		 * spreads incoming connections between their accept queues.
+		 */
+		int enable = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const char*)&enable, sizeof(enable));
+	}
+#endif
 	int rv = ServerInstance->SE->Bind(this->fd, bind_to);
 	if (rv >= 0)
 		rv = ServerInstance->SE->Listen(this->fd, ServerInstance->Config->MaxConn);
 
+#ifdef TCP_DEFER_ACCEPT
+	/* Don't wake us up for a connection until the client has sent something */
+	int defer = tag->getInt("deferaccept");
+	if (defer > 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, (const char*)&defer, sizeof(defer));
+#endif
+
 #ifdef IPV6_V6ONLY
 	/* This OS supports IPv6 sockets that can also listen for IPv4
 	 * connections. If our address is "*" or empty, enable both v4 and v6 to
@@ -82,7 +106,7 @@ ListenSocket::~ListenSocket()
 }
 
 /* Just seperated into another func for tidiness really.. */
-void ListenSocket::AcceptInternal()
+bool ListenSocket::AcceptInternal()
 {
 	irc::sockets::sockaddrs client;
 	irc::sockets::sockaddrs server;
@@ -93,8 +117,10 @@ void ListenSocket::AcceptInternal()
 	ServerInstance->Logs->Log("SOCKET",DEBUG,"HandleEvent for Listensocket %s nfd=%d", bind_desc.c_str(), incomingSockfd);
 	if (incomingSockfd < 0)
 	{
-		ServerInstance->stats->statsRefused++;
-		return;
+		/* An empty accept queue is not a refused connection */
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			ServerInstance->stats->statsRefused++;
+		return false;
 	}
 
 	socklen_t sz = sizeof(server);
@@ -120,7 +146,7 @@ void ListenSocket::AcceptInternal()
 		ServerInstance->SE->Shutdown(incomingSockfd, 2);
 		ServerInstance->SE->Close(incomingSockfd);
 		ServerInstance->stats->statsRefused++;
-		return;
+		return true;
 	}
 
 	if (client.sa.sa_family == AF_INET6)
@@ -155,7 +181,9 @@ void ListenSocket::AcceptInternal()
 		}
 	}
 
+#ifndef HAS_ACCEPT4
 	ServerInstance->SE->NonBlocking(incomingSockfd);
+#endif
 
 	ModResult res;
 	FIRST_MOD_RESULT(OnAcceptConnection, res, (incomingSockfd, this, &client, &server));
@@ -179,6 +207,7 @@ void ListenSocket::AcceptInternal()
 			bind_desc.c_str(), res == MOD_RES_DENY ? "Connection refused by module" : "Module for this port not found");
 		ServerInstance->SE->Close(incomingSockfd);
 	}
+	return true;
 }
 
 void ListenSocket::HandleEvent(EventType e, int err)
@@ -192,7 +221,14 @@ void ListenSocket::HandleEvent(EventType e, int err)
 			ServerInstance->Logs->Log("SOCKET",DEBUG,"*** BUG *** ListenSocket::HandleEvent() got a WRITE event!!!");
 			break;
 		case EVENT_READ:
-			this->AcceptInternal();
+			/* Drain the accept queue, so a flood of connections doesn't
+			 * overflow it while we wait for the next event
+			 */
+			for (int i = 0; i < accept_batch; i++)
+			{
+				if (!this->AcceptInternal())
+					break;
+			}
 			break;
 	}
 }
@@ -51,13 +51,227 @@
  *
  */
 
+static inline void AtomicAdd(volatile long& value, long delta)
+{
+#ifdef WINDOWS
+	InterlockedExchangeAdd(&value, delta);
+#else
+	__sync_fetch_and_add(&value, delta);
+#endif
+}
+
+/** Lines for one log file, or a request to close it */
+struct LogChunk
+{
+	FILE* file;
+	std::string data;
+	bool close;
+	LogChunk(FILE* f, bool c) : file(f), close(c) { }
+};
+
+/** Writes log files on behalf of the main thread. The main thread gathers
+ * lines into chunks, one per run of lines for the same file, and hands them
+ * over in batches; the thread writes each batch and flushes each file once.
+ */
+class LogWriterThread : public QueuedThread
+{
+	/** Main thread: chunks not yet handed to the thread */
+	std::vector<LogChunk> pending;
+	/** Main thread: bytes in pending */
+	unsigned long pendingbytes;
+	/** Main thread to writer thread: chunks to write, protected by the queue lock */
+	std::vector<LogChunk> inbox;
+	/** Both threads: bytes handed to the thread and not yet written */
+	volatile long queued;
+	/** Signalled by the writer thread whenever it has written a batch */
+	ThreadQueueData space;
+
+	void Add(FILE* file, const std::string& data, bool close);
+
+ public:
+	/** Most bytes which may be queued */
+	const unsigned long queuesize;
+	/** True to wait when the queue is full, false to drop lines */
+	const bool block;
+
+	LogWriterThread(unsigned long size, bool blocking)
+		: pendingbytes(0), queued(0), queuesize(size), block(blocking)
+	{
+	}
+
+	/** Queue a line to be written, or drop it if the queue is full and
+	 * the thread is not set to block
+	 * @param file The file to write to
+	 * @param line The line to write
+	 * @param dropped Count of lines dropped for this file; when a line is
+	 * next written, a note of how many were dropped goes before it
+	 */
+	void Write(FILE* file, const std::string& line, unsigned long& dropped);
+
+	/** Close a file once everything queued for it has been written */
+	void Close(FILE* file);
+
+	/** Hand the pending chunks to the thread */
+	void Flush();
+
+	void Run();
+};
+
+void LogWriterThread::Add(FILE* file, const std::string& data, bool close)
+{
+	if (pending.empty() || pending.back().file != file || pending.back().close)
+		pending.push_back(LogChunk(file, close));
+	pending.back().data.append(data);
+	pendingbytes += data.length();
+
+	/* Don't let a busy main loop pass build up too much before the thread sees any of it */
+	if (pendingbytes >= 65536)
+		Flush();
+}
+
+void LogWriterThread::Write(FILE* file, const std::string& line, unsigned long& dropped)
+{
+	/* Leave room for the note too */
+	unsigned long length = line.length() + (dropped ? 100 : 0);
+	if (queued + pendingbytes + length > queuesize)
+	{
+		if (!block)
+		{
+			dropped++;
+			return;
+		}
+
+		Flush();
+		space.Lock();
+		/* A line longer than the whole queue is let through once the queue is empty */
+		while (queued > 0 && queued + line.length() > queuesize)
+			space.Wait();
+		space.Unlock();
+	}
+
+	if (dropped)
+	{
+		Add(file, "*** " + ConvToStr(dropped) + " log lines were dropped because the log file could not be written fast enough\n", false);
+		dropped = 0;
+	}
+	Add(file, line, false);
+}
+
+void LogWriterThread::Close(FILE* file)
+{
+	Add(file, "", true);
+}
+
+void LogWriterThread::Flush()
+{
+	if (pending.empty())
+		return;
+
+	AtomicAdd(queued, pendingbytes);
+	pendingbytes = 0;
+
+	LockQueue();
+	if (inbox.empty())
+	{
+		inbox.swap(pending);
+	}
+	else
+	{
+		inbox.insert(inbox.end(), pending.begin(), pending.end());
+		pending.clear();
+	}
+	UnlockQueueWakeup();
+}
+
+void LogWriterThread::Run()
+{
+	std::vector<LogChunk> work;
+	std::vector<FILE*> written;
+
+	LockQueue();
+	/* Everything queued is written before the thread exits */
+	while (!inbox.empty() || !GetExitFlag())
+	{
+		if (inbox.empty())
+		{
+			WaitForQueue();
+			continue;
+		}
+		work.swap(inbox);
+		UnlockQueue();
+
+		long bytes = 0;
+		for (std::vector<LogChunk>::iterator i = work.begin(); i != work.end(); ++i)
+		{
+			std::vector<FILE*>::iterator w = std::find(written.begin(), written.end(), i->file);
+			if (i->close)
+			{
+				if (w != written.end())
+					written.erase(w);
+				fflush(i->file);
+				fclose(i->file);
+				continue;
+			}
+
+			if (fwrite(i->data.data(), 1, i->data.length(), i->file) < i->data.length())
+			{
+				// Nowhere to report this; the main thread would not have noticed either
+			}
+			bytes += i->data.length();
+			if (w == written.end())
+				written.push_back(i->file);
+		}
+
+		for (std::vector<FILE*>::iterator w = written.begin(); w != written.end(); ++w)
+			fflush(*w);
+		written.clear();
+		work.clear();
+
+		AtomicAdd(queued, -bytes);
+		space.Lock();
+		space.Wakeup();
+		space.Unlock();
+
+		LockQueue();
+	}
+	UnlockQueue();
+}
+
 LogManager::LogManager()
 {
 	Logging = false;
+	Writer = NULL;
+	MinLevel = OtherLevel = INT_MAX;
 }
 
 LogManager::~LogManager()
 {
+	StopWriter();
+}
+
+void LogManager::StartWriter(unsigned long queuesize, bool block)
+{
+	StopWriter();
+	Writer = new LogWriterThread(queuesize, block);
+	ServerInstance->Threads->Start(Writer);
+}
+
+void LogManager::StopWriter()
+{
+	if (!Writer)
+		return;
+
+	LogWriterThread* writer = Writer;
+	Writer = NULL;
+	writer->Flush();
+	writer->join();
+	delete writer;
+}
+
+void LogManager::Flush()
+{
+	if (Writer)
+		Writer->Flush();
 }
 
 void LogManager::OpenFileLogs()
@@ -70,6 +284,18 @@ void LogManager::OpenFileLogs()
 	/* Skip rest of logfile opening if we are running -nolog. */
 	if (!ServerInstance->Config->cmdline.writelog)
 		return;
+
+	ServerConfig* conf = ServerInstance->Config;
+	if (conf->LogThread)
+	{
+		if (!Writer || Writer->queuesize != conf->LogQueue || Writer->block != conf->LogQueueBlock)
+			StartWriter(conf->LogQueue, conf->LogQueueBlock);
+	}
+	else
+	{
+		StopWriter();
+	}
+
 	std::map<std::string, FileWriter*> logmap;
 	ConfigTagList tags = ServerInstance->Config->ConfTags("log");
 	for(ConfigIter i = tags.first; i != tags.second; ++i)
@@ -142,6 +368,7 @@ void LogManager::CloseLogs()
 		delete i->first;
 	}
 	std::map<LogStream*, int>().swap(AllLogStreams); /* And clear it */
+	UpdateLevels();
 }
 
 void LogManager::AddLogTypes(const std::string &types, LogStream* l, bool autoclose)
@@ -183,6 +410,7 @@ void LogManager::AddLogTypes(const std::string &types, LogStream* l, bool autocl
 	{
 		gi->second.swap(excludes); // Swap with the vector in the hash.
 	}
+	UpdateLevels();
 }
 
 bool LogManager::AddLogType(const std::string &type, LogStream *l, bool autoclose)
@@ -218,6 +446,7 @@ bool LogManager::AddLogType(const std::string &type, LogStream *l, bool autoclos
 		}
 	}
 
+	UpdateLevels();
 	return true;
 }
 
@@ -238,6 +467,7 @@ void LogManager::DelLogStream(LogStream* l)
 	{
 		GlobalLogStreams.erase(gi);
 	}
+	UpdateLevels();
 	std::map<LogStream*, int>::iterator ai = AllLogStreams.begin();
 	if (ai == AllLogStreams.end())
 	{
@@ -278,6 +508,7 @@ bool LogManager::DelLogType(const std::string &type, LogStream *l)
 		return false;
 	}
 
+	UpdateLevels();
 	std::map<LogStream*, int>::iterator ai = AllLogStreams.find(l);
 	if (ai == AllLogStreams.end())
 	{
@@ -293,9 +524,46 @@ bool LogManager::DelLogType(const std::string &type, LogStream *l)
 	return true;
 }
 
+void LogManager::UpdateLevels()
+{
+	/* Every type goes to the streams for *, except the types they exclude */
+	OtherLevel = INT_MAX;
+	std::set<std::string> types;
+	for (std::map<LogStream *, std::vector<std::string> >::iterator gi = GlobalLogStreams.begin(); gi != GlobalLogStreams.end(); ++gi)
+	{
+		OtherLevel = std::min(OtherLevel, gi->first->GetLevel());
+		types.insert(gi->second.begin(), gi->second.end());
+	}
+	for (std::map<std::string, std::vector<LogStream *> >::iterator i = LogStreams.begin(); i != LogStreams.end(); ++i)
+		types.insert(i->first);
+
+	TypeLevels.clear();
+	MinLevel = OtherLevel;
+	for (std::set<std::string>::iterator t = types.begin(); t != types.end(); ++t)
+	{
+		int level = INT_MAX;
+		for (std::map<LogStream *, std::vector<std::string> >::iterator gi = GlobalLogStreams.begin(); gi != GlobalLogStreams.end(); ++gi)
+		{
+			if (std::find(gi->second.begin(), gi->second.end(), *t) == gi->second.end())
+				level = std::min(level, gi->first->GetLevel());
+		}
+
+		std::map<std::string, std::vector<LogStream *> >::iterator i = LogStreams.find(*t);
+		if (i != LogStreams.end())
+		{
+			for (std::vector<LogStream *>::iterator it = i->second.begin(); it != i->second.end(); ++it)
+				level = std::min(level, (*it)->GetLevel());
+		}
+
+		TypeLevels[*t] = level;
+		MinLevel = std::min(MinLevel, level);
+	}
+}
+
 void LogManager::Log(const std::string &type, int loglevel, const char *fmt, ...)
 {
-	if (Logging)
+	/* Nothing is formatted unless a LogStream wants it */
+	if (!IsLogged(type, loglevel))
 	{
 		return;
 	}
@@ -312,7 +580,7 @@ void LogManager::Log(const std::string &type, int loglevel, const char *fmt, ...
 
 void LogManager::Log(const std::string &type, int loglevel, const std::string &msg)
 {
-	if (Logging)
+	if (!IsLogged(type, loglevel))
 	{
 		return;
 	}
@@ -341,9 +609,15 @@ void LogManager::Log(const std::string &type, int loglevel, const std::string &m
 	Logging = false;
 }
 
+void LogStream::ChangeLevel(int lvl)
+{
+	this->loglvl = lvl;
+	if (ServerInstance && ServerInstance->Logs)
+		ServerInstance->Logs->UpdateLevels();
+}
 
 FileWriter::FileWriter(FILE* logfile)
-: log(logfile), writeops(0)
+: log(logfile), writeops(0), dropped(0)
 {
 }
 
@@ -354,6 +628,13 @@ void FileWriter::WriteLogLine(const std::string &line)
 // XXX: For now, just return. Don't throw an exception. It'd be nice to find out if this is happening, but I'm terrified of breaking so close to final release. -- w00t
 //		throw CoreException("FileWriter::WriteLogLine called with a closed logfile");
 
+	LogWriterThread* writer = ServerInstance->Logs->GetWriter();
+	if (writer)
+	{
+		writer->Write(log, line, dropped);
+		return;
+	}
+
 	fprintf(log,"%s",line.c_str());
 	if (writeops++ % 20)
 	{
@@ -363,7 +644,13 @@ void FileWriter::WriteLogLine(const std::string &line)
 
 FileWriter::~FileWriter()
 {
-	if (log)
+	LogWriterThread* writer = ServerInstance->Logs ? ServerInstance->Logs->GetWriter() : NULL;
+	if (log && writer)
+	{
+		writer->Close(log);
+		log = NULL;
+	}
+	else if (log)
 	{
 		fflush(log);
 		fclose(log);
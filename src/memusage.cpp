@@ -0,0 +1,167 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "xline.h"
+
+void MemoryReport::Add(const std::string& name, unsigned long count, size_t bytes, bool sampled)
+{
+	Item item;
+	item.name = name;
+	item.count = count;
+	item.bytes = bytes;
+	item.sampled = sampled;
+	items.push_back(item);
+}
+
+size_t MemoryReport::GetTotal() const
+{
+	size_t total = 0;
+	for (std::vector<Item>::const_iterator i = items.begin(); i != items.end(); ++i)
+		total += i->bytes;
+	return total;
+}
+
+std::string MemoryReport::FormatBytes(size_t bytes)
+{
+	char buf[32];
+	if (bytes < 1024)
+		snprintf(buf, sizeof(buf), "%luB", (unsigned long)bytes);
+	else if (bytes < 1024 * 1024)
+		snprintf(buf, sizeof(buf), "%.1fK", bytes / 1024.0);
+	else if (bytes < 1024 * 1024 * 1024)
+		snprintf(buf, sizeof(buf), "%.1fM", bytes / (1024.0 * 1024));
+	else
+		snprintf(buf, sizeof(buf), "%.1fG", bytes / (1024.0 * 1024 * 1024));
+	return buf;
+}
+
+void MemoryReport::Collect()
+{
+	unsigned long extensions = 0;
+	size_t extbytes = 0;
+
+	/* Users, counted exactly: the objects, their strings and their entries in the nick and uuid maps */
+	size_t userbytes = 0;
+	size_t queuebytes = 0;
+	for (user_hash::iterator i = ServerInstance->Users->clientlist->begin(); i != ServerInstance->Users->clientlist->end(); ++i)
+	{
+		User* u = i->second;
+		LocalUser* lu = IS_LOCAL(u);
+		if (lu)
+		{
+			userbytes += sizeof(LocalUser) + StringSize(lu->password) + StringSize(lu->stored_host);
+			queuebytes += lu->eh.GetQueueMemory();
+		}
+		else
+			userbytes += sizeof(RemoteUser);
+
+		userbytes += u->GetStringMemory() + StringSize(i->first);
+		extensions += u->GetExtList().size();
+		extbytes += u->GetExtList().GetMemory();
+	}
+	/* The nick and uuid maps allocate all their slots at once, used or not */
+	userbytes += (ServerInstance->Users->clientlist->bucket_count() + ServerInstance->Users->uuidlist->bucket_count()) * (sizeof(user_hash::value_type) + sizeof(size_t));
+	Add("users", ServerInstance->Users->clientlist->size(), userbytes);
+	Add("user queues", ServerInstance->Users->local_users.size(), queuebytes);
+	/* Hosts, idents and server names are shared between users, so they are counted once */
+	Add("pooled strings", PooledString::GetPoolSize(), PooledString::GetPoolMemory());
+
+	/* Channels and their ban lists, counted exactly */
+	size_t chanbytes = 0;
+	size_t banbytes = 0;
+	unsigned long bans = 0;
+	unsigned long memberships = 0;
+	unsigned long membbytes = 0;
+	for (chan_hash::iterator i = ServerInstance->chanlist->begin(); i != ServerInstance->chanlist->end(); ++i)
+	{
+		Channel* c = i->second;
+		chanbytes += sizeof(Channel) + StringSize(c->name) + StringSize(c->topic) + StringSize(c->setby);
+		chanbytes += StringSize(i->first);
+		extensions += c->GetExtList().size();
+		extbytes += c->GetExtList().GetMemory();
+		memberships += c->GetUsers()->size();
+		membbytes += c->GetUsers()->GetMemory();
+
+		banbytes += c->bans.capacity() * sizeof(BanItem);
+		for (BanList::iterator ban = c->bans.begin(); ban != c->bans.end(); ++ban)
+			banbytes += StringSize(ban->data) + StringSize(ban->set_by);
+		bans += c->bans.size();
+	}
+	chanbytes += ServerInstance->chanlist->bucket_count() * (sizeof(chan_hash::value_type) + sizeof(size_t));
+	Add("channels", ServerInstance->chanlist->size(), chanbytes);
+	Add("channel bans", bans, banbytes);
+
+	/* Each membership is an entry in the channel's member list, counted exactly above, and in
+	 * the user's channel set. Membership modes are almost always short enough to be stored in
+	 * the string object.
+	 */
+	Add("memberships", memberships, membbytes + memberships * (sizeof(Membership) + NodeSize(sizeof(Channel*))));
+
+	/* Extension items on users and channels are counted exactly; there are
+	 * far more memberships, so the number of items on them is sampled. The
+	 * memory is that of each object's slots, which are allocated up to the
+	 * highest slot the object has a value in.
+	 */
+	unsigned long sampled = 0;
+	unsigned long sampledext = 0;
+	size_t sampledbytes = 0;
+	for (chan_hash::iterator i = ServerInstance->chanlist->begin(); i != ServerInstance->chanlist->end() && sampled < SAMPLE_SIZE; ++i)
+	{
+		const UserMembList* users = i->second->GetUsers();
+		for (UserMembCIter m = users->begin(); m != users->end() && sampled < SAMPLE_SIZE; ++m, ++sampled)
+		{
+			sampledext += m->second->GetExtList().size();
+			sampledbytes += m->second->GetExtList().GetMemory();
+		}
+	}
+	if (sampled)
+	{
+		extensions += (unsigned long)((double)sampledext * memberships / sampled);
+		extbytes += (size_t)((double)sampledbytes * memberships / sampled);
+	}
+	Add("extension items", extensions, extbytes, sampled < memberships);
+
+	/* X-lines, counted exactly */
+	size_t xlinebytes = 0;
+	unsigned long xlines = 0;
+	std::vector<std::string> xltypes = ServerInstance->XLines->GetAllTypes();
+	for (std::vector<std::string>::iterator type = xltypes.begin(); type != xltypes.end(); ++type)
+	{
+		XLineLookup* lookup = ServerInstance->XLines->GetAll(*type);
+		if (!lookup)
+			continue;
+		for (LookupIter i = lookup->begin(); i != lookup->end(); ++i)
+		{
+			/* The mask is stored once in the line (as one or two strings) and once as its key */
+			size_t masklen = strlen(i->second->Displayable()) + 1;
+			xlinebytes += sizeof(GLine) + NodeSize(sizeof(XLineLookup::value_type)) + 2 * masklen;
+			xlinebytes += StringSize(i->second->source) + StringSize(i->second->reason);
+		}
+		xlines += lookup->size();
+	}
+	Add("xlines", xlines, xlinebytes);
+
+	size_t dnsbytes;
+	unsigned long dnsitems = ServerInstance->Res->GetCacheUsage(dnsbytes);
+	Add("dns cache", dnsitems, dnsbytes);
+
+	FOREACH_MOD(I_OnMemoryUsage, OnMemoryUsage(*this));
+}
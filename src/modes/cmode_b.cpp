@@ -144,7 +144,9 @@ std::string& ModeChannelBan::AddBan(User *user, std::string &dest, Channel *chan
 	b.set_time = ServerInstance->Time();
 	b.data.assign(dest, 0, MAXBUF);
 	b.set_by.assign(user->nick, 0, 64);
+	b.mask.Compile(b.data);
 	chan->bans.push_back(b);
+	chan->BanListChanged();
 	return dest;
 }
 
@@ -169,6 +171,7 @@ std::string& ModeChannelBan::DelBan(User *user, std::string& dest, Channel *chan
 				return dest;
 			}
 			chan->bans.erase(i);
+			chan->BanListChanged();
 			return dest;
 		}
 	}
@@ -76,13 +76,55 @@ void Event::Send()
 
 // These declarations define the behavours of the base class Module (which does nothing at all)
 
-Module::Module() { }
+Module::Module() : hookstats(NULL) { }
 CullResult Module::cull()
 {
 	return classbase::cull();
 }
 Module::~Module()
 {
+	delete[] hookstats;
+}
+
+bool HookProfiler::enabled = false;
+
+void HookProfiler::Stop()
+{
+	timespec end;
+	Histogram::Now(end);
+	if (!mod->hookstats)
+	{
+		mod->hookstats = new Module::HookStats[I_END];
+		memset(mod->hookstats, 0, sizeof(Module::HookStats) * I_END);
+	}
+	Module::HookStats& stats = mod->hookstats[hook];
+	stats.calls++;
+	stats.usecs += Histogram::Elapsed(start, end);
+}
+
+const char* HookProfiler::GetName(Implementation hook)
+{
+	static const char* const names[I_END] = {
+		"",
+		"OnUserConnect", "OnUserQuit", "OnUserDisconnect", "OnUserJoin", "OnUserPart", "OnRehash",
+		"OnSendSnotice", "OnUserPreJoin", "OnUserPreKick", "OnUserKick", "OnOper", "OnInfo", "OnWhois",
+		"OnUserPreInvite", "OnUserInvite", "OnUserPreMessage", "OnUserPreNotice", "OnUserPreNick",
+		"OnUserMessage", "OnUserNotice", "OnMode", "OnGetServerDescription", "OnSyncUser",
+		"OnSyncChannel", "OnDecodeMetaData", "OnWallops", "OnAcceptConnection", "OnUserInit",
+		"OnChangeHost", "OnChangeName", "OnAddLine", "OnDelLine", "OnExpireLine",
+		"OnUserPostNick", "OnPreMode", "On005Numeric", "OnKill", "OnRemoteKill", "OnLoadModule",
+		"OnUnloadModule", "OnBackgroundTimer", "OnPreCommand", "OnCheckReady", "OnCheckInvite",
+		"OnRawMode", "OnCheckKey", "OnCheckLimit", "OnCheckBan", "OnCheckChannelBan", "OnExtBanCheck",
+		"OnStats", "OnChangeLocalUserHost", "OnPreTopicChange",
+		"OnPostTopicChange", "OnEvent", "OnGlobalOper", "OnPostConnect", "OnAddBan",
+		"OnDelBan", "OnChangeLocalUserGECOS", "OnUserRegister", "OnChannelPreDelete", "OnChannelDelete",
+		"OnPostOper", "OnSyncNetwork", "OnSetAway", "OnPostCommand", "OnPostJoin",
+		"OnWhoisLine", "OnBuildNeighborList", "OnGarbageCollect", "OnSetConnectClass",
+		"OnText", "OnPassCompare", "OnRunTestSuite", "OnNamesListItem", "OnNumeric", "OnHookIO",
+		"OnPreRehash", "OnModuleRehash", "OnSendWhoLine", "OnChangeIdent", "OnMemoryUsage",
+		"OnCheckExtBan"
+	};
+	return hook > I_BEGIN && hook < I_END ? names[hook] : "";
 }
 
 ModResult	Module::OnSendSnotice(char &snomask, std::string &type, const std::string &message) { return MOD_RES_PASSTHRU; }
@@ -126,6 +168,7 @@ ModResult	Module::OnCheckLimit(User*, Channel*) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnCheckChannelBan(User*, Channel*) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnCheckBan(User*, Channel*, const std::string&) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnExtBanCheck(User*, Channel*, char) { return MOD_RES_PASSTHRU; }
+ModResult	Module::OnCheckExtBan(User*, Channel*, const std::string&) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnStats(char, User*, string_list&) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnChangeLocalUserHost(LocalUser*, const std::string&) { return MOD_RES_PASSTHRU; }
 ModResult	Module::OnChangeLocalUserGECOS(LocalUser*, const std::string&) { return MOD_RES_PASSTHRU; }
@@ -176,6 +219,7 @@ ModResult	Module::OnNumeric(User*, unsigned int, const std::string&) { return MO
 void		Module::OnHookIO(StreamSocket*, ListenSocket*) { }
 ModResult   Module::OnAcceptConnection(int, ListenSocket*, irc::sockets::sockaddrs*, irc::sockets::sockaddrs*) { return MOD_RES_PASSTHRU; }
 void		Module::OnSendWhoLine(User*, const std::vector<std::string>&, User*, std::string&) { }
+void		Module::OnMemoryUsage(MemoryReport&) { }
 
 ModuleManager::ModuleManager() : ModCount(0)
 {
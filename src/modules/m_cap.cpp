@@ -92,6 +92,7 @@ class CommandCAP : public Command
 		else if (subcommand == "END")
 		{
 			reghold.set(user, 0);
+			ServerInstance->Users->CheckReady(IS_LOCAL(user));
 		}
 		else if ((subcommand == "LS") || (subcommand == "LIST"))
 		{
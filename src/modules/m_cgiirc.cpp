@@ -161,6 +161,7 @@ class CGIResolver : public Resolver
 		int count = waiting.get(them);
 		if (count)
 			waiting.set(them, count - 1);
+		ServerInstance->Users->CheckReady(IS_LOCAL(them));
 	}
 };
 
@@ -85,10 +85,14 @@ class ModuleChannelNames : public Module
 
 				ServerInstance->SendGlobalMode(modes, ServerInstance->FakeClient);
 			}
+			/* Kicking removes the user from the member list, so gather them first */
+			std::vector<User*> locals;
 			const UserMembList* users = c->GetUsers();
 			for(UserMembCIter j = users->begin(); j != users->end(); ++j)
 				if (IS_LOCAL(j->first))
-					c->KickUser(ServerInstance->FakeClient, j->first, "Channel name no longer valid");
+					locals.push_back(j->first);
+			for (std::vector<User*>::iterator j = locals.begin(); j != locals.end(); ++j)
+				c->KickUser(ServerInstance->FakeClient, *j, "Channel name no longer valid");
 		}
 		badchan = false;
 	}
@@ -27,7 +27,7 @@ class ModuleBadChannelExtban : public Module
  private:
  public:
 	ModuleBadChannelExtban() 	{
-		Implementation eventlist[] = { I_OnCheckBan, I_On005Numeric };
+		Implementation eventlist[] = { I_OnCheckExtBan, I_On005Numeric };
 		ServerInstance->Modules->Attach(eventlist, this, 2);
 	}
 
@@ -40,7 +40,7 @@ class ModuleBadChannelExtban : public Module
 		return Version("Extban 'j' - channel status/join ban", VF_OPTCOMMON|VF_VENDOR);
 	}
 
-	ModResult OnCheckBan(User *user, Channel *c, const std::string& mask)
+	ModResult OnCheckExtBan(User *user, Channel *c, const std::string& mask)
 	{
 		if (mask[0] == 'j' && mask[1] == ':')
 		{
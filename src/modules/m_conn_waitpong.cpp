@@ -81,6 +81,7 @@ class ModuleWaitPong : public Module
 				if (!parameters.empty() && *pingrpl == parameters[0])
 				{
 					ext.unset(user);
+					ServerInstance->Users->CheckReady(user);
 					return MOD_RES_DENY;
 				}
 				else
@@ -77,6 +77,7 @@ class DNSBLResolver : public Resolver
 			int i = countExt.get(them);
 			if (i)
 				countExt.set(them, i - 1);
+			ServerInstance->Users->CheckReady(them);
 			// Now we calculate the bitmask: 256*(256*(256*a+b)+c)+d
 			if(result.length())
 			{
@@ -203,6 +204,7 @@ class DNSBLResolver : public Resolver
 			int i = countExt.get(them);
 			if (i)
 				countExt.set(them, i - 1);
+			ServerInstance->Users->CheckReady(them);
 		}
 	}
 
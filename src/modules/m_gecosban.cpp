@@ -26,7 +26,7 @@ class ModuleGecosBan : public Module
  public:
 	ModuleGecosBan()
 	{
-		Implementation eventlist[] = { I_OnCheckBan, I_On005Numeric };
+		Implementation eventlist[] = { I_OnCheckExtBan, I_On005Numeric };
 		ServerInstance->Modules->Attach(eventlist, this, 2);
 	}
 
@@ -39,7 +39,7 @@ class ModuleGecosBan : public Module
 		return Version("Extban 'r' - realname (gecos) ban", VF_OPTCOMMON|VF_VENDOR);
 	}
 
-	ModResult OnCheckBan(User *user, Channel *c, const std::string& mask)
+	ModResult OnCheckExtBan(User *user, Channel *c, const std::string& mask)
 	{
 		if (mask[0] == 'r' && mask[1] == ':')
 		{
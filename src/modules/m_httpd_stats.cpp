@@ -110,7 +110,24 @@ class ModuleHttpStats : public Module
 				stime = gmtime(&server_uptime);
 				data << "<uptime><days>" << stime->tm_yday << "</days><hours>" << stime->tm_hour << "</hours><mins>" << stime->tm_min << "</mins><secs>" << stime->tm_sec << "</secs><boot_time_t>" << ServerInstance->startup_time << "</boot_time_t></uptime>";
 
-				data << "<isupport>" << Sanitize(ServerInstance->Config->data005) << "</isupport></general><xlines>";
+				data << "<isupport>" << Sanitize(ServerInstance->Config->data005) << "</isupport></general><mainloop>";
+				for (int phase = -1; phase < LOOP_PHASES; phase++)
+				{
+					const Histogram& t = phase < 0 ? ServerInstance->stats->statsLoopBusy : ServerInstance->stats->statsLoopPhase[phase];
+					data << "<phase><name>" << (phase < 0 ? "pass" : serverstats::GetLoopPhaseName((LoopPhase)phase)) << "</name><count>" << t.GetCount()
+						<< "</count><totaltime>" << t.GetTotal() << "</totaltime><meantime>" << t.GetMean() << "</meantime><p50time>"
+						<< t.GetPercentile(50) << "</p50time><p99time>" << t.GetPercentile(99) << "</p99time><maxtime>" << t.GetMax()
+						<< "</maxtime></phase>";
+				}
+				data << "</mainloop><memory>";
+				MemoryReport memory;
+				memory.Collect();
+				for (std::vector<MemoryReport::Item>::iterator i = memory.items.begin(); i != memory.items.end(); ++i)
+				{
+					data << "<item><name>" << Sanitize(i->name) << "</name><count>" << i->count << "</count><bytes>" << i->bytes
+						<< "</bytes><sampled>" << (i->sampled ? 1 : 0) << "</sampled></item>";
+				}
+				data << "<total>" << memory.GetTotal() << "</total></memory><xlines>";
 				std::vector<std::string> xltypes = ServerInstance->XLines->GetAllTypes();
 				for (std::vector<std::string>::iterator it = xltypes.begin(); it != xltypes.end(); ++it)
 				{
@@ -137,7 +154,39 @@ class ModuleHttpStats : public Module
 					Version v = m->GetVersion();
 					data << "<module><name>" << *i << "</name><description>" << Sanitize(v.description) << "</description></module>";
 				}
-				data << "</modulelist><channellist>";
+				data << "</modulelist><hooklist>";
+
+				for (std::vector<std::string>::iterator i = module_names.begin(); i != module_names.end(); ++i)
+				{
+					Module::HookStats* stats = ServerInstance->Modules->Find(*i)->hookstats;
+					if (!stats)
+						continue;
+					for (int hook = I_BEGIN + 1; hook < I_END; hook++)
+					{
+						if (!stats[hook].calls)
+							continue;
+						data << "<hook><module>" << *i << "</module><name>" << HookProfiler::GetName((Implementation)hook) << "</name><calls>"
+							<< stats[hook].calls << "</calls><totaltime>" << stats[hook].usecs << "</totaltime></hook>";
+					}
+				}
+
+				data << "</hooklist><commandlist>";
+
+				for (Commandtable::iterator i = ServerInstance->Parser->cmdlist.begin(); i != ServerInstance->Parser->cmdlist.end(); ++i)
+				{
+					Command* cmd = i->second;
+					if (!cmd->use_count)
+						continue;
+
+					const Histogram& t = cmd->exec_time;
+					data << "<command><name>" << cmd->name << "</name><usecount>" << cmd->use_count << "</usecount><bytesin>"
+						<< cmd->total_bytes << "</bytesin><bytesout>" << cmd->output_bytes << "</bytesout><calls>" << t.GetCount()
+						<< "</calls><totaltime>" << t.GetTotal() << "</totaltime><meantime>" << t.GetMean() << "</meantime><p50time>"
+						<< t.GetPercentile(50) << "</p50time><p99time>" << t.GetPercentile(99) << "</p99time><maxtime>" << t.GetMax()
+						<< "</maxtime></command>";
+				}
+
+				data << "</commandlist><channellist>";
 
 				for (chan_hash::const_iterator a = ServerInstance->chanlist->begin(); a != ServerInstance->chanlist->end(); ++a)
 				{
@@ -187,6 +187,10 @@ class IdentRequestSocket : public EventHandler
 				done = true;
 			break;
 		}
+
+		/* The result is picked up by OnCheckReady */
+		if (done)
+			ServerInstance->Users->CheckReady(user);
 	}
 
 	void Close()
@@ -363,7 +367,7 @@ class ModuleIdent : public Module
 		/* wooo, got a result (it will be good, or bad) */
 		if (isock->result.empty())
 		{
-			user->ident.insert(0, 1, '~');
+			user->ident = "~" + user->ident;
 			user->WriteServ("NOTICE Auth :*** Could not find your ident, using %s instead.", user->ident.c_str());
 		}
 		else
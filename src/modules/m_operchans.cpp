@@ -61,7 +61,7 @@ class ModuleOperChans : public Module
 	{
 		if (!ServerInstance->Modes->AddMode(&oc))
 			throw ModuleException("Could not add new modes!");
-		Implementation eventlist[] = { I_OnCheckBan, I_On005Numeric, I_OnUserPreJoin };
+		Implementation eventlist[] = { I_OnCheckExtBan, I_On005Numeric, I_OnUserPreJoin };
 		ServerInstance->Modules->Attach(eventlist, this, 3);
 	}
 
@@ -76,7 +76,7 @@ class ModuleOperChans : public Module
 		return MOD_RES_PASSTHRU;
 	}
 
-	ModResult OnCheckBan(User *user, Channel *c, const std::string& mask)
+	ModResult OnCheckExtBan(User *user, Channel *c, const std::string& mask)
 	{
 		if (mask[0] == 'O' && mask[1] == ':')
 		{
@@ -26,7 +26,7 @@ class ModuleServerBan : public Module
  private:
  public:
 	ModuleServerBan() 	{
-		Implementation eventlist[] = { I_OnCheckBan, I_On005Numeric };
+		Implementation eventlist[] = { I_OnCheckExtBan, I_On005Numeric };
 		ServerInstance->Modules->Attach(eventlist, this, 2);
 	}
 
@@ -39,7 +39,7 @@ class ModuleServerBan : public Module
 		return Version("Extban 's' - server ban",VF_OPTCOMMON|VF_VENDOR);
 	}
 
-	ModResult OnCheckBan(User *user, Channel *c, const std::string& mask)
+	ModResult OnCheckExtBan(User *user, Channel *c, const std::string& mask)
 	{
 		if (mask[0] == 's' && mask[1] == ':')
 		{
@@ -128,7 +128,7 @@ class ModuleServicesAccount : public Module
 		ServerInstance->Modules->AddService(m4);
 		ServerInstance->Modules->AddService(m5);
 		ServerInstance->Modules->AddService(accountname);
-		Implementation eventlist[] = { I_OnWhois, I_OnUserPreMessage, I_OnUserPreNotice, I_OnUserPreJoin, I_OnCheckBan,
+		Implementation eventlist[] = { I_OnWhois, I_OnUserPreMessage, I_OnUserPreNotice, I_OnUserPreJoin, I_OnCheckExtBan,
 			I_OnDecodeMetaData, I_On005Numeric, I_OnUserPostNick, I_OnSetConnectClass };
 
 		ServerInstance->Modules->Attach(eventlist, this, 9);
@@ -208,7 +208,7 @@ class ModuleServicesAccount : public Module
 		return MOD_RES_PASSTHRU;
 	}
 
-	ModResult OnCheckBan(User* user, Channel* chan, const std::string& mask)
+	ModResult OnCheckExtBan(User* user, Channel* chan, const std::string& mask)
 	{
 		if (mask[0] == 'R' && mask[1] == ':')
 		{
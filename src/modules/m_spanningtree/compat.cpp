@@ -169,7 +169,7 @@ void TreeSocket::WriteLine(std::string line)
 					std::string target = line.substr(d + 1, e - d - 1);
 
 					ServerInstance->Logs->Log("m_spanningtree",DEBUG,"Forging acceptance of CHGIDENT from 1201-protocol server");
-					recvq.insert(0, ":" + target + " FIDENT " + line.substr(e) + "\n");
+					recvq.insert(recvq_pos, ":" + target + " FIDENT " + line.substr(e) + "\n");
 				}
 
 				Command* thiscmd = ServerInstance->Parser->GetHandler(subcmd);
@@ -167,9 +167,11 @@ int TreeServer::QuitUsers(const std::string &reason)
 {
 	const char* reason_s = reason.c_str();
 	std::vector<User*> time_to_die;
+	/* Users on this server were given exactly this name, and pooled strings compare by pointer */
+	PooledString name(ServerName.c_str());
 	for (user_hash::iterator n = ServerInstance->Users->clientlist->begin(); n != ServerInstance->Users->clientlist->end(); n++)
 	{
-		if (n->second->server == ServerName)
+		if (n->second->server == name)
 		{
 			time_to_die.push_back(n->second);
 		}
@@ -237,7 +237,7 @@ void TreeSocket::OnDataReady()
 		if (!getError().empty())
 			break;
 	}
-	if (LinkState != CONNECTED && recvq.length() > 4096)
+	if (LinkState != CONNECTED && getRecvQSize() > 4096)
 		SendError("RecvQ overrun (line too long)");
 	Utils->Creator->loopCall = false;
 }
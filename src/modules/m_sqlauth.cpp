@@ -55,6 +55,7 @@ class AuthQuery : public SQLQuery
 				ServerInstance->SNO->WriteGlobalSno('a', "Forbidden connection from %s!%s@%s (SQL query returned no matches)", user->nick.c_str(), user->ident.c_str(), user->host.c_str());
 			pendingExt.set(user, AUTH_STATE_FAIL);
 		}
+		ServerInstance->Users->CheckReady(IS_LOCAL(user));
 	}
 
 	void OnError(SQLerror& error)
@@ -65,6 +66,7 @@ class AuthQuery : public SQLQuery
 		pendingExt.set(user, AUTH_STATE_FAIL);
 		if (verbose)
 			ServerInstance->SNO->WriteGlobalSno('a', "Forbidden connection from %s!%s@%s (SQL query failed: %s)", user->nick.c_str(), user->ident.c_str(), user->host.c_str(), error.Str());
+		ServerInstance->Users->CheckReady(IS_LOCAL(user));
 	}
 };
 
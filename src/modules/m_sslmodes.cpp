@@ -85,7 +85,7 @@ class ModuleSSLModes : public Module
 	{
 		if (!ServerInstance->Modes->AddMode(&sslm))
 			throw ModuleException("Could not add new modes!");
-		Implementation eventlist[] = { I_OnUserPreJoin, I_OnCheckBan, I_On005Numeric };
+		Implementation eventlist[] = { I_OnUserPreJoin, I_OnCheckExtBan, I_On005Numeric };
 		ServerInstance->Modules->Attach(eventlist, this, 3);
 	}
 
@@ -111,7 +111,7 @@ class ModuleSSLModes : public Module
 		return MOD_RES_PASSTHRU;
 	}
 
-	ModResult OnCheckBan(User *user, Channel *c, const std::string& mask)
+	ModResult OnCheckExtBan(User *user, Channel *c, const std::string& mask)
 	{
 		if (mask[0] == 'z' && mask[1] == ':')
 		{
@@ -176,6 +176,7 @@ static void checkall(Module* noimpl)
 	CHK(OnModuleRehash);
 	CHK(OnSendWhoLine);
 	CHK(OnChangeIdent);
+	CHK(OnCheckExtBan);
 }
 
 class CommandTest : public Command
@@ -112,15 +112,20 @@ void Snomask::SendMessage(const std::string &message, char mysnomask)
 
 		if (!LastBlocked)
 		{
+			/* Only the target nick differs between opers, so render the rest once */
+			reference<SharedBuffer> tail;
+
 			/* Only opers can receive snotices, so we iterate the oper list */
 			std::list<User*>::iterator i = ServerInstance->Users->all_opers.begin();
 
 			while (i != ServerInstance->Users->all_opers.end())
 			{
-				User* a = *i;
-				if (IS_LOCAL(a) && a->IsModeSet('s') && a->IsNoticeMaskSet(mysnomask) && !a->quitting)
+				LocalUser* a = IS_LOCAL(*i);
+				if (a && a->IsModeSet('s') && a->IsNoticeMaskSet(mysnomask) && !a->quitting)
 				{
-					a->WriteServ("NOTICE %s :*** %s: %s", a->nick.c_str(), desc.c_str(), message.c_str());
+					if (!tail)
+						tail = LocalUser::MakeLine(" :*** " + desc + ": " + message);
+					a->Write(":" + ServerInstance->Config->ServerName + " NOTICE " + a->nick, tail);
 				}
 
 				i++;
@@ -147,15 +152,20 @@ void Snomask::Flush()
 
 		if (!LastBlocked)
 		{
+			/* Only the target nick differs between opers, so render the rest once */
+			reference<SharedBuffer> tail;
+
 			/* Only opers can receive snotices, so we iterate the oper list */
 			std::list<User*>::iterator i = ServerInstance->Users->all_opers.begin();
 
 			while (i != ServerInstance->Users->all_opers.end())
 			{
-				User* a = *i;
-				if (IS_LOCAL(a) && a->IsModeSet('s') && a->IsNoticeMaskSet(LastLetter) && !a->quitting)
+				LocalUser* a = IS_LOCAL(*i);
+				if (a && a->IsModeSet('s') && a->IsNoticeMaskSet(LastLetter) && !a->quitting)
 				{
-					a->WriteServ("NOTICE %s :*** %s: %s", a->nick.c_str(), desc.c_str(), mesg.c_str());
+					if (!tail)
+						tail = LocalUser::MakeLine(" :*** " + desc + ": " + mesg);
+					a->Write(":" + ServerInstance->Config->ServerName + " NOTICE " + a->nick, tail);
 				}
 
 				i++;
@@ -91,6 +91,16 @@ int InspIRCd::BindPorts(FailedPortList &failed_ports)
 		if (strncasecmp(Addr.c_str(), "::ffff:", 7) == 0)
 			this->Logs->Log("SOCKET",DEFAULT, "Using 4in6 (::ffff:) isn't recommended. You should bind IPv4 addresses directly instead.");
 
+#ifdef SO_REUSEPORT
+		int listeners = tag->getInt("listeners", 1);
+		if (listeners < 1)
+			listeners = 1;
+		else if (listeners > 64)
+			listeners = 64;
+#else
+		int listeners = 1;
+#endif
+
 		irc::portparser portrange(porttag, false);
 		int portno = -1;
 		while (0 != (portno = portrange.GetToken()))
@@ -100,29 +110,35 @@ int InspIRCd::BindPorts(FailedPortList &failed_ports)
 				continue;
 			std::string bind_readable = bindspec.str();
 
-			bool skip = false;
-			for (std::vector<ListenSocket*>::iterator n = old_ports.begin(); n != old_ports.end(); ++n)
+			/* Keep as many of the existing sockets for this address as we still want */
+			int have = 0;
+			for (std::vector<ListenSocket*>::iterator n = old_ports.begin(); n != old_ports.end() && have < listeners; )
 			{
 				if ((**n).bind_desc == bind_readable)
 				{
-					skip = true;
-					old_ports.erase(n);
-					break;
+					have++;
+					n = old_ports.erase(n);
 				}
+				else
+					++n;
 			}
-			if (!skip)
+			bool added = false;
+			for (; have < listeners; have++)
 			{
 				ListenSocket* ll = new ListenSocket(tag, bindspec);
 
 				if (ll->GetFd() > -1)
 				{
-					bound++;
+					if (!added)
+						bound++;
+					added = true;
 					ports.push_back(ll);
 				}
 				else
 				{
 					failed_ports.push_back(std::make_pair(bind_readable, strerror(errno)));
 					delete ll;
+					break;
 				}
 			}
 		}
@@ -36,9 +36,10 @@ void EventHandler::SetFd(int FD)
 
 SocketEngine::SocketEngine()
 {
-	TotalEvents = WriteEvents = ReadEvents = ErrorEvents = 0;
+	TotalEvents = WriteEvents = ReadEvents = ErrorEvents = EngineCalls = 0;
 	lastempty = ServerInstance->Time();
 	indata = outdata = 0;
+	Histogram::Now(WaitEnd);
 }
 
 SocketEngine::~SocketEngine()
@@ -73,6 +74,12 @@ void SocketEngine::ChangeEventMask(EventHandler* eh, int change)
 	OnSetEvent(eh, old_m, new_m);
 }
 
+void SocketEngine::WaitFinished()
+{
+	ServerInstance->UpdateTime();
+	Histogram::Now(WaitEnd);
+}
+
 void SocketEngine::DispatchTrialWrites()
 {
 	std::vector<int> working_list;
@@ -120,7 +127,11 @@ bool SocketEngine::BoundsCheckFd(EventHandler* eh)
 
 int SocketEngine::Accept(EventHandler* fd, sockaddr *addr, socklen_t *addrlen)
 {
+#ifdef HAS_ACCEPT4
+	return accept4(fd->GetFd(), addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
 	return accept(fd->GetFd(), addr, addrlen);
+#endif
 }
 
 int SocketEngine::Close(EventHandler* fd)
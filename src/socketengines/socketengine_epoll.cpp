@@ -132,6 +132,7 @@ bool EPollEngine::AddFd(EventHandler* eh, int event_mask)
 	memset(&ev,0,sizeof(ev));
 	ev.events = mask_to_epoll(event_mask);
 	ev.data.fd = fd;
+	EngineCalls++;
 	int i = epoll_ctl(EngineHandle, EPOLL_CTL_ADD, fd, &ev);
 	if (i < 0)
 	{
@@ -158,6 +159,7 @@ void EPollEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 		memset(&ev,0,sizeof(ev));
 		ev.events = new_events;
 		ev.data.fd = eh->GetFd();
+		EngineCalls++;
 		epoll_ctl(EngineHandle, EPOLL_CTL_MOD, eh->GetFd(), &ev);
 	}
 }
@@ -174,6 +176,7 @@ void EPollEngine::DelFd(EventHandler* eh)
 	struct epoll_event ev;
 	memset(&ev,0,sizeof(ev));
 	ev.data.fd = fd;
+	EngineCalls++;
 	int i = epoll_ctl(EngineHandle, EPOLL_CTL_DEL, fd, &ev);
 
 	if (i < 0)
@@ -191,8 +194,9 @@ int EPollEngine::DispatchEvents()
 {
 	socklen_t codesize = sizeof(int);
 	int errcode;
-	int i = epoll_wait(EngineHandle, events, GetMaxFds() - 1, 1000);
-	ServerInstance->UpdateTime();
+	EngineCalls++;
+	int i = epoll_wait(EngineHandle, events, GetMaxFds() - 1, ServerInstance->Timers->GetNextTimeout(1000));
+	WaitFinished();
 
 	TotalEvents += i;
 
@@ -202,6 +206,7 @@ int EPollEngine::DispatchEvents()
 		if (!eh)
 		{
 			ServerInstance->Logs->Log("SOCKET",DEBUG,"Got event on unknown fd: %d", events[j].data.fd);
+			EngineCalls++;
 			epoll_ctl(EngineHandle, EPOLL_CTL_DEL, events[j].data.fd, &events[j]);
 			continue;
 		}
@@ -118,6 +118,7 @@ bool KQueueEngine::AddFd(EventHandler* eh, int event_mask)
 	struct kevent ke;
 	EV_SET(&ke, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
 
+	EngineCalls++;
 	int i = kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 	if (i == -1)
 	{
@@ -150,10 +151,12 @@ void KQueueEngine::DelFd(EventHandler* eh)
 	// First remove the write filter ignoring errors, since we can't be
 	// sure if there are actually any write filters registered.
 	EV_SET(&ke, eh->GetFd(), EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	EngineCalls++;
 	kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 
 	// Then remove the read filter.
 	EV_SET(&ke, eh->GetFd(), EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	EngineCalls++;
 	int j = kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 
 	if (j < 0)
@@ -175,6 +178,7 @@ void KQueueEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 		// new poll-style write
 		struct kevent ke;
 		EV_SET(&ke, eh->GetFd(), EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+		EngineCalls++;
 		int i = kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 		if (i < 0) {
 			ServerInstance->Logs->Log("SOCKET",DEFAULT,"Failed to mark for writing: %d %s",
@@ -186,6 +190,7 @@ void KQueueEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 		// removing poll-style write
 		struct kevent ke;
 		EV_SET(&ke, eh->GetFd(), EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+		EngineCalls++;
 		int i = kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 		if (i < 0) {
 			ServerInstance->Logs->Log("SOCKET",DEFAULT,"Failed to mark for writing: %d %s",
@@ -197,6 +202,7 @@ void KQueueEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 		// new one-shot write
 		struct kevent ke;
 		EV_SET(&ke, eh->GetFd(), EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, NULL);
+		EngineCalls++;
 		int i = kevent(EngineHandle, &ke, 1, 0, 0, NULL);
 		if (i < 0) {
 			ServerInstance->Logs->Log("SOCKET",DEFAULT,"Failed to mark for writing: %d %s",
@@ -207,11 +213,13 @@ void KQueueEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 
 int KQueueEngine::DispatchEvents()
 {
-	ts.tv_nsec = 0;
-	ts.tv_sec = 1;
+	int timeout = ServerInstance->Timers->GetNextTimeout(1000);
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+	ts.tv_sec = timeout / 1000;
 
+	EngineCalls++;
 	int i = kevent(EngineHandle, NULL, 0, &ke_list[0], GetMaxFds(), &ts);
-	ServerInstance->UpdateTime();
+	WaitFinished();
 
 	TotalEvents += i;
 
@@ -226,12 +226,13 @@ void PollEngine::DelFd(EventHandler* eh)
 
 int PollEngine::DispatchEvents()
 {
-	int i = poll(events, CurrentSetSize, 1000);
+	EngineCalls++;
+	int i = poll(events, CurrentSetSize, ServerInstance->Timers->GetNextTimeout(1000));
 	int index;
 	socklen_t codesize = sizeof(int);
 	int errcode;
 	int processed = 0;
-	ServerInstance->UpdateTime();
+	WaitFinished();
 
 	if (i > 0)
 	{
@@ -120,12 +120,14 @@ int SelectEngine::DispatchEvents()
 		FD_SET (i, &errfdset);
 	}
 
-	/* One second wait */
-	tval.tv_sec = 1;
-	tval.tv_usec = 0;
+	/* Wait up to one second, or until the next timer is due */
+	int timeout = ServerInstance->Timers->GetNextTimeout(1000);
+	tval.tv_sec = timeout / 1000;
+	tval.tv_usec = (timeout % 1000) * 1000;
 
+	EngineCalls++;
 	sresult = select(FD_SETSIZE, &rfdset, &wfdset, &errfdset, &tval);
-	ServerInstance->UpdateTime();
+	WaitFinished();
 
 	/* Nothing to process this time around */
 	if (sresult < 1)
@@ -0,0 +1,594 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <vector>
+#include <string>
+#include <map>
+#include "inspircd.h"
+#include "exitcodes.h"
+#include "socketengine.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <ulimit.h>
+
+/** Number of submission queue entries. Event mask changes are queued here
+ * and only handed to the kernel when the queue fills or we wait for events.
+ */
+#define URING_SQ_ENTRIES 4096
+
+/** Number of completion queue entries. Newer kernels buffer completions
+ * which do not fit rather than dropping them.
+ */
+#define URING_CQ_ENTRIES 16384
+
+/** user_data for poll removal requests, whose completions we ignore */
+#define URING_REMOVE_TAG (~(__u64)0)
+
+/** A specialisation of the SocketEngine class, designed to use linux 5.11+ io_uring.
+ *
+ * This is a batched readiness engine, not a completion based one: each
+ * descriptor has a poll request on the ring, and reads and writes are still
+ * done by the event handlers once they are told the socket is ready, as with
+ * epoll. Changes to the event mask are queued as submission entries, and all
+ * changes made while handling one batch of events reach the kernel together
+ * in the same io_uring_enter() call that waits for the next batch, rather
+ * than costing an epoll_ctl() call each.
+ */
+class URingEngine : public SocketEngine
+{
+private:
+	/** Per descriptor state of the poll request on the ring */
+	struct PollState
+	{
+		/** Bumped every time the poll request is replaced, so that
+		 * completions for an older request can be told apart.
+		 */
+		unsigned int gen;
+		/** Events the current request polls for, or 0 if none is armed */
+		int events;
+		/** True if the current request is multishot (edge triggered) */
+		bool multishot;
+	};
+
+	int EngineHandle;
+	PollState* state;
+
+	/* Submission queue, shared with the kernel */
+	unsigned int* sq_head;
+	unsigned int* sq_tail;
+	unsigned int sq_mask;
+	unsigned int* sq_array;
+	struct io_uring_sqe* sqes;
+	unsigned int sq_pending;
+	/** Flags for poll removal requests. Kernels which can (5.17+) are asked to
+	 * skip their completion on success; anywhere else it is ignored on arrival.
+	 */
+	__u8 remove_flags;
+	/** True if the kernel supports multishot polls (5.13+), which edge
+	 * triggered descriptors use. Without them, every descriptor is polled
+	 * with one-shot, level triggered requests.
+	 */
+	bool multishot_ok;
+
+	/* Completion queue, shared with the kernel */
+	unsigned int* cq_head;
+	unsigned int* cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe* cqes;
+
+	/** Completions copied out of the ring before being dispatched */
+	std::vector<struct io_uring_cqe> events;
+
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+
+	static inline __u64 MakeData(int fd, unsigned int gen) { return ((__u64)gen << 32) | (unsigned int)fd; }
+
+	/** Get a free submission entry, flushing the queue to the kernel if it is full */
+	struct io_uring_sqe* GetSQE();
+	/** Hand all queued submission entries to the kernel, optionally waiting for a completion */
+	int Enter(unsigned int min_complete, int timeout_ms);
+	/** Queue a poll request for the given fd matching its current event mask */
+	void Arm(int fd, int event_mask);
+	/** Queue the removal of the current poll request for the given fd */
+	void Disarm(int fd);
+	/** Hand the poll result for an fd to its event handler */
+	void Dispatch(EventHandler* eh, int revents);
+	/** Find out whether the kernel supports multishot polls, by trying one */
+	bool ProbeMultishot();
+	void Fatal(const char* what);
+
+public:
+	/** Create a new URingEngine
+	 */
+	URingEngine();
+	/** Delete a URingEngine
+	 */
+	virtual ~URingEngine();
+	virtual bool AddFd(EventHandler* eh, int event_mask);
+	virtual void OnSetEvent(EventHandler* eh, int old_mask, int new_mask);
+	virtual void DelFd(EventHandler* eh);
+	virtual int DispatchEvents();
+	virtual std::string GetName();
+};
+
+/** Convert an event mask into the poll events to wait for, and whether the
+ * poll can be edge triggered (multishot) or must be level triggered.
+ * This mirrors the choice EPollEngine makes between EPOLLET and level polling;
+ * without multishot polls, it is the same as PollEngine's.
+ */
+static int mask_to_poll(int event_mask, bool multishot_ok, bool& multishot)
+{
+	int rv = 0;
+	if (!multishot_ok || (event_mask & (FD_WANT_POLL_READ | FD_WANT_POLL_WRITE | FD_WANT_SINGLE_WRITE)))
+	{
+		// we need to use standard polling on this FD
+		multishot = false;
+		if (event_mask & (FD_WANT_POLL_READ | FD_WANT_FAST_READ))
+			rv |= POLLIN;
+		if (event_mask & (FD_WANT_POLL_WRITE | FD_WANT_FAST_WRITE | FD_WANT_SINGLE_WRITE))
+			rv |= POLLOUT;
+	}
+	else
+	{
+		// we can use edge-triggered polling on this FD
+		multishot = true;
+		if (event_mask & (FD_WANT_FAST_READ | FD_WANT_EDGE_READ))
+			rv |= POLLIN;
+		if (event_mask & (FD_WANT_FAST_WRITE | FD_WANT_EDGE_WRITE))
+			rv |= POLLOUT;
+	}
+	return rv;
+}
+
+void URingEngine::Fatal(const char* what)
+{
+	ServerInstance->Logs->Log("SOCKET",DEFAULT, "ERROR: Could not initialize socket engine: %s: %s", what, strerror(errno));
+	ServerInstance->Logs->Log("SOCKET",DEFAULT, "ERROR: Your kernel probably does not have the proper features. This is a fatal error, exiting now.");
+	printf("ERROR: Could not initialize io_uring socket engine: %s: %s\n", what, strerror(errno));
+	printf("ERROR: Your kernel probably does not have the proper features. This is a fatal error, exiting now.\n");
+	ServerInstance->Exit(EXIT_STATUS_SOCKETENGINE);
+}
+
+URingEngine::URingEngine() : sq_pending(0), remove_flags(0), multishot_ok(false)
+{
+	int max = ulimit(4, 0);
+	if (max > 0)
+	{
+		MAX_DESCRIPTORS = max;
+	}
+	else
+	{
+		ServerInstance->Logs->Log("SOCKET", DEFAULT, "ERROR: Can't determine maximum number of open sockets!");
+		printf("ERROR: Can't determine maximum number of open sockets!\n");
+		ServerInstance->Exit(EXIT_STATUS_SOCKETENGINE);
+	}
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_CQ_ENTRIES;
+
+	EngineHandle = syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params);
+	if (EngineHandle == -1)
+		Fatal("io_uring_setup");
+
+	if (!(params.features & IORING_FEAT_EXT_ARG))
+	{
+		errno = ENOSYS;
+		Fatal("io_uring_enter() timeouts are not supported");
+	}
+
+#ifdef IORING_FEAT_CQE_SKIP
+	if (params.features & IORING_FEAT_CQE_SKIP)
+		remove_flags = IOSQE_CQE_SKIP_SUCCESS;
+#endif
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cq_ring_size > sq_ring_size)
+			sq_ring_size = cq_ring_size;
+		cq_ring_size = sq_ring_size;
+	}
+
+	sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED)
+		Fatal("mmap");
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		cq_ring = sq_ring;
+	}
+	else
+	{
+		cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED)
+			Fatal("mmap");
+	}
+
+	sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqes = static_cast<struct io_uring_sqe*>(mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQES));
+	if (sqes == MAP_FAILED)
+		Fatal("mmap");
+
+	char* sq = static_cast<char*>(sq_ring);
+	sq_head = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+	sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+	sq_mask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+	char* cq = static_cast<char*>(cq_ring);
+	cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+	cq_mask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	events.resize(params.cq_entries);
+
+	ref = new EventHandler* [GetMaxFds()];
+	state = new PollState[GetMaxFds()];
+
+	memset(ref, 0, GetMaxFds() * sizeof(EventHandler*));
+	memset(state, 0, GetMaxFds() * sizeof(PollState));
+
+	multishot_ok = ProbeMultishot();
+	if (!multishot_ok)
+	{
+		ServerInstance->Logs->Log("SOCKET", DEFAULT, "WARNING: io_uring multishot polls are not supported; using one-shot polls");
+		printf("WARNING: io_uring multishot polls are not supported; using one-shot polls\n");
+	}
+}
+
+bool URingEngine::ProbeMultishot()
+{
+	// Multishot polls have no feature flag of their own, and kernels with
+	// backported io_uring features can't be told apart by the others.
+	int fds[2];
+	if (pipe(fds))
+		return false;
+
+	// the pipe is readable, so the poll completes as soon as it is submitted
+	bool supported = false;
+	__u64 data = MakeData(fds[0], 0);
+	if (write(fds[1], "x", 1) == 1)
+	{
+		struct io_uring_sqe* sqe = GetSQE();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fds[0];
+		sqe->poll32_events = POLLIN;
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->user_data = data;
+		Enter(1, 1000);
+
+		unsigned int head = *cq_head;
+		unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			const struct io_uring_cqe& cqe = cqes[head & cq_mask];
+			// kernels without them fail the request with -EINVAL
+			if (cqe.user_data == data)
+				supported = (cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE));
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	if (supported)
+	{
+		// the request is still armed; its cancellation is ignored like any other stale completion
+		struct io_uring_sqe* sqe = GetSQE();
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = data;
+		sqe->flags = remove_flags;
+		sqe->user_data = URING_REMOVE_TAG;
+		Enter(0, 0);
+	}
+	close(fds[0]);
+	close(fds[1]);
+	return supported;
+}
+
+URingEngine::~URingEngine()
+{
+	munmap(sqes, sqes_size);
+	if (cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	munmap(sq_ring, sq_ring_size);
+	this->Close(EngineHandle);
+	delete[] ref;
+	delete[] state;
+}
+
+int URingEngine::Enter(unsigned int min_complete, int timeout_ms)
+{
+	unsigned int flags = 0;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	if (min_complete)
+	{
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+		memset(&arg, 0, sizeof(arg));
+		arg.ts = reinterpret_cast<__u64>(&ts);
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	}
+
+	int rv;
+	do
+	{
+		EngineCalls++;
+		rv = syscall(__NR_io_uring_enter, EngineHandle, sq_pending, min_complete, flags,
+			min_complete ? &arg : NULL, min_complete ? sizeof(arg) : 0);
+	} while (rv < 0 && errno == EINTR && !min_complete);
+
+	if (rv >= 0)
+		sq_pending -= (unsigned int)rv > sq_pending ? sq_pending : rv;
+	else if (errno != ETIME && errno != EINTR)
+		ServerInstance->Logs->Log("SOCKET",DEBUG,"io_uring_enter failed: %s", strerror(errno));
+	return rv;
+}
+
+struct io_uring_sqe* URingEngine::GetSQE()
+{
+	unsigned int tail = *sq_tail;
+	if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > sq_mask)
+	{
+		// the queue is full; hand what we have to the kernel now
+		Enter(0, 0);
+	}
+
+	unsigned int index = tail & sq_mask;
+	struct io_uring_sqe* sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sq_array[index] = index;
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	sq_pending++;
+	return sqe;
+}
+
+void URingEngine::Arm(int fd, int event_mask)
+{
+	PollState& ps = state[fd];
+	ps.events = mask_to_poll(event_mask, multishot_ok, ps.multishot);
+	if (!ps.events)
+		return;
+
+	struct io_uring_sqe* sqe = GetSQE();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = ps.events;
+	sqe->len = ps.multishot ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data = MakeData(fd, ps.gen);
+}
+
+void URingEngine::Disarm(int fd)
+{
+	PollState& ps = state[fd];
+	if (ps.events)
+	{
+		struct io_uring_sqe* sqe = GetSQE();
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = MakeData(fd, ps.gen);
+		sqe->flags = remove_flags;
+		sqe->user_data = URING_REMOVE_TAG;
+		ps.events = 0;
+	}
+	// completions still in flight for the old request are now stale
+	ps.gen++;
+}
+
+bool URingEngine::AddFd(EventHandler* eh, int event_mask)
+{
+	int fd = eh->GetFd();
+	if ((fd < 0) || (fd > GetMaxFds() - 1))
+	{
+		ServerInstance->Logs->Log("SOCKET",DEBUG,"AddFd out of range: (fd: %d, max: %d)", fd, GetMaxFds());
+		return false;
+	}
+
+	if (ref[fd])
+	{
+		ServerInstance->Logs->Log("SOCKET",DEBUG,"Attempt to add duplicate fd: %d", fd);
+		return false;
+	}
+
+	state[fd].gen++;
+	Arm(fd, event_mask);
+
+	ServerInstance->Logs->Log("SOCKET",DEBUG,"New file descriptor: %d", fd);
+
+	ref[fd] = eh;
+	SocketEngine::SetEventMask(eh, event_mask);
+	CurrentSetSize++;
+	return true;
+}
+
+void URingEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
+{
+	int fd = eh->GetFd();
+	bool new_multishot;
+	int new_events = mask_to_poll(new_mask, multishot_ok, new_multishot);
+	PollState& ps = state[fd];
+	if (new_events != ps.events || (new_events && new_multishot != ps.multishot))
+	{
+		// queue the change; it reaches the kernel with the next wait
+		Disarm(fd);
+		Arm(fd, new_mask);
+	}
+}
+
+void URingEngine::DelFd(EventHandler* eh)
+{
+	int fd = eh->GetFd();
+	if ((fd < 0) || (fd > GetMaxFds() - 1))
+	{
+		ServerInstance->Logs->Log("SOCKET",DEBUG,"DelFd out of range: (fd: %d, max: %d)", fd, GetMaxFds());
+		return;
+	}
+
+	// The removal reaches the kernel with the next wait, like any other change.
+	// Until then the poll request holds a reference to the socket, so closing
+	// the fd only releases it once the ircd next waits for events.
+	// Completions for the old request are told apart from those for a new
+	// socket given the same fd by their generation.
+	Disarm(fd);
+
+	ref[fd] = NULL;
+
+	ServerInstance->Logs->Log("SOCKET",DEBUG,"Remove file descriptor: %d", fd);
+	CurrentSetSize--;
+}
+
+void URingEngine::Dispatch(EventHandler* eh, int revents)
+{
+	socklen_t codesize = sizeof(int);
+	int errcode;
+	int fd = eh->GetFd();
+
+	if (revents & POLLHUP)
+	{
+		ErrorEvents++;
+		eh->HandleEvent(EVENT_ERROR, 0);
+		return;
+	}
+	if (revents & POLLERR)
+	{
+		ErrorEvents++;
+		/* Get error number */
+		if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &codesize) < 0)
+			errcode = errno;
+		eh->HandleEvent(EVENT_ERROR, errcode);
+		return;
+	}
+	int mask = eh->GetEventMask();
+	if (revents & POLLIN)
+		mask &= ~FD_READ_WILL_BLOCK;
+	if (revents & POLLOUT)
+	{
+		mask &= ~FD_WRITE_WILL_BLOCK;
+		if (mask & FD_WANT_SINGLE_WRITE)
+		{
+			int nm = mask & ~FD_WANT_SINGLE_WRITE;
+			OnSetEvent(eh, mask, nm);
+			mask = nm;
+		}
+	}
+	SetEventMask(eh, mask);
+	if (revents & POLLIN)
+	{
+		ReadEvents++;
+		eh->HandleEvent(EVENT_READ);
+		if (eh != ref[fd])
+			// whoa! we got deleted, better not give out the write event
+			return;
+	}
+	if (revents & POLLOUT)
+	{
+		WriteEvents++;
+		eh->HandleEvent(EVENT_WRITE);
+	}
+}
+
+int URingEngine::DispatchEvents()
+{
+	// Submit every queued change and wait for events in a single system call,
+	// unless there are completions waiting already.
+	if (__atomic_load_n(cq_tail, __ATOMIC_ACQUIRE) == *cq_head)
+		Enter(1, ServerInstance->Timers->GetNextTimeout(1000));
+	else if (sq_pending)
+		Enter(0, 0);
+	WaitFinished();
+
+	// Copy the completions out, as handlers may add to the submission queue
+	unsigned int head = *cq_head;
+	unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	int i = 0;
+	while (head != tail && i < (int)events.size())
+		events[i++] = cqes[head++ & cq_mask];
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+	TotalEvents += i;
+
+	for (int j = 0; j < i; j++)
+	{
+		const struct io_uring_cqe& cqe = events[j];
+		if (cqe.user_data == URING_REMOVE_TAG)
+			continue;
+
+		int fd = (int)(cqe.user_data & 0xFFFFFFFF);
+		unsigned int gen = (unsigned int)(cqe.user_data >> 32);
+		EventHandler* eh = (fd >= 0 && fd < GetMaxFds()) ? ref[fd] : NULL;
+		if (!eh || state[fd].gen != gen)
+		{
+			// for a request which has since been replaced or removed
+			continue;
+		}
+
+		if (!(cqe.flags & IORING_CQE_F_MORE))
+		{
+			// This request is finished: either it was one-shot, or the
+			// kernel ended it. Either way, a new one is needed.
+			state[fd].events = 0;
+			state[fd].gen++;
+		}
+
+		if (cqe.res == -ECANCELED)
+		{
+			// the kernel ended a multishot request early; put it back
+			if (!state[fd].events)
+				Arm(fd, eh->GetEventMask());
+			continue;
+		}
+		if (cqe.res < 0)
+		{
+			// Putting the request back would fail the same way on every pass
+			// through the main loop, so the handler has to deal with it.
+			ServerInstance->Logs->Log("SOCKET",DEBUG,"Poll failed on fd %d: %s", fd, strerror(-cqe.res));
+			ErrorEvents++;
+			eh->HandleEvent(EVENT_ERROR, -cqe.res);
+			continue;
+		}
+
+		Dispatch(eh, cqe.res);
+
+		// One-shot (level triggered) requests must be put back if the
+		// handler is still registered and has not already done so.
+		if (ref[fd] == eh && !state[fd].events)
+			Arm(fd, eh->GetEventMask());
+	}
+
+	return i;
+}
+
+std::string URingEngine::GetName()
+{
+	return "io_uring-poll";
+}
+
+SocketEngine* CreateSocketEngine()
+{
+	return new URingEngine;
+}
@@ -174,6 +174,48 @@ void InspIRCd::DoStats(char statschar, User* user, string_list &results)
 			}
 		break;
 
+		/* stats M (time taken and output produced by each command) */
+		case 'M':
+			results.push_back(sn+" 249 "+user->nick+" :command calls bytes_out total mean p50 p99 max");
+			for (Commandtable::iterator i = this->Parser->cmdlist.begin(); i != this->Parser->cmdlist.end(); i++)
+			{
+				const Histogram& t = i->second->exec_time;
+				if (t.GetCount())
+				{
+					results.push_back(sn+" 249 "+user->nick+" :"+i->second->name+" "+ConvToStr(t.GetCount())+" "+ConvToStr(i->second->output_bytes)+" "+
+						Histogram::FormatTime(t.GetTotal())+" "+Histogram::FormatTime(t.GetMean())+" <"+Histogram::FormatTime(t.GetPercentile(50))+" <"+
+						Histogram::FormatTime(t.GetPercentile(99))+" "+Histogram::FormatTime(t.GetMax()));
+				}
+			}
+		break;
+
+		/* stats h (calls to each module hook and time spent in them) */
+		case 'h':
+		{
+#ifdef USE_HOOK_PROFILING
+			if (!HookProfiler::enabled)
+				results.push_back(sn+" 249 "+user->nick+" :Hook profiling is off; set <performance:profilehooks> to turn it on");
+			results.push_back(sn+" 249 "+user->nick+" :module hook calls total mean");
+			std::vector<std::string> module_names = this->Modules->GetAllModuleNames(0);
+			for (std::vector<std::string>::iterator i = module_names.begin(); i != module_names.end(); ++i)
+			{
+				Module::HookStats* hookstats = this->Modules->Find(*i)->hookstats;
+				if (!hookstats)
+					continue;
+				for (int hook = I_BEGIN + 1; hook < I_END; hook++)
+				{
+					if (!hookstats[hook].calls)
+						continue;
+					results.push_back(sn+" 249 "+user->nick+" :"+*i+" "+HookProfiler::GetName((Implementation)hook)+" "+ConvToStr(hookstats[hook].calls)+" "+
+						Histogram::FormatTime(hookstats[hook].usecs)+" "+Histogram::FormatTime(hookstats[hook].usecs / hookstats[hook].calls));
+				}
+			}
+#else
+			results.push_back(sn+" 249 "+user->nick+" :Hook profiling was not compiled in");
+#endif
+		}
+		break;
+
 		/* stats z (debug and memory info) */
 		case 'z':
 		{
@@ -181,6 +223,12 @@ void InspIRCd::DoStats(char statschar, User* user, string_list &results)
 			results.push_back(sn+" 249 "+user->nick+" :Channels: "+ConvToStr(this->chanlist->size()));
 			results.push_back(sn+" 249 "+user->nick+" :Commands: "+ConvToStr(this->Parser->cmdlist.size()));
 
+			MemoryReport memory;
+			memory.Collect();
+			for (std::vector<MemoryReport::Item>::iterator i = memory.items.begin(); i != memory.items.end(); ++i)
+				results.push_back(sn+" 249 "+user->nick+" :Memory used by "+i->name+": "+MemoryReport::FormatBytes(i->bytes)+" for "+ConvToStr(i->count)+(i->sampled ? " (estimated from a sample)" : ""));
+			results.push_back(sn+" 249 "+user->nick+" :Memory used in total: "+MemoryReport::FormatBytes(memory.GetTotal()));
+
 			if (!this->Config->WhoWasGroupSize == 0 && !this->Config->WhoWasMaxGroups == 0)
 			{
 				Module* whowas = Modules->Find("cmd_whowas.so");
@@ -258,6 +306,13 @@ void InspIRCd::DoStats(char statschar, User* user, string_list &results)
 			results.push_back(sn+" 249 "+user->nick+" :nick collisions "+ConvToStr(this->stats->statsCollisions));
 			results.push_back(sn+" 249 "+user->nick+" :dns requests "+ConvToStr(this->stats->statsDnsGood+this->stats->statsDnsBad)+" succeeded "+ConvToStr(this->stats->statsDnsGood)+" failed "+ConvToStr(this->stats->statsDnsBad));
 			results.push_back(sn+" 249 "+user->nick+" :connection count "+ConvToStr(this->stats->statsConnects));
+			results.push_back(sn+" 249 "+user->nick+" :registration time "+this->stats->statsRegTime.Summary());
+			std::vector<std::string> buckets = this->stats->statsRegTime.Buckets();
+			for (std::vector<std::string>::iterator i = buckets.begin(); i != buckets.end(); ++i)
+				results.push_back(sn+" 249 "+user->nick+" :registration time "+*i);
+			results.push_back(sn+" 249 "+user->nick+" :main loop pass "+this->stats->statsLoopBusy.Summary());
+			for (int phase = 0; phase < LOOP_PHASES; phase++)
+				results.push_back(sn+" 249 "+user->nick+" :main loop "+serverstats::GetLoopPhaseName((LoopPhase)phase)+" "+this->stats->statsLoopPhase[phase].Summary());
 			snprintf(buffer,MAXBUF," 249 %s :bytes sent %5.2fK recv %5.2fK",
 				user->nick.c_str(),this->stats->statsSent / 1024.0,this->stats->statsRecv / 1024.0);
 			results.push_back(sn+buffer);
@@ -0,0 +1,73 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* $Core */
+
+#include "inspircd.h"
+#include "stringpool.h"
+
+const std::string PooledString::empty_string;
+
+size_t PooledString::Hash::operator()(const std::string& s) const
+{
+	/* FNV-1a */
+	size_t hash = 2166136261UL;
+	for (std::string::const_iterator i = s.begin(); i != s.end(); ++i)
+		hash = (hash ^ (unsigned char)*i) * 16777619UL;
+	return hash;
+}
+
+PooledString::Pool& PooledString::GetPool()
+{
+	static Pool* pool = new Pool;
+	return *pool;
+}
+
+PooledString::Pool::value_type* PooledString::Acquire(const std::string& value)
+{
+	if (value.empty())
+		return NULL;
+
+	/* Entries of a node based hash map don't move, so pointers to them stay valid as it grows */
+	Pool& pool = GetPool();
+	Pool::iterator i = pool.find(value);
+	if (i == pool.end())
+		i = pool.insert(std::make_pair(value, 0UL)).first;
+	i->second++;
+	return &*i;
+}
+
+void PooledString::Release(Pool::value_type* e)
+{
+	if (e && !--e->second)
+	{
+		Pool& pool = GetPool();
+		Pool::iterator i = pool.find(e->first);
+		if (i != pool.end())
+			pool.erase(i);
+	}
+}
+
+size_t PooledString::GetPoolMemory()
+{
+	Pool& pool = GetPool();
+	size_t bytes = pool.bucket_count() * sizeof(void*);
+	for (Pool::const_iterator i = pool.begin(); i != pool.end(); ++i)
+		bytes += MemoryReport::NodeSize(sizeof(Pool::value_type)) + MemoryReport::StringSize(i->first);
+	return bytes;
+}
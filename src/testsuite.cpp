@@ -24,7 +24,13 @@
 #include "inspircd.h"
 #include "testsuite.h"
 #include "threadengine.h"
+#include "inspsocket.h"
+#include "xline.h"
+#include "modules/hash.h"
+#include "iothreads.h"
 #include <iostream>
+#include <poll.h>
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -49,6 +55,336 @@ class TestSuiteThread : public Thread
 	}
 };
 
+/** A socket which is never connected, used to exercise the recvq line splitting */
+class TestSuiteSocket : public StreamSocket
+{
+ public:
+	void Fill(const std::string& data)
+	{
+		recvq = data;
+		recvq_pos = 0;
+	}
+
+	/** Line splitting as it was done before recvq had a read cursor */
+	bool GetNextLineCopying(std::string& line)
+	{
+		std::string::size_type i = recvq.find('\n');
+		if (i == std::string::npos)
+			return false;
+		line = recvq.substr(0, i);
+		recvq = recvq.substr(i + 1);
+		return true;
+	}
+
+	void OnDataReady() { }
+	void OnError(BufferedSocketError) { }
+};
+
+/** One end of a socketpair which bounces a byte back to the other end every
+ * time it becomes readable, used to keep the socket engine busy
+ */
+class TestSuitePingPong : public EventHandler
+{
+ public:
+	unsigned long events;
+	/** If set, wait to be told the socket is writable before sending each reply, as a
+	 * socket whose send queue has backed up does. This changes the event mask twice per event.
+	 */
+	bool waitwrite;
+	std::string reply;
+
+	TestSuitePingPong(int newfd, bool wait) : events(0), waitwrite(wait)
+	{
+		this->SetFd(newfd);
+		ServerInstance->SE->NonBlocking(newfd);
+	}
+
+	void HandleEvent(EventType et, int errornum)
+	{
+		char buf[64];
+		if (et == EVENT_WRITE && !reply.empty())
+		{
+			ServerInstance->SE->Send(this, reply.data(), reply.length(), 0);
+			reply.clear();
+		}
+		if (et != EVENT_READ)
+			return;
+		int n = ServerInstance->SE->Recv(this, buf, sizeof(buf), 0);
+		if (n > 0)
+		{
+			events++;
+			if (waitwrite)
+			{
+				reply.assign(buf, n);
+				ServerInstance->SE->ChangeEventMask(this, FD_WANT_SINGLE_WRITE);
+			}
+			else
+				ServerInstance->SE->Send(this, buf, n, 0);
+		}
+	}
+};
+
+/** A timer which counts how often, and how late, it has ticked */
+class TestSuiteTimer : public Timer
+{
+ public:
+	static unsigned long ticks;
+	static unsigned long late;
+
+	TestSuiteTimer(long secs_from_now, time_t now) : Timer(secs_from_now, now)
+	{
+	}
+
+	void Tick(time_t TIME)
+	{
+		ticks++;
+		if (TIME != GetTimer() + 1)
+			late++;
+	}
+};
+
+unsigned long TestSuiteTimer::ticks = 0;
+unsigned long TestSuiteTimer::late = 0;
+
+/** A millisecond timer which counts how often, and how late, it has ticked */
+class TestSuiteMSTimer : public Timer
+{
+	unsigned long expected;
+ public:
+	static unsigned long now;
+	static unsigned long ticks;
+	static unsigned long late;
+
+	TestSuiteMSTimer(unsigned long msecs_from_now, const timespec& start) : Timer(msecs_from_now, start), expected(msecs_from_now)
+	{
+	}
+
+	void Tick(time_t TIME)
+	{
+		ticks++;
+		if (now != expected)
+			late++;
+	}
+};
+
+unsigned long TestSuiteMSTimer::now = 0;
+unsigned long TestSuiteMSTimer::ticks = 0;
+unsigned long TestSuiteMSTimer::late = 0;
+
+/** Reads from a pipe slowly until it is closed, standing in for a slow disk */
+class TestSuiteSlowReader : public Thread
+{
+	int fd;
+ public:
+	unsigned long bytes;
+
+	TestSuiteSlowReader(int readfd) : fd(readfd), bytes(0)
+	{
+	}
+
+	void Run()
+	{
+		char buf[4096];
+		int n;
+		while ((n = read(fd, buf, sizeof(buf))) > 0)
+		{
+			bytes += n;
+			usleep(1000);
+		}
+	}
+};
+
+/** Get a monotonic time in seconds, for benchmarking */
+static double BenchmarkTime()
+{
+#ifdef HAS_CLOCK_GETTIME
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#else
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+/** Find a plaintext client port for benchmark clients to connect to
+ * @param target Set to the address to connect to
+ * @return The listener, or NULL if no plaintext client port is bound
+ */
+static ListenSocket* FindClientPort(irc::sockets::sockaddrs& target)
+{
+	for (std::vector<ListenSocket*>::iterator i = ServerInstance->ports.begin(); i != ServerInstance->ports.end(); ++i)
+	{
+		ListenSocket* listener = *i;
+		if (listener->bind_tag->getString("type", "clients") == "clients" && listener->bind_tag->getString("ssl").empty())
+		{
+			irc::sockets::aptosa(listener->bind_addr.empty() || listener->bind_addr == "*" || listener->bind_addr == "0.0.0.0" ? "127.0.0.1" :
+				listener->bind_addr == "::" ? "::1" : listener->bind_addr, listener->bind_port, target);
+			return listener;
+		}
+	}
+	cout << "No plaintext client port is bound\n";
+	return NULL;
+}
+
+/** Run one pass of the main loop, as far as benchmark clients need it to */
+static void RunMainLoopOnce()
+{
+	ServerInstance->UpdateTime();
+	ServerInstance->Timers->TickTimers(ServerInstance->Time_ts());
+	ServerInstance->Users->DoReadyChecks();
+	if (ServerInstance->IOThreads)
+		ServerInstance->IOThreads->Flush();
+	ServerInstance->SE->DispatchTrialWrites();
+	ServerInstance->SE->DispatchEvents();
+	ServerInstance->GlobalCulls.Apply();
+}
+
+/** Connect a client to the ircd and register it
+ * @param target The address of a client port
+ * @param nick The nick to register with
+ * @param fd Set to the client end of the connection
+ * @return The registered user, or NULL if it did not register within five seconds
+ */
+static LocalUser* ConnectBenchmarkUser(const irc::sockets::sockaddrs& target, const std::string& nick, int& fd)
+{
+	fd = socket(target.sa.sa_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		return NULL;
+	std::string reg = "NICK " + nick + "\r\nUSER " + nick + " * * :Benchmark client\r\n";
+	if (connect(fd, &target.sa, target.sa_size()) || write(fd, reg.data(), reg.length()) != (ssize_t)reg.length())
+	{
+		close(fd);
+		fd = -1;
+		return NULL;
+	}
+	ServerInstance->SE->NonBlocking(fd);
+
+	double deadline = BenchmarkTime() + 5;
+	while (BenchmarkTime() < deadline)
+	{
+		RunMainLoopOnce();
+		User* found = ServerInstance->FindNick(nick);
+		LocalUser* user = found ? IS_LOCAL(found) : NULL;
+		if (user && user->registered == REG_ALL)
+			return user;
+	}
+	cout << "Benchmark client " << nick << " did not register\n";
+	return NULL;
+}
+
+/** Get the CPU time used by the calling thread, in seconds */
+static double ThreadCPUTime()
+{
+	rusage ru;
+#ifdef RUSAGE_THREAD
+	getrusage(RUSAGE_THREAD, &ru);
+#else
+	getrusage(RUSAGE_SELF, &ru);
+#endif
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+/** The client end of the I/O thread benchmark. Every client pastes PINGs in
+ * batches, sending the next batch once every PONG for the last one is back,
+ * and keeps everything the server sends it.
+ */
+class TestSuiteIOClients : public Thread
+{
+ public:
+	struct Client
+	{
+		int fd;
+		unsigned int sent;
+		unsigned int received;
+		std::string out;
+		std::string in;
+		std::string::size_type parsed;
+	};
+	std::vector<Client> clients;
+	const unsigned int lines;
+	const unsigned int batch;
+	/** Wall clock time taken to get every reply back */
+	double elapsed;
+	volatile bool done;
+	volatile bool failed;
+
+	TestSuiteIOClients(unsigned int count, unsigned int perbatch) : lines(count), batch(perbatch), elapsed(0), done(false), failed(false)
+	{
+	}
+
+	void Add(int fd)
+	{
+		clients.push_back(Client());
+		clients.back().fd = fd;
+		clients.back().sent = clients.back().received = 0;
+		clients.back().parsed = 0;
+	}
+
+	void Run()
+	{
+		std::vector<pollfd> pfds(clients.size());
+		double start = BenchmarkTime();
+		double deadline = start + 60;
+		while (!GetExitFlag() && BenchmarkTime() < deadline)
+		{
+			bool finished = true;
+			for (size_t i = 0; i < clients.size(); i++)
+			{
+				Client& c = clients[i];
+				if (c.out.empty() && c.received == c.sent && c.sent < lines)
+				{
+					for (unsigned int n = 0; n < batch && c.sent < lines; n++)
+						c.out.append("PING :" + ConvToStr(i) + "-" + ConvToStr(c.sent++) + "\r\n");
+				}
+				if (c.received < lines)
+					finished = false;
+				pfds[i].fd = c.fd;
+				pfds[i].events = POLLIN | (c.out.empty() ? 0 : POLLOUT);
+				pfds[i].revents = 0;
+			}
+			if (finished)
+				break;
+			if (poll(&pfds[0], pfds.size(), 100) <= 0)
+				continue;
+
+			for (size_t i = 0; i < clients.size(); i++)
+			{
+				Client& c = clients[i];
+				if (pfds[i].revents & POLLOUT)
+				{
+					int n = send(c.fd, c.out.data(), c.out.length(), 0);
+					if (n > 0)
+						c.out.erase(0, n);
+				}
+				if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				{
+					char buf[65536];
+					int n = recv(c.fd, buf, sizeof(buf), 0);
+					if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+					{
+						failed = true;
+						break;
+					}
+					if (n < 0)
+						continue;
+					c.in.append(buf, n);
+					for (std::string::size_type eol; (eol = c.in.find('\n', c.parsed)) != std::string::npos; c.parsed = eol + 1)
+					{
+						if (c.in.find(" PONG ", c.parsed) < eol)
+							c.received++;
+					}
+				}
+			}
+			if (failed)
+				break;
+		}
+		elapsed = BenchmarkTime() - start;
+		done = true;
+	}
+};
+
 TestSuite::TestSuite()
 {
 	cout << "\n\n*** STARTING TESTSUITE ***\n";
@@ -65,6 +401,19 @@ TestSuite::TestSuite()
 		cout << "(5) Wildcard and CIDR tests\n";
 		cout << "(6) Comma sepstream tests\n";
 		cout << "(7) Space sepstream tests\n";
+		cout << "(8) Receive queue line splitting benchmark\n";
+		cout << "(9) Socket engine throughput benchmark\n";
+		cout << "(A) Accept rate benchmark\n";
+		cout << "(B) Timer add and cancel benchmark\n";
+		cout << "(C) Log writer main loop latency benchmark\n";
+		cout << "(D) Core primitive microbenchmarks\n";
+		cout << "(E) Nick and channel hash table benchmarks\n";
+		cout << "(F) Channel membership benchmarks\n";
+		cout << "(G) I/O thread benchmark\n";
+		cout << "(H) Case mapping tests\n";
+		cout << "(I) Pooled string tests\n";
+		cout << "(J) Ban cache tests\n";
+		cout << "(K) Extension slot tests\n";
 
 		cout << endl << "(X) Exit test suite\n";
 
@@ -105,6 +454,45 @@ TestSuite::TestSuite()
 			case '7':
 				cout << (DoSpaceSepStreamTests() ? "\nSUCCESS!\n" : "\nFAILURE\n");
 				break;
+			case '8':
+				cout << (DoRecvQBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case '9':
+				cout << (DoSocketEngineBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'A':
+				cout << (DoAcceptBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'B':
+				cout << (DoTimerBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'C':
+				cout << (DoLogWriterBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'D':
+				cout << (DoMicroBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'E':
+				cout << (DoHashTableBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'F':
+				cout << (DoMembershipBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'G':
+				cout << (DoIOThreadBenchmarks() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'H':
+				cout << (DoCaseMapTests() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'I':
+				cout << (DoPooledStringTests() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'J':
+				cout << (DoBanCacheTests() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
+			case 'K':
+				cout << (DoExtensionSlotTests() ? "\nSUCCESS!\n" : "\nFAILURE\n");
+				break;
 			case 'X':
 				return;
 				break;
@@ -126,6 +514,16 @@ TestSuite::TestSuite()
 /* Test that x does not match y with match() and cidr enabled */
 #define CIDRTESTNOT(x, y) cout << "!match(\"" << x << "\",\"" << y "\", true) " << ((passed = ((!InspIRCd::MatchCIDR(x, y, NULL)))) ? " SUCCESS!\n" : " FAILURE\n")
 
+/* Test that a compiled pattern gives the same answer as match() */
+#define PATTERNTEST(x, y) cout << "pattern(\"" << x << "\",\"" << y "\") " << ((passed = (CompiledMatch(x, y) == InspIRCd::Match(x, y, NULL))) ? " SUCCESS!\n" : " FAILURE\n")
+
+static bool CompiledMatch(const std::string& str, const std::string& mask)
+{
+	MatchPattern pattern;
+	pattern.Compile(mask);
+	return pattern.Match(str, national_case_insensitive_map);
+}
+
 bool TestSuite::DoWildTests()
 {
 	cout << "\n\nWildcard and CIDR tests\n\n";
@@ -195,6 +593,23 @@ bool TestSuite::DoWildTests()
 	CIDRTESTNOT("brain@1.2.3.4", "@");
 	CIDRTESTNOT("brain@1.2.3.4", "");
 
+	PATTERNTEST("foobar", "*");
+	PATTERNTEST("foobar", "***");
+	PATTERNTEST("FooBar", "foobar");
+	PATTERNTEST("foobar", "fooba");
+	PATTERNTEST("foobar", "foo*");
+	PATTERNTEST("fo", "foo*");
+	PATTERNTEST("foo", "foo*");
+	PATTERNTEST("foobar", "*BAR");
+	PATTERNTEST("ar", "*bar");
+	PATTERNTEST("foobar", "*foo");
+	PATTERNTEST("foobar", "f*r");
+	PATTERNTEST("foobar", "foo?ar");
+	PATTERNTEST("foobar", "?*");
+	PATTERNTEST("", "");
+	PATTERNTEST("", "*");
+	PATTERNTEST("", "foo*");
+
 	return true;
 }
 
@@ -275,6 +690,1134 @@ bool TestSuite::DoSpaceSepStreamTests()
 	return true;
 }
 
+/* Check that op gives the expected result */
+#define TESTCHECK(op, expected) if ((op) != (expected)) { cout << "FAILURE: " #op " != " #expected "\n"; passed = false; }
+
+/** Make a remote user which is not on any server's user list, for tests to check against */
+static RemoteUser* MakeTestUser()
+{
+	RemoteUser* user = new RemoteUser(ServerInstance->GetUID(), ServerInstance->Config->ServerName);
+	user->nick = "nick";
+	user->ident = "ident";
+	user->host = "host-192-0-2-10.example.net";
+	user->dhost = "cloaked.example.net";
+	irc::sockets::aptosa("192.0.2.10", 0, user->client_sa);
+	user->InvalidateCache();
+	return user;
+}
+
+/** Destroy a user made by MakeTestUser */
+static void DeleteTestUser(RemoteUser* user)
+{
+	user->quitting = true;
+	ServerInstance->Users->uuidlist->erase(user->uuid);
+	user->client_sa.sa.sa_family = AF_UNSPEC;
+	user->cull();
+	delete user;
+}
+
+/** Destroy a channel made by a test, which must have no members */
+static void DeleteTestChannel(Channel* chan)
+{
+	ServerInstance->chanlist->erase(chan->name);
+	chan->cull();
+	delete chan;
+}
+
+bool TestSuite::DoCaseMapTests()
+{
+	cout << "\n\nCase mapping tests\n\n";
+	bool passed = true;
+
+	/* The rfc1459 map is folded without looking bytes up; a copy of it has to be looked up,
+	 * as a map loaded by m_nationalchars would be, and must give the same results.
+	 */
+	const std::string channel = "#Some-Channel[With]A\\Much^Longer_Name";
+	const std::string lowerchannel = "#some-channel{with}a|much^longer_name";
+	unsigned char tablemap[256];
+	memcpy(tablemap, rfc_case_insensitive_map, sizeof(tablemap));
+	const unsigned char* oldmap = national_case_insensitive_map;
+	for (unsigned int len = 0; len <= channel.length(); len++)
+	{
+		std::string upper(channel, 0, len);
+		std::string lower(lowerchannel, 0, len);
+		std::string other(upper);
+		if (len)
+			other[len - 1] = '~';
+		for (unsigned int table = 0; table < 2; table++)
+		{
+			national_case_insensitive_map = table ? tablemap : rfc_case_insensitive_map;
+			TESTCHECK(irc::StrHash()(upper), irc::StrHash()(lower));
+			TESTCHECK(irc::StrHashComp()(upper, lower), true);
+			TESTCHECK(irc::StrHashComp()(upper, other), len == 0);
+			TESTCHECK(irc::string(upper.c_str()) == irc::string(lower.c_str()), true);
+			TESTCHECK(irc::string(other.c_str()) < irc::string(upper.c_str()), false);
+		}
+		national_case_insensitive_map = oldmap;
+		TESTCHECK(irc::StrHash()(upper), irc::hash()(irc::string(lower.c_str())));
+	}
+
+	return passed;
+}
+
+bool TestSuite::DoPooledStringTests()
+{
+	cout << "\n\nPooled string tests\n\n";
+	bool passed = true;
+
+	/* Pooled strings share one copy of each value and compare by pointer */
+	size_t poolsize = PooledString::GetPoolSize();
+	{
+		const std::string servername = "services.test.example.net";
+		PooledString first(servername);
+		PooledString second(servername);
+		PooledString other("other.test.example.net");
+		TESTCHECK(PooledString::GetPoolSize(), poolsize + 2);
+		TESTCHECK(first == second, true);
+		TESTCHECK(first == other, false);
+		TESTCHECK(first == servername, true);
+		TESTCHECK(first.c_str() == second.c_str(), true);
+		other = first;
+		TESTCHECK(PooledString::GetPoolSize(), poolsize + 1);
+		TESTCHECK(PooledString().empty(), true);
+
+		/* The pool must not depend on the casemap, which m_nationalchars swaps at run time */
+		const unsigned char* oldmap = national_case_insensitive_map;
+		national_case_insensitive_map = ascii_case_insensitive_map;
+		{
+			PooledString third(servername);
+			TESTCHECK(third == first, true);
+			TESTCHECK(PooledString::GetPoolSize(), poolsize + 1);
+		}
+		national_case_insensitive_map = oldmap;
+		TESTCHECK(PooledString::GetPoolSize(), poolsize + 1);
+	}
+	TESTCHECK(PooledString::GetPoolSize(), poolsize);
+
+	return passed;
+}
+
+bool TestSuite::DoBanCacheTests()
+{
+	cout << "\n\nBan cache tests\n\n";
+	bool passed = true;
+
+	/* A long ban list, mostly hosts with a few ranges and wildcards, added directly as it is over the +b limit */
+	Channel* chan = new Channel("#bantest", ServerInstance->Time());
+	BanItem ban;
+	for (unsigned int i = 0; i < 500; i++)
+	{
+		if (i % 10 == 0)
+			ban.data = "*!*@*.domain" + ConvToStr(i) + ".example.com";
+		else if (i % 10 == 1)
+			ban.data = "*!*@10." + ConvToStr(i / 256) + "." + ConvToStr(i % 256) + ".0/24";
+		else
+			ban.data = "*!*@host" + ConvToStr(i) + ".example.org";
+		ban.mask.Compile(ban.data);
+		chan->bans.push_back(ban);
+	}
+	chan->BanListChanged();
+
+	RemoteUser* user = MakeTestUser();
+	TESTCHECK(chan->IsBanned(user), false);
+
+	/* Members keep the answer until the ban list or their nick, ident or host changes */
+	Membership* memb = chan->AddUser(user);
+	TESTCHECK(chan->IsBanned(user), false);
+	ban.data = "*!*@192.0.2.0/24";
+	ban.mask.Compile(ban.data);
+	chan->bans.push_back(ban);
+	chan->BanListChanged();
+	TESTCHECK(chan->IsBanned(user), true);
+	chan->bans.pop_back();
+	chan->BanListChanged();
+	TESTCHECK(chan->IsBanned(user), false);
+	user->host = "host77.example.org";
+	user->InvalidateCache();
+	TESTCHECK(chan->IsBanned(user), true);
+	user->host = "host-192-0-2-10.example.net";
+	user->InvalidateCache();
+	TESTCHECK(chan->IsBanned(user), false);
+	chan->userlist.erase(user);
+	memb->cull();
+	delete memb;
+
+	DeleteTestUser(user);
+	DeleteTestChannel(chan);
+	return passed;
+}
+
+bool TestSuite::DoExtensionSlotTests()
+{
+	cout << "\n\nExtension slot tests\n\n";
+	bool passed = true;
+
+	/* Items not registered get a slot when first set, so these come after those of the
+	 * core and of any loaded modules.
+	 */
+	RemoteUser* user = MakeTestUser();
+	const size_t extcount = user->GetExtList().size();
+	std::vector<LocalIntExt*> extitems;
+	for (unsigned int i = 0; i < 32; i++)
+	{
+		extitems.push_back(new LocalIntExt("slottest" + ConvToStr(i), NULL));
+		extitems[i]->set(user, i + 1);
+	}
+	TESTCHECK(extitems[31]->get(user), (intptr_t)32);
+	TESTCHECK(user->GetExtList().size(), extcount + 32);
+	extitems[31]->set(user, 0);
+	TESTCHECK(extitems[31]->get(user), (intptr_t)0);
+	TESTCHECK(extitems[30]->get(user), (intptr_t)31);
+
+	/* Unloading a module takes its items' values off every object, then frees their slots for reuse */
+	std::vector<reference<ExtensionItem> > unhook(extitems.begin(), extitems.begin() + 16);
+	user->doUnhookExtensions(unhook);
+	unhook.clear();
+	TESTCHECK(extitems[0]->get(user), (intptr_t)0);
+	TESTCHECK(extitems[16]->get(user), (intptr_t)17);
+	TESTCHECK(user->GetExtList().size(), extcount + 15);
+	const size_t extslot = extitems[3]->slot;
+	for (unsigned int i = 0; i < 16; i++)
+		delete extitems[i];
+	LocalIntExt reused("slottest", NULL);
+	TESTCHECK(reused.get(user), (intptr_t)0);
+	reused.set(user, 1);
+	TESTCHECK(reused.slot <= extslot, true);
+	TESTCHECK(ServerInstance->Extensions.GetSlotItem(reused.slot), (ExtensionItem*)&reused);
+	reused.set(user, 0);
+	for (unsigned int i = 16; i < 32; i++)
+		extitems[i]->set(user, 0);
+	TESTCHECK(user->GetExtList().size(), extcount);
+	for (unsigned int i = 16; i < 32; i++)
+		delete extitems[i];
+
+	DeleteTestUser(user);
+	return passed;
+}
+
+bool TestSuite::DoRecvQBenchmarks()
+{
+	cout << "\n\nReceive queue line splitting benchmark\n\n";
+
+	/* Each batch is what a client pasting lines into a single recv() hands us */
+	static const unsigned int linecounts[] = { 1, 50, 500 };
+	static const unsigned int totallines = 2000000;
+	bool passed = true;
+
+	for (unsigned int n = 0; n < sizeof(linecounts) / sizeof(linecounts[0]); n++)
+	{
+		unsigned int perbatch = linecounts[n];
+		std::string batch;
+		for (unsigned int i = 0; i < perbatch; i++)
+			batch.append("PRIVMSG #channel :the quick brown fox jumps over the lazy dog " + ConvToStr(i) + "\r\n");
+
+		TestSuiteSocket sock;
+		std::string line;
+		unsigned int batches = totallines / perbatch;
+
+		for (int method = 0; method < 2; method++)
+		{
+			unsigned long lines = 0;
+			double start = BenchmarkTime();
+			for (unsigned int b = 0; b < batches; b++)
+			{
+				sock.Fill(batch);
+				if (method)
+				{
+					while (sock.GetNextLine(line))
+						lines++;
+				}
+				else
+				{
+					while (sock.GetNextLineCopying(line))
+						lines++;
+				}
+			}
+			double elapsed = BenchmarkTime() - start;
+			if (elapsed <= 0)
+				elapsed = 1e-9;
+
+			if (lines != (unsigned long)batches * perbatch)
+				passed = false;
+
+			cout << (method ? "cursor " : "copying") << " lines/batch=" << perbatch
+				<< " lines/sec=" << (unsigned long)(lines / elapsed)
+				<< " bytes/sec=" << (unsigned long)(batch.length() * (double)batches / elapsed) << "\n";
+		}
+	}
+
+	/* Client input is split by UserIOHandler::OnDataReady rather than GetNextLine. A registered
+	 * client's PONGs are parsed and dispatched without a reply or a flood penalty, so a paste of
+	 * them is processed in full.
+	 */
+	irc::sockets::sockaddrs target;
+	int fd = -1;
+	LocalUser* user = FindClientPort(target) ? ConnectBenchmarkUser(target, "RecvQBench", fd) : NULL;
+	if (!user)
+	{
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+
+	static const unsigned int pastes[] = { 1, 50 };
+	static const unsigned int userlines = 500000;
+	for (unsigned int n = 0; n < sizeof(pastes) / sizeof(pastes[0]); n++)
+	{
+		unsigned int perpaste = pastes[n];
+		std::string paste;
+		for (unsigned int i = 0; i < perpaste; i++)
+			paste.append("PONG :the quick brown fox jumps over the lazy dog " + ConvToStr(i) + "\r\n");
+
+		unsigned int count = userlines / perpaste;
+		unsigned long before = user->cmds_in;
+		double start = BenchmarkTime();
+		for (unsigned int p = 0; p < count; p++)
+			user->eh.OnThreadData(paste);
+		double elapsed = BenchmarkTime() - start;
+		if (elapsed <= 0)
+			elapsed = 1e-9;
+
+		if (user->cmds_in - before != (unsigned long)count * perpaste || user->eh.getRecvQSize() || user->quitting)
+			passed = false;
+
+		cout << "OnDataReady lines/paste=" << perpaste
+			<< " lines/sec=" << (unsigned long)(count * perpaste / elapsed)
+			<< " bytes/sec=" << (unsigned long)(paste.length() * (double)count / elapsed) << "\n";
+	}
+
+	ServerInstance->Users->QuitUser(user, "Benchmark over");
+	ServerInstance->GlobalCulls.Apply();
+	close(fd);
+
+	return passed;
+}
+
+bool TestSuite::DoSocketEngineBenchmarks()
+{
+	cout << "\n\nSocket engine throughput benchmark (" << ServerInstance->SE->GetName() << ")\n\n";
+
+	/* Every pair has one byte in flight, so each dispatch round handles one event per pair.
+	 * System calls are those the engine makes itself, to wait for events or to change which
+	 * events it waits for; the reads and writes are the same whichever engine is in use.
+	 * Configure with and without --enable-uring to compare io_uring against epoll.
+	 */
+	static const unsigned int paircounts[] = { 10, 100, 400 };
+	static const int masks[] = { FD_WANT_FAST_READ | FD_WANT_EDGE_WRITE, FD_WANT_POLL_READ | FD_WANT_NO_WRITE, FD_WANT_FAST_READ | FD_WANT_EDGE_WRITE };
+	static const char* const modes[] = { "edge ", "level", "write" };
+	static const double duration = 2.0;
+	bool passed = true;
+
+	for (unsigned int n = 0; n < sizeof(paircounts) / sizeof(paircounts[0]); n++)
+	{
+		for (unsigned int m = 0; m < sizeof(masks) / sizeof(masks[0]); m++)
+		{
+			std::vector<TestSuitePingPong*> ends;
+			for (unsigned int i = 0; i < paircounts[n]; i++)
+			{
+				int fds[2];
+				if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+				{
+					cout << "socketpair() failed: " << strerror(errno) << "\n";
+					passed = false;
+					break;
+				}
+				for (int j = 0; j < 2; j++)
+				{
+					TestSuitePingPong* end = new TestSuitePingPong(fds[j], m == 2);
+					ends.push_back(end);
+					if (!ServerInstance->SE->AddFd(end, masks[m]))
+						passed = false;
+				}
+				ServerInstance->SE->Send(ends.back(), "x", 1, 0);
+			}
+
+			unsigned long rounds = 0;
+			unsigned long calls = ServerInstance->SE->EngineCalls;
+			double start = BenchmarkTime();
+			double elapsed;
+			do
+			{
+				ServerInstance->SE->DispatchEvents();
+				rounds++;
+				elapsed = BenchmarkTime() - start;
+			} while (elapsed < duration);
+			calls = ServerInstance->SE->EngineCalls - calls;
+
+			unsigned long events = 0;
+			for (std::vector<TestSuitePingPong*>::iterator i = ends.begin(); i != ends.end(); ++i)
+			{
+				events += (*i)->events;
+				ServerInstance->SE->DelFd(*i);
+				ServerInstance->SE->Close(*i);
+				delete *i;
+			}
+
+			/* Every byte must still be bouncing, or the engine lost an event */
+			if (events < rounds)
+				passed = false;
+
+			cout << modes[m] << " pairs=" << paircounts[n]
+				<< " events/sec=" << (unsigned long)(events / elapsed)
+				<< " dispatches/sec=" << (unsigned long)(rounds / elapsed)
+				<< " syscalls/event=" << (events ? (double)calls / events : 0) << "\n";
+		}
+	}
+
+	return passed;
+}
+
+bool TestSuite::DoAcceptBenchmarks()
+{
+	cout << "\n\nAccept rate benchmark\n\n";
+
+	irc::sockets::sockaddrs target;
+	ListenSocket* listener = FindClientPort(target);
+	if (!listener)
+		return false;
+
+	/* A reconnect storm: every client connects before the ircd gets to run.
+	 * This must stay below the listen backlog, or the kernel starts dropping
+	 * connections and the benchmark measures SYN retransmits instead.
+	 */
+	static const int batches[] = { 1, 4, 16, 64 };
+	const unsigned int storm = std::min(100, ServerInstance->Config->MaxConn - 1);
+	static const int rounds = 5;
+	int oldbatch = listener->accept_batch;
+	bool passed = true;
+
+	for (unsigned int b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+	{
+		listener->accept_batch = batches[b];
+		unsigned long accepted = 0;
+		unsigned long dispatches = 0;
+		double elapsed = 0;
+
+		for (int r = 0; r < rounds; r++)
+		{
+			std::vector<int> clients;
+			for (unsigned int i = 0; i < storm; i++)
+			{
+				int fd = socket(target.sa.sa_family, SOCK_STREAM, 0);
+				if (fd < 0)
+					break;
+				ServerInstance->SE->NonBlocking(fd);
+				connect(fd, &target.sa, target.sa_size());
+				clients.push_back(fd);
+			}
+
+			size_t before = ServerInstance->Users->local_users.size();
+			double start = BenchmarkTime();
+			double deadline = start + 5;
+			while (ServerInstance->Users->local_users.size() - before < clients.size() && BenchmarkTime() < deadline)
+			{
+				ServerInstance->SE->DispatchEvents();
+				dispatches++;
+			}
+			elapsed += BenchmarkTime() - start;
+
+			size_t now = ServerInstance->Users->local_users.size();
+			accepted += now - before;
+			if (now - before != clients.size())
+				passed = false;
+
+			std::vector<LocalUser*> added(ServerInstance->Users->local_users.begin() + before, ServerInstance->Users->local_users.end());
+			for (std::vector<LocalUser*>::iterator i = added.begin(); i != added.end(); ++i)
+				ServerInstance->Users->QuitUser(*i, "Benchmark over");
+			ServerInstance->GlobalCulls.Apply();
+			for (std::vector<int>::iterator i = clients.begin(); i != clients.end(); ++i)
+				close(*i);
+		}
+
+		if (elapsed <= 0)
+			elapsed = 1e-9;
+		cout << "acceptbatch=" << batches[b] << " storm=" << storm
+			<< " accepts/sec=" << (unsigned long)(accepted / elapsed)
+			<< " dispatches/storm=" << dispatches / rounds << "\n";
+	}
+
+	listener->accept_batch = oldbatch;
+	return passed;
+}
+
+bool TestSuite::DoTimerBenchmarks()
+{
+	cout << "\n\nTimer add and cancel benchmark\n\n";
+
+	static const unsigned int count = 1000000;
+	/* Spread over ten minutes, which is more than one turn of the wheel */
+	static const long spread = 600;
+	bool passed = true;
+
+	std::vector<Timer*> timers(count);
+	TimerManager manager;
+	time_t now = ServerInstance->Time();
+	manager.TickTimers(now);
+
+	for (unsigned int i = 0; i < count; i++)
+		timers[i] = new TestSuiteTimer(1 + (i * 7) % spread, now);
+	double start = BenchmarkTime();
+	for (unsigned int i = 0; i < count; i++)
+		manager.AddTimer(timers[i]);
+	double added = BenchmarkTime();
+	if (manager.GetTimerCount() != count)
+		passed = false;
+	/* Cancel in a different order to the one they were added in */
+	for (unsigned int i = 0; i < count; i++)
+		manager.DelTimer(timers[(i * 7) % count]);
+	double cancelled = BenchmarkTime();
+	if (manager.GetTimerCount() != 0)
+		passed = false;
+
+	cout << "timers=" << count << " add ns/op=" << (unsigned long)((added - start) * 1000000000.0 / count)
+		<< " cancel ns/op=" << (unsigned long)((cancelled - added) * 1000000000.0 / count) << "\n";
+
+	/* Now let them all fire, ticking once a second as the main loop does */
+	TestSuiteTimer::ticks = TestSuiteTimer::late = 0;
+	for (unsigned int i = 0; i < count; i++)
+		manager.AddTimer(new TestSuiteTimer(1 + (i * 7) % spread, now));
+	start = BenchmarkTime();
+	for (long i = 1; i <= spread + 1; i++)
+		manager.TickTimers(now + i);
+	double elapsed = BenchmarkTime() - start;
+	if (TestSuiteTimer::ticks != count || TestSuiteTimer::late != 0 || manager.GetTimerCount() != 0)
+		passed = false;
+
+	cout << "timers=" << count << " ticks=" << spread + 1 << " fired=" << TestSuiteTimer::ticks
+		<< " late=" << TestSuiteTimer::late << " fire ns/op=" << (unsigned long)(elapsed * 1000000000.0 / count) << "\n";
+
+	/* Millisecond timers, spread over more than one turn of the wheel and
+	 * ticked every millisecond
+	 */
+	static const unsigned long msspread = 10000;
+	TestSuiteMSTimer::ticks = TestSuiteMSTimer::late = 0;
+	TimerManager msmanager;
+	timespec ts;
+	ts.tv_sec = now;
+	ts.tv_nsec = 0;
+	msmanager.TickTimers(ts);
+	for (unsigned int i = 0; i < count; i++)
+		msmanager.AddTimer(new TestSuiteMSTimer(1 + (i * 7) % msspread, ts));
+	start = BenchmarkTime();
+	for (unsigned long i = 1; i <= msspread; i++)
+	{
+		ts.tv_sec = now + i / 1000;
+		ts.tv_nsec = (i % 1000) * 1000000;
+		TestSuiteMSTimer::now = i;
+		msmanager.TickTimers(ts);
+	}
+	elapsed = BenchmarkTime() - start;
+	if (TestSuiteMSTimer::ticks != count || TestSuiteMSTimer::late != 0 || msmanager.GetTimerCount() != 0)
+		passed = false;
+
+	cout << "mstimers=" << count << " ticks=" << msspread << " fired=" << TestSuiteMSTimer::ticks
+		<< " late=" << TestSuiteMSTimer::late << " fire ns/op=" << (unsigned long)(elapsed * 1000000000.0 / count) << "\n";
+
+	return passed;
+}
+
+bool TestSuite::DoLogWriterBenchmarks()
+{
+	cout << "\n\nLog writer main loop latency benchmark\n\n";
+
+#ifdef WINDOWS
+	cout << "Not available on Windows\n";
+	return true;
+#else
+	/* Each main loop pass logs a burst of lines into a pipe which is read
+	 * far more slowly than they are written, as if the disk had stalled
+	 */
+	static const unsigned int passes = 100;
+	static const unsigned int lines = 500;
+	const std::string line = std::string(99, 'x') + "\n";
+	const unsigned long total = (unsigned long)passes * lines * line.length();
+	static const char* modes[] = { "main thread", "thread, drop", "thread, block" };
+	unsigned long median[3];
+	bool passed = true;
+
+	if (ServerInstance->Logs->GetWriter())
+	{
+		cout << "The log writer thread is already running; set <performance:logthread> to no to run this\n";
+		return false;
+	}
+
+	for (unsigned int mode = 0; mode < 3; mode++)
+	{
+		int fds[2];
+		if (pipe(fds))
+			return false;
+		TestSuiteSlowReader* reader = new TestSuiteSlowReader(fds[0]);
+		ServerInstance->Threads->Start(reader);
+
+		if (mode)
+			ServerInstance->Logs->StartWriter(1024 * 1024, mode == 2);
+		FileWriter* fw = new FileWriter(fdopen(fds[1], "w"));
+
+		Histogram latency;
+		double begin = BenchmarkTime();
+		for (unsigned int pass = 0; pass < passes; pass++)
+		{
+			double start = BenchmarkTime();
+			for (unsigned int i = 0; i < lines; i++)
+				fw->WriteLogLine(line);
+			ServerInstance->Logs->Flush();
+			double elapsed = BenchmarkTime() - start;
+			latency.Add((unsigned long)(elapsed * 1000000.0));
+		}
+		double finished = BenchmarkTime();
+
+		/* Closes the pipe, once the thread (if any) has written everything */
+		delete fw;
+		ServerInstance->Logs->StopWriter();
+		reader->join();
+		close(fds[0]);
+
+		cout << modes[mode] << ": pass " << latency.Summary() << " total " << Histogram::FormatTime((unsigned long)((finished - begin) * 1000000.0))
+			<< " written=" << reader->bytes << "/" << total << "\n";
+		median[mode] = latency.GetPercentile(50);
+
+		/* Blocking and unthreaded writes lose nothing; dropping loses lines but notes it */
+		if (mode != 1 && reader->bytes != total)
+			passed = false;
+		if (mode == 1 && (reader->bytes == 0 || reader->bytes > total + 1024 * 1024))
+			passed = false;
+		delete reader;
+	}
+
+	/* Dropping must keep the main loop well clear of the stalls the main thread sees */
+	if (median[1] * 10 > median[0])
+		passed = false;
+
+	return passed;
+#endif
+}
+
+/** Stops the compiler discarding the results of benchmarked calls */
+static volatile unsigned long benchmark_sink;
+
+/* Run op repeatedly for a fifth of a second, and print a line which is easy for scripts to read:
+ * bench=name ops=count ns/op=time ops/sec=rate
+ */
+#define BENCHMARK(name, op) do { \
+		unsigned long bench_ops = 0; \
+		double bench_start = BenchmarkTime(); \
+		double bench_elapsed; \
+		do \
+		{ \
+			for (int bench_i = 0; bench_i < 100; bench_i++) \
+				{ op; } \
+			bench_ops += 100; \
+			bench_elapsed = BenchmarkTime() - bench_start; \
+		} while (bench_elapsed < 0.2); \
+		cout << "bench=" << name << " ops=" << bench_ops << " ns/op=" << (unsigned long)(bench_elapsed * 1e9 / bench_ops) \
+			<< " ops/sec=" << (unsigned long)(bench_ops / bench_elapsed) << "\n"; \
+	} while (0)
+
+/* Check that op gives the expected result before benchmarking it */
+#define BENCHCHECK(op, expected) if ((op) != (expected)) { cout << "FAILURE: " #op " != " #expected "\n"; passed = false; }
+
+bool TestSuite::DoMicroBenchmarks()
+{
+	cout << "\n\nCore primitive microbenchmarks\n\n";
+	cout << "version=" << VERSION << " revision=" << REVISION << " socketengine=" << ServerInstance->SE->GetName() << "\n";
+	bool passed = true;
+
+	/* Wildcard and CIDR matching, as done for bans and xlines */
+	const std::string host = "nick!ident@host-192-0-2-10.example.net";
+	const std::string ip = "nick!ident@192.0.2.10";
+	BENCHCHECK(InspIRCd::Match(host, "*!*@*.example.net"), true);
+	BENCHCHECK(InspIRCd::Match(host, "*!*@*.example.org"), false);
+	BENCHCHECK(InspIRCd::MatchCIDR(ip, "*!*@192.0.2.0/24"), true);
+	BENCHCHECK(InspIRCd::MatchCIDR(ip, "*!*@198.51.100.0/24"), false);
+	BENCHMARK("match.exact", benchmark_sink += InspIRCd::Match(host, "nick!ident@host-192-0-2-10.example.net"));
+	BENCHMARK("match.wildcard", benchmark_sink += InspIRCd::Match(host, "*!*@*.example.net"));
+	BENCHMARK("match.miss", benchmark_sink += InspIRCd::Match(host, "*!*@*.example.org"));
+	BENCHMARK("matchcidr.hit", benchmark_sink += InspIRCd::MatchCIDR(ip, "*!*@192.0.2.0/24"));
+	BENCHMARK("matchcidr.miss", benchmark_sink += InspIRCd::MatchCIDR(ip, "*!*@198.51.100.0/24"));
+
+	/* Splitting lines and lists */
+	const std::string line = ":nick!ident@host PRIVMSG #channel :the quick brown fox jumps over the lazy dog";
+	const std::string list = "#one,#two,#three,#four,#five,#six,#seven,#eight";
+	std::string token;
+	BENCHMARK("tokenstream", { irc::tokenstream tokens(line); while (tokens.GetToken(token)) benchmark_sink++; });
+	BENCHMARK("commasepstream", { irc::commasepstream items(list); while (items.GetToken(token)) benchmark_sink++; });
+	BENCHMARK("spacesepstream", { irc::spacesepstream items(line); while (items.GetToken(token)) benchmark_sink++; });
+
+	/* Case insensitive hashing and comparison, as used by the nick and channel maps */
+	const irc::string ircnick = "SomeLongerNick[away]";
+	const std::string nick1 = "SomeLongerNick[away]";
+	const std::string nick2 = "somelongernick{AWAY}";
+	BENCHCHECK(irc::StrHashComp()(nick1, nick2), true);
+	BENCHMARK("irc::hash", benchmark_sink += irc::hash()(ircnick));
+	BENCHMARK("StrHashComp", benchmark_sink += irc::StrHashComp()(nick1, nick2));
+
+	/* The rfc1459 map is folded without looking bytes up; a copy of it has to be looked up,
+	 * as a map loaded by m_nationalchars would be. Option H checks they give the same results.
+	 */
+	const std::string channel = "#Some-Channel[With]A\\Much^Longer_Name";
+	const std::string lowerchannel = "#some-channel{with}a|much^longer_name";
+	unsigned char tablemap[256];
+	memcpy(tablemap, rfc_case_insensitive_map, sizeof(tablemap));
+	const unsigned char* oldmap = national_case_insensitive_map;
+	BENCHMARK("StrHash.long", benchmark_sink += irc::StrHash()(channel));
+	BENCHMARK("StrHashComp.long", benchmark_sink += irc::StrHashComp()(channel, lowerchannel));
+	national_case_insensitive_map = tablemap;
+	BENCHMARK("StrHash.long.table", benchmark_sink += irc::StrHash()(channel));
+	BENCHMARK("StrHashComp.long.table", benchmark_sink += irc::StrHashComp()(channel, lowerchannel));
+	national_case_insensitive_map = oldmap;
+	user_hash nicks;
+	std::vector<std::string> keys;
+	for (unsigned int i = 0; i < 10000; i++)
+	{
+		keys.push_back("Nick" + ConvToStr(i * 7919));
+		nicks[keys.back()] = NULL;
+	}
+	unsigned int next = 0;
+	BENCHMARK("user_hash.find", benchmark_sink += nicks.count(keys[next++ % keys.size()]));
+
+	/* Building mode lines */
+	std::vector<std::string> stacked;
+	BENCHMARK("modestacker", {
+		irc::modestacker stack(true);
+		for (unsigned int i = 0; i < 12; i++)
+			stack.Push('o', keys[i]);
+		while (stack.GetStackedLine(stacked))
+			stacked.clear();
+	});
+
+	/* Pooled strings share one copy of each value and compare by pointer */
+	{
+		const std::string servername = "services.benchmark.example.net";
+		PooledString first(servername);
+		PooledString second(servername);
+		PooledString other("other.benchmark.example.net");
+		BENCHCHECK(first == second, true);
+		const std::string copy(servername);
+		BENCHMARK("PooledString.compare", benchmark_sink += (first == second));
+		BENCHMARK("std::string.compare", benchmark_sink += (servername == copy));
+		BENCHMARK("PooledString.assign", other = keys[next++ % 12]);
+	}
+
+	/* A channel with bans, and a user to check against them */
+	Channel* chan = new Channel("#benchmark", ServerInstance->Time());
+	std::vector<std::string> modes;
+	modes.push_back(chan->name);
+	modes.push_back("+b");
+	modes.push_back("");
+	for (unsigned int i = 0; i < 50; i++)
+	{
+		modes[2] = "*!*@host" + ConvToStr(i) + ".example.org";
+		ServerInstance->Modes->Process(modes, ServerInstance->FakeClient);
+	}
+	BENCHCHECK(chan->bans.size(), (size_t)50);
+
+	RemoteUser* user = MakeTestUser();
+
+	BENCHCHECK(chan->CheckBan(user, "*!*@*.example.net"), true);
+	BENCHCHECK(chan->CheckBan(user, "*!*@192.0.2.0/24"), true);
+	BENCHCHECK(chan->IsBanned(user), false);
+	BanItem ban;
+	ban.data = "*!*@192.0.2.0/24";
+	ban.mask.Compile(ban.data);
+	BENCHCHECK(chan->CheckBan(user, ban), true);
+	ban.data = "n?ck!*@*.example.net";
+	ban.mask.Compile(ban.data);
+	BENCHCHECK(chan->CheckBan(user, ban), true);
+	ban.data = "*!ident@cloaked.example.net";
+	ban.mask.Compile(ban.data);
+	BENCHCHECK(chan->CheckBan(user, ban), true);
+	ban.data = "nick*ident@*";
+	ban.mask.Compile(ban.data);
+	BENCHCHECK(chan->CheckBan(user, ban), true);
+	ban.data = "*!*@198.51.100.0/24";
+	ban.mask.Compile(ban.data);
+	BENCHCHECK(chan->CheckBan(user, ban), false);
+	BENCHMARK("CheckBan.host", benchmark_sink += chan->CheckBan(user, "*!*@*.example.net"));
+	BENCHMARK("CheckBan.cidr", benchmark_sink += chan->CheckBan(user, "*!*@192.0.2.0/24"));
+	BENCHMARK("CheckBan.miss", benchmark_sink += chan->CheckBan(user, "other!*@*.example.org"));
+	BENCHMARK("CheckBan.compiled", benchmark_sink += chan->CheckBan(user, ban));
+	BENCHMARK("IsBanned.50bans", benchmark_sink += chan->IsBanned(user));
+
+	/* A long ban list, mostly hosts with a few ranges and wildcards, added directly as it is over the +b limit */
+	for (unsigned int i = 50; i < 500; i++)
+	{
+		if (i % 10 == 0)
+			ban.data = "*!*@*.domain" + ConvToStr(i) + ".example.com";
+		else if (i % 10 == 1)
+			ban.data = "*!*@10." + ConvToStr(i / 256) + "." + ConvToStr(i % 256) + ".0/24";
+		else
+			ban.data = "*!*@host" + ConvToStr(i) + ".example.org";
+		ban.mask.Compile(ban.data);
+		chan->bans.push_back(ban);
+	}
+	chan->BanListChanged();
+	BENCHCHECK(chan->IsBanned(user), false);
+	BENCHMARK("IsBanned.500bans", benchmark_sink += chan->IsBanned(user));
+
+	/* Members keep the answer until the ban list or their nick, ident or host changes; option J checks that */
+	Membership* memb = chan->AddUser(user);
+	BENCHCHECK(chan->IsBanned(user), false);
+	BENCHMARK("IsBanned.500bans.member", benchmark_sink += chan->IsBanned(user));
+	chan->userlist.erase(user);
+	memb->cull();
+	delete memb;
+
+	/* Changing modes, set and unset in turn */
+	std::vector<std::string> setmodes;
+	setmodes.push_back(chan->name);
+	setmodes.push_back("+lk");
+	setmodes.push_back("100");
+	setmodes.push_back("key");
+	std::vector<std::string> unsetmodes;
+	unsetmodes.push_back(chan->name);
+	unsetmodes.push_back("-lk");
+	unsetmodes.push_back("key");
+	ServerInstance->Modes->Process(setmodes, ServerInstance->FakeClient);
+	BENCHCHECK(chan->IsModeSet('l'), true);
+	ServerInstance->Modes->Process(unsetmodes, ServerInstance->FakeClient);
+	BENCHMARK("ModeParser::Process", {
+		ServerInstance->Modes->Process(setmodes, ServerInstance->FakeClient);
+		ServerInstance->Modes->Process(unsetmodes, ServerInstance->FakeClient);
+	});
+
+	/* Extension items, as modules read them in their hooks. Items not registered get a slot
+	 * when first set, so these come after those of the core and of any loaded modules.
+	 */
+	const size_t extcount = user->GetExtList().size();
+	std::vector<LocalIntExt*> extitems;
+	std::map<reference<ExtensionItem>, void*> exttree;
+	for (unsigned int i = 0; i < 32; i++)
+	{
+		extitems.push_back(new LocalIntExt("benchmark" + ConvToStr(i), NULL));
+		extitems[i]->set(user, i + 1);
+		exttree[extitems[i]] = reinterpret_cast<void*>((intptr_t)(i + 1));
+	}
+	BENCHCHECK(extitems[31]->get(user), (intptr_t)32);
+	BENCHCHECK(user->GetExtList().size(), extcount + 32);
+	BENCHMARK("ExtensionItem.get", benchmark_sink += extitems[31]->get(user));
+	BENCHMARK("ExtensionItem.get.map", benchmark_sink += (exttree.find(extitems[31]) != exttree.end()));
+	BENCHMARK("ExtensionItem.set", extitems[15]->set(user, 16));
+	exttree.clear();
+	for (unsigned int i = 0; i < 32; i++)
+	{
+		extitems[i]->set(user, 0);
+		delete extitems[i];
+	}
+
+	/* XLine matching, against a user who is not banned, which is by far the common case */
+	GLine gline(ServerInstance->Time(), 0, "benchmark", "benchmark", "*", "*.example.org");
+	KLine kline(ServerInstance->Time(), 0, "benchmark", "benchmark", "baduser", "*");
+	ZLine zline(ServerInstance->Time(), 0, "benchmark", "benchmark", "198.51.100.0/24");
+	QLine qline(ServerInstance->Time(), 0, "benchmark", "benchmark", "Guest*");
+	BENCHCHECK(gline.Matches(user), false);
+	BENCHCHECK(zline.Matches(user), false);
+	BENCHCHECK(GLine(ServerInstance->Time(), 0, "benchmark", "benchmark", "IDENT", "192.0.2.0/24").Matches(user), true);
+	BENCHCHECK(ZLine(ServerInstance->Time(), 0, "benchmark", "benchmark", "192.0.2.*").Matches(user), true);
+	BENCHMARK("GLine::Matches", benchmark_sink += gline.Matches(user));
+	BENCHMARK("KLine::Matches", benchmark_sink += kline.Matches(user));
+	BENCHMARK("ZLine::Matches", benchmark_sink += zline.Matches(user));
+	BENCHMARK("QLine::Matches", benchmark_sink += qline.Matches(user));
+
+	DeleteTestUser(user);
+	DeleteTestChannel(chan);
+
+	/* Hash providers, loading their modules if need be */
+	static const char* const hashes[] = { "md5", "sha256", "ripemd160" };
+	const std::string password = "correct horse battery staple";
+	for (unsigned int i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++)
+	{
+		std::string name = hashes[i];
+		HashProvider* hp = ServerInstance->Modules->FindDataService<HashProvider>("hash/" + name);
+		if (!hp && ServerInstance->Modules->Load(("m_" + name + ".so").c_str()))
+			hp = ServerInstance->Modules->FindDataService<HashProvider>("hash/" + name);
+		if (!hp)
+		{
+			cout << "bench=hash." << name << " skipped: m_" << name << ".so is not available\n";
+			continue;
+		}
+		BENCHMARK("hash." + name, benchmark_sink += hp->sum(password).length());
+	}
+
+	return passed;
+}
+
+/** The node based hash map which user_hash and chan_hash used to be, to compare against */
+#if defined(WINDOWS) && !defined(HASHMAP_DEPRECATED)
+typedef nspace::hash_map<std::string, User*, nspace::hash_compare<std::string, std::less<std::string> > > node_user_hash;
+#elif defined(HASHMAP_DEPRECATED)
+typedef nspace::hash_map<std::string, User*, nspace::insensitive, irc::StrHashComp> node_user_hash;
+#else
+typedef nspace::hash_map<std::string, User*, nspace::hash<std::string>, irc::StrHashComp> node_user_hash;
+#endif
+
+static void PrintBenchmark(const std::string& name, unsigned long ops, double elapsed)
+{
+	cout << "bench=" << name << " ops=" << ops << " ns/op=" << (unsigned long)(elapsed * 1e9 / ops)
+		<< " ops/sec=" << (unsigned long)(ops / elapsed) << "\n";
+}
+
+/** Insert every key, look each one up in a different order, look up keys which are
+ * not there, then erase them all. Returns false if the map gave a wrong answer.
+ */
+template<typename Map> static bool HashTableBenchmark(const std::string& name, const std::vector<std::string>& keys,
+	const std::vector<std::string>& lookups, const std::vector<std::string>& missing)
+{
+	bool passed = true;
+	Map* map = new Map;
+	User* value = reinterpret_cast<User*>(map);
+
+	double start = BenchmarkTime();
+	for (std::vector<std::string>::const_iterator i = keys.begin(); i != keys.end(); ++i)
+		(*map)[*i] = value;
+	PrintBenchmark(name + ".insert", keys.size(), BenchmarkTime() - start);
+	if (map->size() != keys.size())
+		passed = false;
+
+	unsigned long found = 0;
+	start = BenchmarkTime();
+	for (std::vector<std::string>::const_iterator i = lookups.begin(); i != lookups.end(); ++i)
+	{
+		typename Map::iterator it = map->find(*i);
+		if (it != map->end() && it->second == value)
+			found++;
+	}
+	PrintBenchmark(name + ".find", lookups.size(), BenchmarkTime() - start);
+	if (found != lookups.size())
+		passed = false;
+
+	found = 0;
+	start = BenchmarkTime();
+	for (std::vector<std::string>::const_iterator i = missing.begin(); i != missing.end(); ++i)
+		found += (map->find(*i) != map->end());
+	PrintBenchmark(name + ".miss", missing.size(), BenchmarkTime() - start);
+	if (found)
+		passed = false;
+
+	start = BenchmarkTime();
+	for (std::vector<std::string>::const_iterator i = lookups.begin(); i != lookups.end(); ++i)
+		map->erase(*i);
+	PrintBenchmark(name + ".erase", lookups.size(), BenchmarkTime() - start);
+	if (!map->empty())
+		passed = false;
+
+	delete map;
+	return passed;
+}
+
+bool TestSuite::DoHashTableBenchmarks()
+{
+	cout << "\n\nNick and channel hash table benchmarks\n\n";
+	bool passed = true;
+
+	/* A million nicks, looked up in a different case and order to the one they went in */
+	const unsigned int count = 1000000;
+	std::vector<std::string> keys;
+	std::vector<std::string> lookups;
+	std::vector<std::string> missing;
+	keys.reserve(count);
+	lookups.reserve(count);
+	missing.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		keys.push_back("Guest[" + ConvToStr(i) + "]");
+		lookups.push_back("GUEST{" + ConvToStr((i * 7919UL) % count) + "}");
+		missing.push_back("Other" + ConvToStr(i));
+	}
+
+	for (unsigned int round = 0; round < 2; round++)
+	{
+		if (!HashTableBenchmark<user_hash>("flat_hash_map", keys, lookups, missing))
+		{
+			cout << "FAILURE: flat_hash_map gave a wrong answer\n";
+			passed = false;
+		}
+		if (!HashTableBenchmark<node_user_hash>("node_hash_map", keys, lookups, missing))
+		{
+			cout << "FAILURE: node_hash_map gave a wrong answer\n";
+			passed = false;
+		}
+	}
+
+	/* Erasing while iterating must visit every entry once, as QuitUser and friends rely on it */
+	user_hash map;
+	for (unsigned int i = 0; i < 1000; i++)
+		map[keys[i]] = NULL;
+	unsigned long visited = 0;
+	for (user_hash::iterator i = map.begin(); i != map.end(); )
+	{
+		visited++;
+		if (visited % 2)
+			map.erase(i++);
+		else
+			++i;
+	}
+	if (visited != 1000 || map.size() != 500)
+	{
+		cout << "FAILURE: erasing while iterating visited " << visited << " entries and left " << map.size() << "\n";
+		passed = false;
+	}
+
+	return passed;
+}
+
+/** The ordered map which Channel::userlist used to be, to compare against */
+typedef std::map<User*, Membership*> tree_memb_list;
+
+/** Join every user to a member list, send to the channel, look each member up in a
+ * different order, then part them in that order. The memberships are made beforehand,
+ * so that only the list is timed. Returns false if the list gave a wrong answer.
+ */
+template<typename List> static bool MembershipBenchmark(const std::string& name, const std::vector<Membership*>& members,
+	const std::vector<User*>& order)
+{
+	bool passed = true;
+	/* Repeat small channels so that each timing covers a similar number of members */
+	const unsigned int rounds = members.size() < 1000000 ? 1000000 / members.size() : 1;
+	const unsigned int sends = members.size() < 10000000 ? 10000000 / members.size() : 1;
+	double join = 0, fanout = 0, lookup = 0, part = 0;
+
+	for (unsigned int round = 0; round < rounds; round++)
+	{
+		List* list = new List;
+
+		double start = BenchmarkTime();
+		for (std::vector<Membership*>::const_iterator i = members.begin(); i != members.end(); ++i)
+			(*list)[(*i)->user] = *i;
+		join += BenchmarkTime() - start;
+		if (list->size() != members.size())
+			passed = false;
+
+		/* What WriteChannel does for each member, short of queueing the line */
+		if (round == 0)
+		{
+			unsigned long locals = 0;
+			start = BenchmarkTime();
+			for (unsigned int send = 0; send < sends; send++)
+			{
+				for (typename List::const_iterator i = list->begin(); i != list->end(); ++i)
+				{
+					if (IS_LOCAL(i->first))
+						locals++;
+					benchmark_sink += (i->second != NULL);
+				}
+			}
+			fanout = BenchmarkTime() - start;
+			if (locals)
+				passed = false;
+		}
+
+		unsigned long found = 0;
+		start = BenchmarkTime();
+		for (std::vector<User*>::const_iterator i = order.begin(); i != order.end(); ++i)
+		{
+			typename List::iterator m = list->find(*i);
+			if (m != list->end() && m->second->user == *i)
+				found++;
+		}
+		lookup += BenchmarkTime() - start;
+		if (found != order.size())
+			passed = false;
+
+		/* Every member must still be found as the others leave, as parting moves members around */
+		found = 0;
+		start = BenchmarkTime();
+		for (std::vector<User*>::const_iterator i = order.begin(); i != order.end(); ++i)
+		{
+			typename List::iterator m = list->find(*i);
+			if (m == list->end())
+				continue;
+			found += (m->second->user == *i);
+			list->erase(m);
+		}
+		part += BenchmarkTime() - start;
+		if (found != order.size() || !list->empty())
+			passed = false;
+
+		delete list;
+	}
+
+	const std::string prefix = name + "." + ConvToStr(members.size());
+	PrintBenchmark(prefix + ".join", members.size() * rounds, join);
+	PrintBenchmark(prefix + ".fanout", members.size() * sends, fanout);
+	PrintBenchmark(prefix + ".lookup", members.size() * rounds, lookup);
+	PrintBenchmark(prefix + ".part", members.size() * rounds, part);
+	return passed;
+}
+
+bool TestSuite::DoMembershipBenchmarks()
+{
+	cout << "\n\nChannel membership benchmarks\n\n";
+	bool passed = true;
+
+	Channel* chan = new Channel("#benchmark", ServerInstance->Time());
+	std::vector<User*> allusers;
+	static const unsigned int sizes[] = { 100, 10000, 100000 };
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		while (allusers.size() < sizes[s])
+			allusers.push_back(new RemoteUser(ServerInstance->GetUID(), ServerInstance->Config->ServerName));
+
+		/* Members leave in a different order to the one they joined in */
+		std::vector<Membership*> members;
+		std::vector<User*> order;
+		members.reserve(sizes[s]);
+		order.reserve(sizes[s]);
+		for (unsigned int i = 0; i < sizes[s]; i++)
+		{
+			members.push_back(new Membership(allusers[i], chan));
+			order.push_back(allusers[(i * 7919UL) % sizes[s]]);
+		}
+
+		if (!MembershipBenchmark<UserMembList>("dense_map", members, order))
+		{
+			cout << "FAILURE: dense_map gave a wrong answer\n";
+			passed = false;
+		}
+		if (!MembershipBenchmark<tree_memb_list>("std::map", members, order))
+		{
+			cout << "FAILURE: std::map gave a wrong answer\n";
+			passed = false;
+		}
+
+		for (std::vector<Membership*>::iterator i = members.begin(); i != members.end(); ++i)
+		{
+			(*i)->cull();
+			delete *i;
+		}
+	}
+
+	/* Members moved into the gap a part leaves are still visited by a loop going backwards */
+	UserMembList list;
+	for (unsigned int i = 0; i < 1000; i++)
+		list[allusers[i]] = NULL;
+	unsigned long visited = 0;
+	for (UserMembList::iterator i = list.end(); i != list.begin(); )
+	{
+		--i;
+		if (++visited % 2)
+			list.erase(i);
+	}
+	if (visited != 1000 || list.size() != 500)
+	{
+		cout << "FAILURE: parting while iterating visited " << visited << " members and left " << list.size() << "\n";
+		passed = false;
+	}
+
+	for (std::vector<User*>::iterator i = allusers.begin(); i != allusers.end(); ++i)
+	{
+		User* user = *i;
+		user->quitting = true;
+		ServerInstance->Users->uuidlist->erase(user->uuid);
+		user->client_sa.sa.sa_family = AF_UNSPEC;
+		user->cull();
+		delete user;
+	}
+	chan->cull();
+	delete chan;
+
+	return passed;
+}
+
 bool TestSuite::DoThreadTests()
 {
 	std::string anything;
@@ -327,6 +1870,164 @@ bool TestSuite::DoThreadTests()
 	return true;
 }
 
+/** Get the numerics a client was sent before the first PONG, which should not depend on how its socket is serviced */
+static std::string BurstNumerics(const std::string& in)
+{
+	std::string numerics;
+	std::string::size_type end = in.find(" PONG ");
+	irc::sepstream lines(in.substr(0, end == std::string::npos ? in.length() : in.rfind('\n', end) + 1), '\n');
+	std::string line;
+	while (lines.GetToken(line))
+	{
+		irc::spacesepstream words(line);
+		std::string word;
+		if (words.GetToken(word) && words.GetToken(word))
+			numerics.append(word).append(" ");
+	}
+	return numerics;
+}
+
+bool TestSuite::DoIOThreadBenchmarks()
+{
+	cout << "\n\nI/O thread benchmark\n\n";
+
+	irc::sockets::sockaddrs target;
+	if (!FindClientPort(target))
+		return false;
+	if (ServerInstance->IOThreads)
+	{
+		cout << "Set <performance:iothreads> to 0 to run this benchmark\n";
+		return false;
+	}
+
+	/* Every client's output, and the close at the end, must be the same however many threads
+	 * service the sockets. The welcome burst is queued before the socket is handed over.
+	 */
+	static const unsigned int threadcounts[] = { 0, 1, 4 };
+	static const unsigned int clientcount = 20;
+	static const unsigned int linecount = 5000;
+	static const unsigned int perbatch = 50;
+	std::vector<std::string> expected;
+	bool passed = true;
+
+	for (unsigned int t = 0; t < sizeof(threadcounts) / sizeof(threadcounts[0]); t++)
+	{
+		if (threadcounts[t])
+			ServerInstance->IOThreads = new IOThreadPool(threadcounts[t]);
+
+		TestSuiteIOClients* clients = new TestSuiteIOClients(linecount, perbatch);
+		std::vector<std::string> nicks;
+		for (unsigned int i = 0; i < clientcount; i++)
+		{
+			int fd;
+			nicks.push_back("IOBench" + ConvToStr(i));
+			if (!ConnectBenchmarkUser(target, nicks.back(), fd))
+			{
+				if (fd >= 0)
+					close(fd);
+				passed = false;
+				break;
+			}
+			clients->Add(fd);
+		}
+
+		double cpu = ThreadCPUTime();
+		ServerInstance->Threads->Start(clients);
+		while (!clients->done)
+			RunMainLoopOnce();
+		cpu = ThreadCPUTime() - cpu;
+		clients->join();
+
+		unsigned long lines = 0;
+		for (std::vector<TestSuiteIOClients::Client>::iterator i = clients->clients.begin(); i != clients->clients.end(); ++i)
+		{
+			lines += i->received;
+			if (i->received != linecount)
+				passed = false;
+			std::string quit = "QUIT :Benchmark over\r\n";
+			if (write(i->fd, quit.data(), quit.length()) != (ssize_t)quit.length())
+				passed = false;
+		}
+		if (clients->failed)
+			passed = false;
+
+		/* Every client should now be sent its ERROR line, and then be disconnected */
+		size_t open = clients->clients.size();
+		double deadline = BenchmarkTime() + 10;
+		while (open && BenchmarkTime() < deadline)
+		{
+			RunMainLoopOnce();
+			for (std::vector<TestSuiteIOClients::Client>::iterator i = clients->clients.begin(); i != clients->clients.end(); ++i)
+			{
+				char buf[65536];
+				int n;
+				while (i->fd >= 0 && (n = recv(i->fd, buf, sizeof(buf), 0)) != 0)
+				{
+					if (n < 0)
+						break;
+					i->in.append(buf, n);
+				}
+				if (i->fd >= 0 && n == 0)
+				{
+					close(i->fd);
+					i->fd = -1;
+					open--;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < clients->clients.size(); i++)
+		{
+			TestSuiteIOClients::Client& c = clients->clients[i];
+			if (c.fd >= 0)
+			{
+				cout << "Client " << i << " was not disconnected\n";
+				close(c.fd);
+				passed = false;
+			}
+			std::string::size_type lastline = c.in.rfind('\n', c.in.length() - 2);
+			if (c.in.compare(lastline + 1, 20, "ERROR :Closing link:"))
+			{
+				cout << "Client " << i << " was not sent an ERROR line\n";
+				passed = false;
+			}
+
+			/* The burst has to arrive whole and in order; everything after it byte for byte */
+			std::string output = BurstNumerics(c.in) + c.in.substr(c.in.find(" PONG ") == std::string::npos ? 0 : c.in.rfind('\n', c.in.find(" PONG ")) + 1);
+			if (!t)
+				expected.push_back(output);
+			else if (i >= expected.size() || output != expected[i])
+			{
+				cout << "Client " << i << " was sent different output with " << threadcounts[t] << " I/O threads\n";
+				passed = false;
+			}
+		}
+
+		/* Clean up after a client which never got as far as its QUIT */
+		for (std::vector<std::string>::iterator i = nicks.begin(); i != nicks.end(); ++i)
+		{
+			User* user = ServerInstance->FindNick(*i);
+			if (user && IS_LOCAL(user))
+				ServerInstance->Users->QuitUser(user, "Benchmark over");
+		}
+		ServerInstance->GlobalCulls.Apply();
+		if (ServerInstance->IOThreads)
+		{
+			delete ServerInstance->IOThreads;
+			ServerInstance->IOThreads = NULL;
+		}
+
+		if (!lines)
+			lines = 1;
+		cout << "iothreads=" << threadcounts[t] << " clients=" << clientcount << " lines=" << lines
+			<< " main-thread-usec/line=" << cpu * 1000000 / lines
+			<< " lines/sec=" << (unsigned long)(lines / (clients->elapsed > 0 ? clients->elapsed : 1e-9)) << "\n";
+		delete clients;
+	}
+
+	return passed;
+}
+
 TestSuite::~TestSuite()
 {
 	cout << "\n\n*** END OF TEST SUITE ***\n";
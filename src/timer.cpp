@@ -25,55 +25,264 @@
 #include "inspircd.h"
 #include "timer.h"
 
-TimerManager::TimerManager()
+TimerManager::TimerManager() : Epoch(ServerInstance->Time()), Position(0), CoarseEnd(0), Count(0)
 {
+	for (unsigned int i = 0; i < WHEEL_SIZE; i++)
+		Wheel[i] = Coarse[i] = NULL;
+	for (unsigned int i = 0; i < WHEEL_SIZE / WORD_BITS; i++)
+		Occupied[i] = 0;
 }
 
 TimerManager::~TimerManager()
 {
-	for(std::vector<Timer *>::iterator i = Timers.begin(); i != Timers.end(); i++)
-		delete *i;
+	for (unsigned int i = 0; i < WHEEL_SIZE; i++)
+	{
+		while (Wheel[i])
+		{
+			Timer* t = Wheel[i];
+			Wheel[i] = t->next;
+			delete t;
+		}
+		while (Coarse[i])
+		{
+			Timer* t = Coarse[i];
+			Coarse[i] = t->next;
+			delete t;
+		}
+	}
+}
+
+/* Millisecond times wrap, so they are compared by the sign of their difference */
+static inline bool After(unsigned long a, unsigned long b)
+{
+	return (long)(a - b) > 0;
+}
+
+unsigned long TimerManager::ToMS(time_t sec, long ms)
+{
+	return (unsigned long)(sec - Epoch) * 1000 + ms;
+}
+
+unsigned long TimerManager::DueMS(Timer* T)
+{
+	/* A one-second timer triggers on the first tick after its trigger time */
+	if (T->trigger_ms < 0)
+		return ToMS(T->GetTimer() + 1, 0);
+	return ToMS(T->GetTimer(), T->trigger_ms);
+}
+
+void TimerManager::Link(Timer* T)
+{
+	/* Timers which are already overdue go in the next slot to be checked */
+	unsigned long due = DueMS(T);
+	if (!After(due, Position))
+		due = Position + 1;
+
+	Timer** slot;
+	if (After(CoarseEnd, due))
+	{
+		unsigned int index = due & (WHEEL_SIZE - 1);
+		slot = &Wheel[index];
+		Occupied[index / WORD_BITS] |= 1UL << (index % WORD_BITS);
+	}
+	else
+	{
+		slot = &Coarse[(due / COARSE_MS) & (WHEEL_SIZE - 1)];
+	}
+
+	T->next = *slot;
+	if (T->next)
+		T->next->prev = &T->next;
+	T->prev = slot;
+	*slot = T;
+}
+
+void TimerManager::Cascade()
+{
+	/* A coarse slot can be moved down once the whole of it is within
+	 * the range of the fine wheel. After a long clock jump, every coarse
+	 * slot is looked at once.
+	 */
+	unsigned long limit = Position + WHEEL_SIZE;
+	if (After(limit, CoarseEnd) && limit - CoarseEnd > (unsigned long)WHEEL_SIZE * COARSE_MS)
+		CoarseEnd = (limit - WHEEL_SIZE * COARSE_MS) & ~(unsigned long)(COARSE_MS - 1);
+
+	while (!After(CoarseEnd + COARSE_MS - 1, limit))
+	{
+		unsigned int index = (CoarseEnd / COARSE_MS) & (WHEEL_SIZE - 1);
+		Timer* pending = Coarse[index];
+		Coarse[index] = NULL;
+		if (pending)
+			pending->prev = &pending;
+		CoarseEnd += COARSE_MS;
+
+		/* Anything not due in this slot's time is due on a later turn, and goes back */
+		while (pending)
+		{
+			Timer* t = pending;
+			Unlink(t);
+			Link(t);
+		}
+	}
+}
+
+void TimerManager::Unlink(Timer* T)
+{
+	*T->prev = T->next;
+	if (T->next)
+		T->next->prev = T->prev;
+	T->next = NULL;
+	T->prev = NULL;
+}
+
+bool TimerManager::NextOccupied(unsigned long limit, unsigned long& when)
+{
+	unsigned long ms = Position + 1;
+	/* Never look at more than one turn of the wheel */
+	if (limit - Position > WHEEL_SIZE)
+		limit = Position + WHEEL_SIZE;
+
+	while (!After(ms, limit))
+	{
+		unsigned int index = ms & (WHEEL_SIZE - 1);
+		unsigned long bits = Occupied[index / WORD_BITS] >> (index % WORD_BITS);
+		if (!bits)
+		{
+			/* Skip the rest of this word */
+			ms += WORD_BITS - (index % WORD_BITS);
+			continue;
+		}
+		while (!(bits & 1))
+		{
+			bits >>= 1;
+			ms++;
+		}
+		if (After(ms, limit))
+			break;
+
+		index = ms & (WHEEL_SIZE - 1);
+		if (Wheel[index])
+		{
+			when = ms;
+			return true;
+		}
+		/* Everything in this slot has been deleted */
+		Occupied[index / WORD_BITS] &= ~(1UL << (index % WORD_BITS));
+		ms++;
+	}
+	return false;
 }
 
 void TimerManager::TickTimers(time_t TIME)
 {
-	while ((Timers.size()) && (TIME > (*Timers.begin())->GetTimer()))
+	timespec now;
+	now.tv_sec = TIME;
+	now.tv_nsec = 0;
+	TickTimers(now);
+}
+
+void TimerManager::TickTimers(const timespec& now)
+{
+	unsigned long nowms = ToMS(now.tv_sec, now.tv_nsec / 1000000);
+	if (!After(nowms, Position))
+		return;
+
+	/* If the clock has jumped by more than a full turn, every slot is checked once */
+	if (nowms - Position > WHEEL_SIZE)
+		Position = nowms - WHEEL_SIZE;
+	Cascade();
+
+	unsigned long ms;
+	while (NextOccupied(nowms, ms))
 	{
-		std::vector<Timer *>::iterator i = Timers.begin();
-		Timer *t = (*i);
+		Position = ms;
 
-		// Probable fix: move vector manipulation to *before* we modify the vector.
-		Timers.erase(i);
+		/* Take the whole slot off the wheel first, so that timers added or
+		 * deleted from within Tick() cannot disturb the walk. Timers deleted
+		 * while they are still on this list are unlinked from it as usual.
+		 */
+		unsigned int index = ms & (WHEEL_SIZE - 1);
+		Timer* pending = Wheel[index];
+		Wheel[index] = NULL;
+		Occupied[index / WORD_BITS] &= ~(1UL << (index % WORD_BITS));
+		pending->prev = &pending;
 
-		t->Tick(TIME);
-		if (t->GetRepeat())
+		while (pending)
 		{
-			t->SetTimer(TIME + t->GetSecs());
-			AddTimer(t);
+			Timer* t = pending;
+			Unlink(t);
+
+			if (After(DueMS(t), nowms))
+			{
+				/* Due later, on another turn of the wheel or after SetTimer() */
+				Link(t);
+				continue;
+			}
+
+			Count--;
+			t->Tick(now.tv_sec);
+			if (t->prev)
+			{
+				/* The timer requeued itself from within Tick() */
+				continue;
+			}
+			if (t->GetRepeat())
+			{
+				if (t->trigger_ms < 0)
+				{
+					t->SetTimer(now.tv_sec + t->GetSecs());
+				}
+				else
+				{
+					unsigned long next = now.tv_nsec / 1000000 + t->msecs;
+					t->SetTimer(now.tv_sec + next / 1000);
+					t->trigger_ms = next % 1000;
+				}
+				AddTimer(t);
+			}
+			else
+				delete t;
 		}
-		else
-			delete t;
 	}
+	Position = nowms;
+	Cascade();
 }
 
-void TimerManager::DelTimer(Timer* T)
+int TimerManager::GetNextTimeout(int maxms)
 {
-	std::vector<Timer *>::iterator i = std::find(Timers.begin(), Timers.end(), T);
+	const timespec& now = ServerInstance->Time_ts();
+	unsigned long nowms = ToMS(now.tv_sec, now.tv_nsec / 1000000);
 
-	if (i != Timers.end())
+	unsigned long ms;
+	if (!NextOccupied(nowms + maxms, ms))
+		return maxms;
+	if (!After(ms, nowms))
+		return 0;
+	return ms - nowms;
+}
+
+void TimerManager::DelTimer(Timer* T)
+{
+	if (T->prev)
 	{
-		delete (*i);
-		Timers.erase(i);
+		Unlink(T);
+		Count--;
+		delete T;
 	}
 }
 
 void TimerManager::AddTimer(Timer* T)
 {
-	Timers.push_back(T);
-	sort(Timers.begin(), Timers.end(), TimerManager::TimerComparison);
+	if (T->prev)
+		Unlink(T);
+	else
+		Count++;
+	Link(T);
 }
 
 bool TimerManager::TimerComparison( Timer *one, Timer *two)
 {
-	return (one->GetTimer()) < (two->GetTimer());
+	if (one->GetTimer() != two->GetTimer())
+		return (one->GetTimer()) < (two->GetTimer());
+	return one->trigger_ms < two->trigger_ms;
 }
@@ -128,6 +128,7 @@ void UserResolver::OnLookupComplete(const std::string &result, unsigned int ttl,
 
 		// Save some memory by freeing this up; it's never used again in the user's lifetime.
 		bound_user->stored_host.resize(0);
+		ServerInstance->Users->CheckReady(bound_user);
 	}
 }
 
@@ -140,5 +141,6 @@ void UserResolver::OnError(ResolverError e, const std::string &errormessage)
 		bound_user->dns_done = true;
 		bound_user->stored_host.resize(0);
 		ServerInstance->stats->statsDnsBad++;
+		ServerInstance->Users->CheckReady(bound_user);
 	}
 }
@@ -114,7 +114,7 @@ void UserManager::AddUser(int socket, ListenSocket* via, irc::sockets::sockaddrs
 		if (!b->Type.empty() && !New->exempt)
 		{
 			/* user banned */
-			ServerInstance->Logs->Log("BANCACHE", DEBUG, std::string("BanCache: Positive hit for ") + New->GetIPString());
+			ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCache: Positive hit for %s", New->GetIPString());
 			if (!ServerInstance->Config->MoronBanner.empty())
 				New->WriteServ("NOTICE %s :*** %s", New->nick.c_str(), ServerInstance->Config->MoronBanner.c_str());
 			this->QuitUser(New, b->Reason);
@@ -122,7 +122,7 @@ void UserManager::AddUser(int socket, ListenSocket* via, irc::sockets::sockaddrs
 		}
 		else
 		{
-			ServerInstance->Logs->Log("BANCACHE", DEBUG, std::string("BanCache: Negative hit for ") + New->GetIPString());
+			ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCache: Negative hit for %s", New->GetIPString());
 		}
 	}
 	else
@@ -208,6 +208,8 @@ void UserManager::QuitUser(User *user, const std::string &quitreason, const char
 	{
 		LocalUser* lu = IS_LOCAL(user);
 		FOREACH_MOD(I_OnUserDisconnect,OnUserDisconnect(lu));
+		if (ServerInstance->Capture->IsActive())
+			ServerInstance->Capture->AddQuit(lu);
 		lu->eh.Close();
 	}
 
@@ -247,6 +249,48 @@ void UserManager::QuitUser(User *user, const std::string &quitreason, const char
 }
 
 
+void UserManager::CheckReady(LocalUser* user)
+{
+	if (!user || user->ready_check || user->registered != REG_NICKUSER)
+		return;
+
+	user->ready_check = true;
+	ready_checks.push_back(user);
+}
+
+void UserManager::CancelReadyCheck(LocalUser* user)
+{
+	std::vector<LocalUser*>::iterator i = std::find(ready_checks.begin(), ready_checks.end(), user);
+	if (i != ready_checks.end())
+		ready_checks.erase(i);
+	user->ready_check = false;
+}
+
+void UserManager::DoReadyChecks()
+{
+	/* FullConnect() calls into modules, which may queue more users */
+	while (!ready_checks.empty())
+	{
+		std::vector<LocalUser*> checks;
+		checks.swap(ready_checks);
+
+		for (std::vector<LocalUser*>::iterator i = checks.begin(); i != checks.end(); ++i)
+		{
+			LocalUser* user = *i;
+			user->ready_check = false;
+			if (user->quitting || user->registered != REG_NICKUSER)
+				continue;
+			if (user->dns_done && ServerInstance->AllModulesReportReady(user))
+				user->FullConnect();
+			else
+			{
+				/* Fall back to polling in case whatever is holding them back never calls CheckReady() */
+				user->ScheduleCheck(ServerInstance->Time());
+			}
+		}
+	}
+}
+
 void UserManager::AddLocalClone(User *user)
 {
 	clonemap::iterator x;
@@ -46,76 +46,87 @@ void FloodQuitUserHandler::Call(User* current)
 	}
 }
 
+UserCheckTimer::UserCheckTimer(LocalUser* me) : Timer(0, ServerInstance->Time()), user(me)
+{
+}
+
 /**
- * This function is called once a second from the mainloop.
- * It is intended to do background checking on all the user structs, e.g.
- * stuff like ping checks, registration timeouts, etc.
+ * Does the background checking on a local user, e.g. ping checks and
+ * registration timeouts, then schedules the next check for whichever
+ * deadline comes first. If the user has quit, the timer is not requeued
+ * and the timer manager deletes it.
  */
-void InspIRCd::DoBackgroundUserStuff()
+void UserCheckTimer::Tick(time_t now)
 {
-	/*
-	 * loop over all local users..
-	 */
-	std::vector<LocalUser*>::reverse_iterator count2 = this->Users->local_users.rbegin();
-	while (count2 != this->Users->local_users.rend())
+	LocalUser* curr = user;
+	if (curr->quitting)
 	{
-		LocalUser *curr = *count2;
-		count2++;
-
-		if (curr->quitting)
-			continue;
-
-		if (curr->CommandFloodPenalty || curr->eh.getSendQSize())
-		{
-			unsigned int rate = curr->MyClass->GetCommandRate();
-			if (curr->CommandFloodPenalty > rate)
-				curr->CommandFloodPenalty -= rate;
-			else
-				curr->CommandFloodPenalty = 0;
-			curr->eh.OnDataReady();
-		}
+		curr->checktimer = NULL;
+		return;
+	}
 
-		switch (curr->registered)
-		{
-			case REG_ALL:
-				if (Time() > curr->nping)
-				{
-					// This user didn't answer the last ping, remove them
-					if (!curr->lastping)
-					{
-						time_t time = this->Time() - (curr->nping - curr->MyClass->GetPingTime());
-						char message[MAXBUF];
-						snprintf(message, MAXBUF, "Ping timeout: %ld second%s", (long)time, time > 1 ? "s" : "");
-						curr->lastping = 1;
-						curr->nping = Time() + curr->MyClass->GetPingTime();
-						this->Users->QuitUser(curr, message);
-						continue;
-					}
+	if (curr->CommandFloodPenalty || curr->eh.getSendQSize())
+	{
+		unsigned int rate = curr->MyClass->GetCommandRate();
+		if (curr->CommandFloodPenalty > rate)
+			curr->CommandFloodPenalty -= rate;
+		else
+			curr->CommandFloodPenalty = 0;
+		curr->eh.OnDataReady();
+	}
 
-					curr->Write("PING :%s",this->Config->ServerName.c_str());
-					curr->lastping = 0;
-					curr->nping = Time()  +curr->MyClass->GetPingTime();
-				}
+	switch (curr->registered)
+	{
+		case REG_ALL:
+			if (curr->quitting)
 				break;
-			case REG_NICKUSER:
-				if (AllModulesReportReady(curr) && curr->dns_done)
+			if (now > curr->nping)
+			{
+				// This user didn't answer the last ping, remove them
+				if (!curr->lastping)
 				{
-					/* User has sent NICK/USER, modules are okay, DNS finished. */
-					curr->FullConnect();
-					continue;
+					time_t time = now - (curr->nping - curr->MyClass->GetPingTime());
+					char message[MAXBUF];
+					snprintf(message, MAXBUF, "Ping timeout: %ld second%s", (long)time, time > 1 ? "s" : "");
+					curr->lastping = 1;
+					curr->nping = now + curr->MyClass->GetPingTime();
+					ServerInstance->Users->QuitUser(curr, message);
+					break;
 				}
-				break;
-		}
 
-		if (curr->registered != REG_ALL && (Time() > (curr->age + curr->MyClass->GetRegTimeout())))
-		{
-			/*
-			 * registration timeout -- didnt send USER/NICK/HOST
-			 * in the time specified in their connection class.
-			 */
-			this->Users->QuitUser(curr, "Registration timeout");
-			continue;
-		}
+				curr->Write("PING :%s",ServerInstance->Config->ServerName.c_str());
+				curr->lastping = 0;
+				curr->nping = now + curr->MyClass->GetPingTime();
+			}
+			break;
+		case REG_NICKUSER:
+			if (!curr->quitting && ServerInstance->AllModulesReportReady(curr) && curr->dns_done)
+			{
+				/* User has sent NICK/USER, modules are okay, DNS finished. */
+				curr->FullConnect();
+			}
+			break;
+	}
+
+	if (!curr->quitting && curr->registered != REG_ALL && (now > (curr->age + curr->MyClass->GetRegTimeout())))
+	{
+		/*
+		 * registration timeout -- didnt send USER/NICK/HOST
+		 * in the time specified in their connection class.
+		 */
+		ServerInstance->Users->QuitUser(curr, "Registration timeout");
 	}
-}
 
+	if (curr->quitting)
+	{
+		curr->checktimer = NULL;
+		return;
+	}
+
+	/* Users waiting on modules, or with penalty to decay, are checked again next second */
+	time_t due = (curr->registered == REG_ALL) ? curr->nping : curr->age + curr->MyClass->GetRegTimeout();
+	if (curr->registered == REG_NICKUSER || curr->CommandFloodPenalty || curr->eh.getSendQSize())
+		due = std::min(due, now);
+	SetTimer(due);
+	ServerInstance->Timers->AddTimer(this);
+}
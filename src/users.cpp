@@ -203,6 +203,7 @@ User::User(const std::string &uid, const std::string& sid, int type)
 {
 	age = ServerInstance->Time();
 	signon = idle_lastmsg = 0;
+	bangeneration = 0;
 	registered = 0;
 	quietquit = quitting = exempt = dns_done = false;
 	quitting_sendq = false;
@@ -219,10 +220,12 @@ User::User(const std::string &uid, const std::string& sid, int type)
 
 LocalUser::LocalUser(int myfd, irc::sockets::sockaddrs* client, irc::sockets::sockaddrs* servaddr)
 	: User(ServerInstance->GetUID(), ServerInstance->Config->ServerName, USERTYPE_LOCAL), eh(this),
-	bytes_in(0), bytes_out(0), cmds_in(0), cmds_out(0), nping(0), CommandFloodPenalty(0),
-	already_sent(0)
+	bytes_in(0), bytes_out(0), cmds_in(0), cmds_out(0), nping(0), accepted(ServerInstance->Time_ts()),
+	ready_check(false), CommandFloodPenalty(0), already_sent(0)
 {
 	lastping = 0;
+	checktimer = new UserCheckTimer(this);
+	ServerInstance->Timers->AddTimer(checktimer);
 	eh.SetFd(myfd);
 	memcpy(&client_sa, client, sizeof(irc::sockets::sockaddrs));
 	memcpy(&server_sa, servaddr, sizeof(irc::sockets::sockaddrs));
@@ -490,14 +493,25 @@ void UserIOHandler::OnDataReady()
 	if (!user->HasPrivPermission("users/flood/no-fakelag"))
 		penaltymax = user->MyClass->GetPenaltyThreshold() * 1000;
 
+	// Lines are parsed straight out of recvq, and the consumed part is
+	// only discarded once the whole batch has been dealt with
+	std::string line;
+	line.reserve(MAXBUF);
+	std::string::size_type qpos = 0;
 	while (user->CommandFloodPenalty < penaltymax && getSendQSize() < sendqmax)
 	{
-		std::string line;
-		line.reserve(MAXBUF);
-		std::string::size_type qpos = 0;
-		while (qpos < recvq.length())
+		std::string::size_type eol = recvq.find('\n', qpos);
+		if (eol == std::string::npos)
+		{
+			// the recvq ran out before we found a newline
+			break;
+		}
+
+		line.clear();
+		std::string::size_type start = qpos;
+		for (; qpos < eol; qpos++)
 		{
-			char c = recvq[qpos++];
+			char c = recvq[qpos];
 			switch (c)
 			{
 			case '\0':
@@ -505,36 +519,42 @@ void UserIOHandler::OnDataReady()
 				break;
 			case '\r':
 				continue;
-			case '\n':
-				goto eol_found;
 			}
 			if (line.length() < MAXBUF - 2)
 				line.push_back(c);
 		}
-		// if we got here, the recvq ran out before we found a newline
-		return;
-eol_found:
-		// just found a newline. Terminate the string, and pull it out of recvq
-		recvq = recvq.substr(qpos);
+		// skip the newline itself
+		qpos++;
 
 		// TODO should this be moved to when it was inserted in recvq?
-		ServerInstance->stats->statsRecv += qpos;
-		user->bytes_in += qpos;
+		ServerInstance->stats->statsRecv += qpos - start;
+		user->bytes_in += qpos - start;
 		user->cmds_in++;
 
+		if (ServerInstance->Capture->IsActive())
+			ServerInstance->Capture->AddLine(user, line);
+
 		ServerInstance->Parser->ProcessBuffer(line, user);
 		if (user->quitting)
 			return;
 	}
+	recvq.erase(0, qpos);
 	if (user->CommandFloodPenalty >= penaltymax && !user->MyClass->fakelag)
 		ServerInstance->Users->QuitUser(user, "Excess Flood");
+	else if (user->CommandFloodPenalty || getSendQSize())
+		user->ScheduleCheck(ServerInstance->Time());
 }
 
 void UserIOHandler::AddWriteBuf(const std::string &data)
+{
+	AddWriteBuf(reference<SharedBuffer>(new SharedBuffer(data)));
+}
+
+void UserIOHandler::AddWriteBuf(SharedBuffer* data)
 {
 	if (user->quitting_sendq)
 		return;
-	if (!user->quitting && getSendQSize() + data.length() > user->MyClass->GetSendqHardMax() &&
+	if (!user->quitting && getSendQSize() + data->data.length() > user->MyClass->GetSendqHardMax() &&
 		!user->HasPrivPermission("users/flood/increased-buffers"))
 	{
 		user->quitting_sendq = true;
@@ -545,7 +565,31 @@ void UserIOHandler::AddWriteBuf(const std::string &data)
 	// We still want to append data to the sendq of a quitting user,
 	// e.g. their ERROR message that says 'closing link'
 
-	WriteData(data);
+	if (conn)
+		ServerInstance->IOThreads->Write(conn, data->data);
+	else
+		WriteData(data);
+}
+
+void UserIOHandler::OnThreadData(const std::string& data)
+{
+	recvq.append(data);
+	OnDataReady();
+	CompactRecvQ();
+}
+
+size_t UserIOHandler::getSendQSize() const
+{
+	if (conn)
+		return conn->sendq_len;
+	return StreamSocket::getSendQSize();
+}
+
+void UserIOHandler::Close()
+{
+	if (ServerInstance->IOThreads && ServerInstance->IOThreads->Close(this))
+		return;
+	StreamSocket::Close();
 }
 
 void UserIOHandler::OnError(BufferedSocketError)
@@ -575,6 +619,14 @@ CullResult LocalUser::cull()
 	else
 		ServerInstance->Logs->Log("USERS", DEBUG, "Failed to remove user from vector");
 
+	if (ready_check)
+		ServerInstance->Users->CancelReadyCheck(this);
+	if (checktimer)
+	{
+		ServerInstance->Timers->DelTimer(checktimer);
+		checktimer = NULL;
+	}
+
 	eh.cull();
 	return User::cull();
 }
@@ -801,6 +853,8 @@ void LocalUser::FullConnect()
 	if (quitting)
 		return;
 
+	ServerInstance->stats->statsRegTime.Add(accepted, ServerInstance->Time_ts());
+
 	this->WriteServ("NOTICE Auth :Welcome to \002%s\002!",ServerInstance->Config->Network.c_str());
 	this->WriteNumeric(RPL_WELCOME, "%s :Welcome to the %s IRC Network %s!%s@%s",this->nick.c_str(), ServerInstance->Config->Network.c_str(), this->nick.c_str(), this->ident.c_str(), this->host.c_str());
 	this->WriteNumeric(RPL_YOURHOSTIS, "%s :Your host is %s, running version InspIRCd-2.0",this->nick.c_str(),ServerInstance->Config->ServerName.c_str());
@@ -847,6 +901,20 @@ void LocalUser::FullConnect()
 	ServerInstance->BanCache->AddHit(this->GetIPString(), "", "");
 	// reset the flood penalty (which could have been raised due to things like auto +x)
 	CommandFloodPenalty = 0;
+	ScheduleCheck(nping);
+
+	// From here on, plaintext connections can be serviced by an I/O thread
+	if (ServerInstance->IOThreads && !eh.GetIOHook())
+		ServerInstance->IOThreads->Attach(&eh);
+}
+
+void LocalUser::ScheduleCheck(time_t when)
+{
+	if (checktimer && when < checktimer->GetTimer())
+	{
+		checktimer->SetTimer(when);
+		ServerInstance->Timers->AddTimer(checktimer);
+	}
 }
 
 void User::InvalidateCache()
@@ -856,6 +924,15 @@ void User::InvalidateCache()
 	cached_hostip.clear();
 	cached_makehost.clear();
 	cached_fullrealhost.clear();
+	bangeneration++;
+}
+
+size_t User::GetStringMemory() const
+{
+	return MemoryReport::StringSize(cached_fullhost) + MemoryReport::StringSize(cached_hostip) +
+		MemoryReport::StringSize(cached_makehost) + MemoryReport::StringSize(cached_fullrealhost) +
+		MemoryReport::StringSize(cachedip) + MemoryReport::StringSize(nick) + MemoryReport::StringSize(uuid) +
+		MemoryReport::StringSize(fullname) + MemoryReport::StringSize(awaymsg);
 }
 
 bool User::ChangeNick(const std::string& newnick, bool force)
@@ -1024,26 +1101,59 @@ void User::Write(const char *text, ...)
 {
 }
 
+reference<SharedBuffer> LocalUser::MakeLine(const std::string& text)
+{
+	if (text.length() > MAXBUF - 2)
+	{
+		// this should happen rarely or never. Crop the string at 512.
+		return new SharedBuffer(text.substr(0, MAXBUF - 2), wide_newline);
+	}
+	return new SharedBuffer(text, wide_newline);
+}
+
 void LocalUser::Write(const std::string& text)
 {
 	if (!ServerInstance->SE->BoundsCheckFd(&eh))
 		return;
 
-	if (text.length() > MAXBUF - 2)
+	this->Write(MakeLine(text));
+}
+
+void LocalUser::Write(SharedBuffer* line)
+{
+	if (!ServerInstance->SE->BoundsCheckFd(&eh))
+		return;
+
+	const std::string& text = line->data;
+	ServerInstance->Logs->Log("USEROUTPUT", RAWIO, "C[%s] O %.*s", uuid.c_str(), (int)text.length() - 2, text.c_str());
+
+	eh.AddWriteBuf(line);
+
+	ServerInstance->stats->statsSent += text.length();
+	this->bytes_out += text.length();
+	this->cmds_out++;
+}
+
+void LocalUser::Write(const std::string& prefix, SharedBuffer* tail)
+{
+	const std::string& text = tail->data;
+	if (prefix.length() + text.length() > MAXBUF)
 	{
-		// this should happen rarely or never. Crop the string at 512 and try again.
-		std::string try_again = text.substr(0, MAXBUF - 2);
-		Write(try_again);
+		// Too long to send as two parts, let Write() crop the whole line
+		this->Write(prefix + text.substr(0, text.length() - 2));
 		return;
 	}
 
-	ServerInstance->Logs->Log("USEROUTPUT", RAWIO, "C[%s] O %s", uuid.c_str(), text.c_str());
+	if (!ServerInstance->SE->BoundsCheckFd(&eh))
+		return;
+
+	ServerInstance->Logs->Log("USEROUTPUT", RAWIO, "C[%s] O %s%.*s", uuid.c_str(), prefix.c_str(), (int)text.length() - 2, text.c_str());
 
-	eh.AddWriteBuf(text);
-	eh.AddWriteBuf(wide_newline);
+	eh.AddWriteBuf(prefix);
+	eh.AddWriteBuf(tail);
 
-	ServerInstance->stats->statsSent += text.length() + 2;
-	this->bytes_out += text.length() + 2;
+	ServerInstance->stats->statsSent += prefix.length() + text.length();
+	this->bytes_out += prefix.length() + text.length();
 	this->cmds_out++;
 }
 
@@ -1200,6 +1310,8 @@ void User::WriteCommonRaw(const std::string &line, bool include_self)
 
 	FOREACH_MOD(I_OnBuildNeighborList,OnBuildNeighborList(this, include_c, exceptions));
 
+	reference<SharedBuffer> out = LocalUser::MakeLine(line);
+
 	for (std::map<User*,bool>::iterator i = exceptions.begin(); i != exceptions.end(); ++i)
 	{
 		LocalUser* u = IS_LOCAL(i->first);
@@ -1207,7 +1319,7 @@ void User::WriteCommonRaw(const std::string &line, bool include_self)
 		{
 			u->already_sent = LocalUser::already_sent_id;
 			if (i->second)
-				u->Write(line);
+				u->Write(out);
 		}
 	}
 	for (UCListIter v = include_c.begin(); v != include_c.end(); ++v)
@@ -1220,7 +1332,7 @@ void User::WriteCommonRaw(const std::string &line, bool include_self)
 			if (u && !u->quitting && u->already_sent != LocalUser::already_sent_id)
 			{
 				u->already_sent = LocalUser::already_sent_id;
-				u->Write(line);
+				u->Write(out);
 			}
 		}
 	}
@@ -1238,8 +1350,8 @@ void User::WriteCommonQuit(const std::string &normal_text, const std::string &op
 
 	snprintf(tb1,MAXBUF,":%s QUIT :%s",this->GetFullHost().c_str(),normal_text.c_str());
 	snprintf(tb2,MAXBUF,":%s QUIT :%s",this->GetFullHost().c_str(),oper_text.c_str());
-	std::string out1 = tb1;
-	std::string out2 = tb2;
+	reference<SharedBuffer> out1 = LocalUser::MakeLine(tb1);
+	reference<SharedBuffer> out2 = LocalUser::MakeLine(tb2);
 
 	UserChanList include_c(chans);
 	std::map<User*,bool> exceptions;
@@ -1328,7 +1440,7 @@ void User::SendText(const std::string &LinePrefix, std::stringstream &TextStream
  * the first users channels then the second users channels within the outer loop,
  * therefore it was a maximum of x*y iterations (upon returning 0 and checking
  * all possible iterations). However this new function instead checks against the
- * channel's userlist in the inner loop which is a std::map<User*,User*>
+ * channel's userlist in the inner loop which is indexed by User*
  * and saves us time as we already know what pointer value we are after.
  * Don't quote me on the maths as i am not a mathematician or computer scientist,
  * but i believe this algorithm is now x+(log y) maximum iterations instead.
@@ -1660,6 +1772,15 @@ void LocalUser::SetClass(const std::string &explicit_name)
 	if (found)
 	{
 		MyClass = found;
+
+		/* The new class may ping more often or time registration out sooner */
+		if (registered == REG_ALL)
+		{
+			nping = std::min(nping, ServerInstance->Time() + MyClass->GetPingTime());
+			ScheduleCheck(nping);
+		}
+		else
+			ScheduleCheck(age + MyClass->GetRegTimeout());
 	}
 }
 
@@ -546,7 +546,7 @@ void XLine::DefaultApply(User* u, const std::string &line, bool bancache)
 
 	if (bancache)
 	{
-		ServerInstance->Logs->Log("BANCACHE", DEBUG, std::string("BanCache: Adding positive hit (") + line + ") for " + u->GetIPString());
+		ServerInstance->Logs->Log("BANCACHE", DEBUG, "BanCache: Adding positive hit (%s) for %s", line.c_str(), u->GetIPString());
 		if (this->duration > 0)
 			ServerInstance->BanCache->AddHit(u->GetIPString(), this->type, line + "-Lined: " + this->reason, this->duration);
 		else
@@ -559,16 +559,7 @@ bool KLine::Matches(User *u)
 	if (u->exempt)
 		return false;
 
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
-	{
-		if (InspIRCd::MatchCIDR(u->host, this->hostmask, ascii_case_insensitive_map) ||
-		    InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return mask.ident.Match(u->ident, ascii_case_insensitive_map) && mask.MatchesHost(u, ascii_case_insensitive_map);
 }
 
 void KLine::Apply(User* u)
@@ -581,16 +572,7 @@ bool GLine::Matches(User *u)
 	if (u->exempt)
 		return false;
 
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
-	{
-		if (InspIRCd::MatchCIDR(u->host, this->hostmask, ascii_case_insensitive_map) ||
-		    InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return mask.ident.Match(u->ident, ascii_case_insensitive_map) && mask.MatchesHost(u, ascii_case_insensitive_map);
 }
 
 void GLine::Apply(User* u)
@@ -603,16 +585,7 @@ bool ELine::Matches(User *u)
 	if (u->exempt)
 		return false;
 
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
-	{
-		if (InspIRCd::MatchCIDR(u->host, this->hostmask, ascii_case_insensitive_map) ||
-		    InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return mask.ident.Match(u->ident, ascii_case_insensitive_map) && mask.MatchesHost(u, ascii_case_insensitive_map);
 }
 
 bool ZLine::Matches(User *u)
@@ -620,10 +593,7 @@ bool ZLine::Matches(User *u)
 	if (u->exempt)
 		return false;
 
-	if (InspIRCd::MatchCIDR(u->GetIPString(), this->ipaddr))
-		return true;
-	else
-		return false;
+	return mask.MatchesIP(u->GetIPString(), u->client_sa, national_case_insensitive_map);
 }
 
 void ZLine::Apply(User* u)
@@ -634,10 +604,7 @@ void ZLine::Apply(User* u)
 
 bool QLine::Matches(User *u)
 {
-	if (InspIRCd::Match(u->nick, this->nick))
-		return true;
-
-	return false;
+	return nickpattern.Match(u->nick, national_case_insensitive_map);
 }
 
 void QLine::Apply(User* u)
@@ -649,18 +616,14 @@ void QLine::Apply(User* u)
 
 bool ZLine::Matches(const std::string &str)
 {
-	if (InspIRCd::MatchCIDR(str, this->ipaddr))
-		return true;
-	else
-		return false;
+	irc::sockets::sockaddrs sa;
+	irc::sockets::aptosa(str, 0, sa);
+	return mask.MatchesIP(str.c_str(), sa, national_case_insensitive_map);
 }
 
 bool QLine::Matches(const std::string &str)
 {
-	if (InspIRCd::Match(str, this->nick))
-		return true;
-
-	return false;
+	return nickpattern.Match(str, national_case_insensitive_map);
 }
 
 bool ELine::Matches(const std::string &str)
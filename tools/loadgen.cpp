@@ -0,0 +1,788 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Synthetic client load generator for a locally running server (Linux only).
+ *
+ * Build it with:
+ *	g++ -O2 -o loadgen tools/loadgen.cpp
+ *
+ * It opens --clients non-blocking connections, registers them, joins each to
+ * --joins of --channels channels, and then has each client do something every
+ * --interval milliseconds (with jitter). What it does is picked at random from
+ * --mix, a list of weighted actions:
+ *	chat      PRIVMSG one of its channels
+ *	joinpart  PART one of its channels and JOIN another
+ *	nick      change nick
+ *	who       WHO one of its channels
+ *	list      LIST
+ *	reconnect QUIT and connect again
+ * Every action is followed by a PING; the time until the matching PONG is the
+ * action's round trip time. Chat messages carry the time they were sent, so
+ * other clients can measure how long they took to be delivered.
+ *
+ * Given --oper, a separate client opers up and reads /STATS T before and
+ * after the run, to report the server's own view of the load.
+ *
+ * The server's connect class for the load generator should allow enough
+ * clients per IP (localmax, globalmax), a high commandrate or fakelag="no",
+ * and a large enough sendq for WHO and LIST storms. With more than about
+ * 25000 clients, use --sources to connect from several loopback addresses
+ * so that the local ports do not run out.
+ */
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <queue>
+#include <algorithm>
+
+/** Microseconds on the monotonic clock */
+static long long Now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** The actions a client can take */
+enum Action { ACT_CHAT, ACT_JOINPART, ACT_NICK, ACT_WHO, ACT_LIST, ACT_RECONNECT, ACT_COUNT };
+
+static const char* const ActionNames[ACT_COUNT] = { "chat", "joinpart", "nick", "who", "list", "reconnect" };
+
+/** A set of latency samples, in microseconds */
+class Samples
+{
+	std::vector<long long> values;
+	bool sorted;
+
+ public:
+	Samples() : sorted(true) { }
+
+	void Add(long long usecs)
+	{
+		values.push_back(usecs);
+		sorted = false;
+	}
+
+	size_t Count() const { return values.size(); }
+
+	long long Percentile(double percent)
+	{
+		if (values.empty())
+			return 0;
+		if (!sorted)
+		{
+			std::sort(values.begin(), values.end());
+			sorted = true;
+		}
+		size_t index = (size_t)(percent / 100.0 * (values.size() - 1) + 0.5);
+		return values[index];
+	}
+
+	static std::string Format(long long usecs)
+	{
+		char buf[32];
+		if (usecs < 1000)
+			snprintf(buf, sizeof(buf), "%lldus", usecs);
+		else if (usecs < 1000000)
+			snprintf(buf, sizeof(buf), "%.2fms", usecs / 1000.0);
+		else
+			snprintf(buf, sizeof(buf), "%.2fs", usecs / 1000000.0);
+		return buf;
+	}
+
+	std::string Summary()
+	{
+		char buf[256];
+		snprintf(buf, sizeof(buf), "count %lu p50 %s p90 %s p99 %s p99.9 %s max %s", (unsigned long)values.size(),
+			Format(Percentile(50)).c_str(), Format(Percentile(90)).c_str(), Format(Percentile(99)).c_str(),
+			Format(Percentile(99.9)).c_str(), Format(Percentile(100)).c_str());
+		return buf;
+	}
+};
+
+/** Settings, from the command line */
+struct Settings
+{
+	std::string host;
+	int port;
+	unsigned int clients;
+	unsigned int connectrate;
+	unsigned int sources;
+	unsigned int channels;
+	unsigned int joins;
+	unsigned int interval;
+	unsigned int duration;
+	unsigned int msglen;
+	unsigned int weights[ACT_COUNT];
+	std::string oper;
+
+	Settings() : host("127.0.0.1"), port(6667), clients(1000), connectrate(1000), sources(1), channels(100),
+		joins(2), interval(10000), duration(60), msglen(100)
+	{
+		unsigned int defaults[ACT_COUNT] = { 70, 10, 5, 5, 1, 1 };
+		for (int i = 0; i < ACT_COUNT; i++)
+			weights[i] = defaults[i];
+	}
+};
+
+static Settings settings;
+
+/** The results of a run */
+struct Results
+{
+	unsigned long connects;
+	unsigned long registered;
+	unsigned long failed;
+	unsigned long dropped;
+	unsigned long actions[ACT_COUNT];
+	unsigned long delivered;
+	unsigned long long bytesin;
+	unsigned long long bytesout;
+	Samples regtime;
+	Samples rtt[ACT_COUNT];
+	Samples delivery;
+
+	Results() : connects(0), registered(0), failed(0), dropped(0), delivered(0), bytesin(0), bytesout(0)
+	{
+		for (int i = 0; i < ACT_COUNT; i++)
+			actions[i] = 0;
+	}
+};
+
+static Results results;
+
+/** One simulated client */
+class Client
+{
+ public:
+	enum State { IDLE, CONNECTING, REGISTERING, READY };
+
+	unsigned int id;
+	int fd;
+	State state;
+	std::string nick;
+	unsigned int nickgen;
+	std::string inbuf;
+	std::string outbuf;
+	bool wantwrite;
+	long long started;
+	/** Actions waiting for their PONG, and when they were sent */
+	std::deque<std::pair<Action, long long> > pending;
+	std::vector<unsigned int> chans;
+	/** Set when the client quit on purpose, so the close is not counted as a drop */
+	bool quitting;
+	/** Monitor client: collects STATS replies instead of acting */
+	bool monitor;
+	std::vector<std::string> statslines;
+	bool statsdone;
+
+	Client(unsigned int Id) : id(Id), fd(-1), state(IDLE), nickgen(0), wantwrite(false), started(0), quitting(false),
+		monitor(false), statsdone(false)
+	{
+	}
+
+	void MakeNick()
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u_%u", monitor ? "lgmon" : "lg", id, nickgen++);
+		nick = buf;
+	}
+};
+
+static std::vector<Client*> clients;
+static int epfd;
+static volatile sig_atomic_t interrupted = 0;
+
+/** Scheduled client events: (time, client id) */
+typedef std::pair<long long, unsigned int> Event;
+static std::priority_queue<Event, std::vector<Event>, std::greater<Event> > schedule;
+
+static void Schedule(Client* c, long long when)
+{
+	schedule.push(Event(when, c->id));
+}
+
+static long long Jitter(long long usecs)
+{
+	return usecs / 2 + (long long)(rand() / (RAND_MAX + 1.0) * usecs);
+}
+
+static void UpdateEvents(Client* c)
+{
+	bool want = !c->outbuf.empty();
+	if (want == c->wantwrite)
+		return;
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	ev.data.u32 = c->id;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->wantwrite = want;
+}
+
+static void Flush(Client* c)
+{
+	while (!c->outbuf.empty())
+	{
+		ssize_t n = send(c->fd, c->outbuf.data(), c->outbuf.length(), MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		results.bytesout += n;
+		c->outbuf.erase(0, n);
+	}
+	UpdateEvents(c);
+}
+
+static void Send(Client* c, const std::string& line)
+{
+	c->outbuf.append(line).append("\r\n");
+}
+
+static void Close(Client* c, bool reconnect)
+{
+	if (c->fd >= 0)
+	{
+		epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+		close(c->fd);
+	}
+	if (c->state != Client::IDLE && !c->quitting && !c->monitor)
+		results.dropped++;
+	c->fd = -1;
+	c->state = Client::IDLE;
+	c->inbuf.clear();
+	c->outbuf.clear();
+	c->pending.clear();
+	c->chans.clear();
+	c->wantwrite = false;
+	c->quitting = false;
+	if (reconnect)
+		Schedule(c, Now());
+}
+
+static void Connect(Client* c)
+{
+	c->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (c->fd < 0)
+	{
+		results.failed++;
+		return;
+	}
+	fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (settings.sources > 1)
+	{
+		sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(0x7F000001 + c->id % settings.sources);
+		bind(c->fd, (sockaddr*)&local, sizeof(local));
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(settings.port);
+	inet_pton(AF_INET, settings.host.c_str(), &addr.sin_addr);
+	if (connect(c->fd, (sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+	{
+		close(c->fd);
+		c->fd = -1;
+		results.failed++;
+		return;
+	}
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT;
+	ev.data.u32 = c->id;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+	c->wantwrite = true;
+	c->state = Client::CONNECTING;
+	c->started = Now();
+	results.connects++;
+
+	c->MakeNick();
+	Send(c, "NICK " + c->nick);
+	Send(c, "USER lg 0 * :load generator");
+}
+
+static std::string ChannelName(unsigned int chan)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "#lg%u", chan);
+	return buf;
+}
+
+static void Ping(Client* c, Action act)
+{
+	c->pending.push_back(std::make_pair(act, Now()));
+	Send(c, "PING :lg");
+}
+
+static Action PickAction()
+{
+	unsigned int total = 0;
+	for (int i = 0; i < ACT_COUNT; i++)
+		total += settings.weights[i];
+	unsigned int pick = rand() % total;
+	for (int i = 0; i < ACT_COUNT; i++)
+	{
+		if (pick < settings.weights[i])
+			return (Action)i;
+		pick -= settings.weights[i];
+	}
+	return ACT_CHAT;
+}
+
+static void DoAction(Client* c)
+{
+	Action act = PickAction();
+	if (c->chans.empty() && (act == ACT_CHAT || act == ACT_JOINPART || act == ACT_WHO))
+		act = ACT_NICK;
+
+	results.actions[act]++;
+	switch (act)
+	{
+		case ACT_CHAT:
+		{
+			char buf[64];
+			snprintf(buf, sizeof(buf), " :lg %lld ", Now());
+			std::string line = "PRIVMSG " + ChannelName(c->chans[rand() % c->chans.size()]) + buf;
+			if (line.length() < settings.msglen)
+				line.append(settings.msglen - line.length(), 'x');
+			Send(c, line);
+		}
+		break;
+		case ACT_JOINPART:
+		{
+			unsigned int index = rand() % c->chans.size();
+			Send(c, "PART " + ChannelName(c->chans[index]));
+			c->chans[index] = rand() % settings.channels;
+			Send(c, "JOIN " + ChannelName(c->chans[index]));
+		}
+		break;
+		case ACT_NICK:
+			c->MakeNick();
+			Send(c, "NICK " + c->nick);
+		break;
+		case ACT_WHO:
+			Send(c, "WHO " + ChannelName(c->chans[rand() % c->chans.size()]));
+		break;
+		case ACT_LIST:
+			Send(c, "LIST");
+		break;
+		case ACT_RECONNECT:
+			c->quitting = true;
+			Send(c, "QUIT :reconnecting");
+			Flush(c);
+			Close(c, true);
+		return;
+		default:
+		break;
+	}
+	Ping(c, act);
+	Flush(c);
+	Schedule(c, Now() + Jitter((long long)settings.interval * 1000));
+}
+
+static void OnRegistered(Client* c)
+{
+	c->state = Client::READY;
+	results.registered++;
+	results.regtime.Add(Now() - c->started);
+
+	if (c->monitor)
+	{
+		if (!settings.oper.empty())
+		{
+			std::string::size_type colon = settings.oper.find(':');
+			Send(c, "OPER " + settings.oper.substr(0, colon) + " " + (colon == std::string::npos ? "" : settings.oper.substr(colon + 1)));
+		}
+		Send(c, "STATS T");
+		return;
+	}
+
+	for (unsigned int i = 0; i < settings.joins && i < settings.channels; i++)
+	{
+		unsigned int chan = rand() % settings.channels;
+		c->chans.push_back(chan);
+		Send(c, "JOIN " + ChannelName(chan));
+	}
+	Schedule(c, Now() + Jitter((long long)settings.interval * 1000));
+}
+
+static void OnLine(Client* c, const std::string& line)
+{
+	/* Split off the prefix and command */
+	std::string::size_type pos = 0;
+	if (line[0] == ':')
+	{
+		pos = line.find(' ');
+		if (pos == std::string::npos)
+			return;
+		pos++;
+	}
+	std::string::size_type end = line.find(' ', pos);
+	std::string command = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+
+	if (command == "PING")
+	{
+		Send(c, "PONG" + line.substr(pos + 4));
+	}
+	else if (command == "PONG")
+	{
+		if (!c->pending.empty())
+		{
+			results.rtt[c->pending.front().first].Add(Now() - c->pending.front().second);
+			c->pending.pop_front();
+		}
+	}
+	else if (command == "PRIVMSG")
+	{
+		std::string::size_type text = line.find(" :lg ");
+		if (text != std::string::npos)
+		{
+			results.delivered++;
+			results.delivery.Add(Now() - atoll(line.c_str() + text + 5));
+		}
+	}
+	else if (command == "001")
+	{
+		OnRegistered(c);
+	}
+	else if (command == "433" && c->state != Client::READY)
+	{
+		c->MakeNick();
+		Send(c, "NICK " + c->nick);
+	}
+	else if (command == "249" && c->monitor)
+	{
+		std::string::size_type text = line.find(" :", end);
+		if (text != std::string::npos)
+			c->statslines.push_back(line.substr(text + 2));
+	}
+	else if (command == "219" && c->monitor)
+	{
+		c->statsdone = true;
+	}
+}
+
+static void OnReadable(Client* c)
+{
+	char buf[65536];
+	while (true)
+	{
+		ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+		{
+			/* Dropped by the server; wait a moment before trying again */
+			Close(c, false);
+			if (!c->monitor)
+				Schedule(c, Now() + 1000000);
+			return;
+		}
+		if (n < 0)
+			break;
+		results.bytesin += n;
+		c->inbuf.append(buf, n);
+	}
+
+	std::string::size_type start = 0;
+	while (true)
+	{
+		std::string::size_type eol = c->inbuf.find('\n', start);
+		if (eol == std::string::npos)
+			break;
+		std::string::size_type len = eol - start;
+		if (len && c->inbuf[eol - 1] == '\r')
+			len--;
+		if (len)
+			OnLine(c, c->inbuf.substr(start, len));
+		start = eol + 1;
+	}
+	c->inbuf.erase(0, start);
+	Flush(c);
+}
+
+/** Run the event loop until a time, or until a condition on the monitor is met */
+static void RunUntil(long long until, Client* waitstats)
+{
+	epoll_event events[1024];
+	while (!interrupted && Now() < until)
+	{
+		if (waitstats && waitstats->statsdone)
+			return;
+
+		long long now = Now();
+		while (!schedule.empty() && schedule.top().first <= now)
+		{
+			Client* c = clients[schedule.top().second];
+			schedule.pop();
+			if (c->state == Client::IDLE)
+				Connect(c);
+			else if (c->state == Client::READY)
+				DoAction(c);
+		}
+
+		int timeout = 100;
+		if (!schedule.empty())
+			timeout = std::max(0LL, std::min(100LL, (schedule.top().first - Now()) / 1000));
+		int n = epoll_wait(epfd, events, 1024, timeout);
+		for (int i = 0; i < n; i++)
+		{
+			Client* c = clients[events[i].data.u32];
+			if (c->fd < 0)
+				continue;
+			if (c->state == Client::CONNECTING && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+			{
+				int err = 0;
+				socklen_t len = sizeof(err);
+				getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+				if (err)
+				{
+					results.connects--;
+					results.failed++;
+					c->state = Client::IDLE;
+					Close(c, false);
+					Schedule(c, Now() + 1000000);
+					continue;
+				}
+				c->state = Client::REGISTERING;
+			}
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				OnReadable(c);
+			if (c->fd >= 0 && (events[i].events & EPOLLOUT))
+				Flush(c);
+		}
+	}
+}
+
+static void PrintStats(Client* monitor, const char* when)
+{
+	printf("Server /STATS T %s:\n", when);
+	for (std::vector<std::string>::iterator i = monitor->statslines.begin(); i != monitor->statslines.end(); ++i)
+		printf("  %s\n", i->c_str());
+}
+
+/** Read the "bytes sent X recv Y" line of /STATS T, in kilobytes */
+static bool ParseBytes(Client* monitor, double& sent, double& recvd)
+{
+	for (std::vector<std::string>::iterator i = monitor->statslines.begin(); i != monitor->statslines.end(); ++i)
+		if (sscanf(i->c_str(), "bytes sent %lfK recv %lfK", &sent, &recvd) == 2)
+			return true;
+	return false;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "Usage: loadgen [options]\n"
+		"  --host ADDR         server address [127.0.0.1]\n"
+		"  --port PORT         server port [6667]\n"
+		"  --clients N         number of clients [1000]\n"
+		"  --connectrate N     new connections per second [1000]\n"
+		"  --sources N         connect from N loopback addresses, 127.0.0.1 up [1]\n"
+		"  --channels N        number of channels [100]\n"
+		"  --joins N           channels each client joins [2]\n"
+		"  --interval MS       average time between each client's actions [10000]\n"
+		"  --duration S        seconds to run for once all clients are connecting [60]\n"
+		"  --msglen N          length of chat lines [100]\n"
+		"  --mix LIST          action weights, e.g. chat=70,joinpart=10,nick=5,who=5,list=1,reconnect=1\n"
+		"  --oper NAME:PASS    oper up a monitor client to read /STATS T before and after\n");
+	exit(1);
+}
+
+static void ParseMix(const std::string& mix)
+{
+	for (int i = 0; i < ACT_COUNT; i++)
+		settings.weights[i] = 0;
+	std::string::size_type pos = 0;
+	while (pos < mix.length())
+	{
+		std::string::size_type comma = mix.find(',', pos);
+		std::string item = mix.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+		std::string::size_type eq = item.find('=');
+		int act = 0;
+		while (act < ACT_COUNT && item.substr(0, eq) != ActionNames[act])
+			act++;
+		if (act == ACT_COUNT || eq == std::string::npos)
+		{
+			fprintf(stderr, "Unknown action in --mix: %s\n", item.c_str());
+			exit(1);
+		}
+		settings.weights[act] = atoi(item.c_str() + eq + 1);
+		if (comma == std::string::npos)
+			break;
+		pos = comma + 1;
+	}
+	unsigned int total = 0;
+	for (int i = 0; i < ACT_COUNT; i++)
+		total += settings.weights[i];
+	if (!total)
+	{
+		fprintf(stderr, "--mix must give at least one action a weight\n");
+		exit(1);
+	}
+}
+
+static void OnSignal(int)
+{
+	interrupted = 1;
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string opt = argv[i];
+		if (i + 1 >= argc)
+			Usage();
+		std::string val = argv[++i];
+		if (opt == "--host")
+			settings.host = val;
+		else if (opt == "--port")
+			settings.port = atoi(val.c_str());
+		else if (opt == "--clients")
+			settings.clients = atoi(val.c_str());
+		else if (opt == "--connectrate")
+			settings.connectrate = std::max(1, atoi(val.c_str()));
+		else if (opt == "--sources")
+			settings.sources = std::max(1, std::min(254, atoi(val.c_str())));
+		else if (opt == "--channels")
+			settings.channels = std::max(1, atoi(val.c_str()));
+		else if (opt == "--joins")
+			settings.joins = atoi(val.c_str());
+		else if (opt == "--interval")
+			settings.interval = std::max(1, atoi(val.c_str()));
+		else if (opt == "--duration")
+			settings.duration = atoi(val.c_str());
+		else if (opt == "--msglen")
+			settings.msglen = atoi(val.c_str());
+		else if (opt == "--mix")
+			ParseMix(val);
+		else if (opt == "--oper")
+			settings.oper = val;
+		else
+			Usage();
+	}
+
+	rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	if (rl.rlim_cur < settings.clients + 100)
+	{
+		rl.rlim_cur = std::min<rlim_t>(rl.rlim_max, settings.clients + 100);
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if (rl.rlim_cur < settings.clients + 100)
+			fprintf(stderr, "Warning: only %lu file descriptors are available\n", (unsigned long)rl.rlim_cur);
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGPIPE, SIG_IGN);
+	srand(getpid());
+	epfd = epoll_create(1024);
+
+	/* The monitor goes last, so client ids stay equal to their index */
+	for (unsigned int i = 0; i <= settings.clients; i++)
+		clients.push_back(new Client(i));
+	Client* monitor = clients[settings.clients];
+	monitor->monitor = true;
+
+	if (!settings.oper.empty())
+	{
+		Connect(monitor);
+		RunUntil(Now() + 10000000, monitor);
+		if (!monitor->statsdone)
+			fprintf(stderr, "Warning: the monitor client did not get a /STATS T reply\n");
+		PrintStats(monitor, "before");
+	}
+	double sentbefore = 0, recvbefore = 0;
+	bool havebefore = ParseBytes(monitor, sentbefore, recvbefore);
+
+	long long start = Now();
+	unsigned long long inbefore = results.bytesin;
+	unsigned long long outbefore = results.bytesout;
+	for (unsigned int i = 0; i < settings.clients; i++)
+		Schedule(clients[i], start + (long long)i * 1000000 / settings.connectrate);
+
+	/* Report progress once a second */
+	long long rampup = (long long)settings.clients * 1000000 / settings.connectrate;
+	long long finish = start + rampup + (long long)settings.duration * 1000000;
+	unsigned long lastactions = 0;
+	while (!interrupted && Now() < finish)
+	{
+		RunUntil(std::min(finish, Now() + 1000000), NULL);
+		unsigned long actions = 0;
+		for (int i = 0; i < ACT_COUNT; i++)
+			actions += results.actions[i];
+		printf("%5.1fs: connects %lu registered %lu failed %lu dropped %lu actions/s %lu delivered %lu\n",
+			(Now() - start) / 1000000.0, results.connects, results.registered, results.failed, results.dropped,
+			actions - lastactions, results.delivered);
+		fflush(stdout);
+		lastactions = actions;
+	}
+	double elapsed = (Now() - start) / 1000000.0;
+
+	printf("\nRan %u clients for %.1fs (%u channels, %u joins each, one action per %ums each)\n",
+		settings.clients, elapsed, settings.channels, settings.joins, settings.interval);
+	printf("Connections: %lu made, %lu failed, %lu dropped by the server\n", results.connects, results.failed, results.dropped);
+	printf("Client traffic: %.1f KB/s in, %.1f KB/s out\n", (results.bytesin - inbefore) / 1024.0 / elapsed,
+		(results.bytesout - outbefore) / 1024.0 / elapsed);
+	printf("Registration time: %s\n", results.regtime.Summary().c_str());
+	for (int i = 0; i < ACT_COUNT; i++)
+	{
+		if (!results.actions[i])
+			continue;
+		if (i == ACT_RECONNECT)
+			printf("%-10s %8lu actions\n", ActionNames[i], results.actions[i]);
+		else
+			printf("%-10s %8lu actions, round trip %s\n", ActionNames[i], results.actions[i], results.rtt[i].Summary().c_str());
+	}
+	printf("Chat delivery: %s\n", results.delivery.Summary().c_str());
+
+	if (!settings.oper.empty() && monitor->state == Client::READY)
+	{
+		monitor->statslines.clear();
+		monitor->statsdone = false;
+		Send(monitor, "STATS T");
+		Flush(monitor);
+		RunUntil(Now() + 10000000, monitor);
+		PrintStats(monitor, "after");
+		double sentafter, recvafter;
+		if (havebefore && ParseBytes(monitor, sentafter, recvafter))
+			printf("Server throughput: %.1f KB/s sent, %.1f KB/s received\n", (sentafter - sentbefore) / elapsed,
+				(recvafter - recvbefore) / elapsed);
+	}
+	return 0;
+}
@@ -0,0 +1,607 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Replays client traffic recorded with <performance:capture> against a
+ * test server (Linux only).
+ *
+ * Build it with:
+ *	g++ -O2 -o replay tools/replay.cpp
+ *
+ * Each client in the capture gets its own connection, which sends the lines
+ * that client sent, with the same gaps between them divided by --speed.
+ * --speed 0 sends everything as fast as the server takes it.
+ *
+ * Given --oper, a separate client opers up and reads /STATS M before and
+ * after the replay, to report the time the server spent on each command.
+ * Given --pid, the CPU time used by the server process is reported as well.
+ *
+ * The server's connect class should allow enough clients per IP (localmax,
+ * globalmax) and have fakelag="no", or faster replays will be throttled or
+ * disconnected for flooding. Lines that need a password (PASS, OPER and
+ * AUTHENTICATE) are replayed with "*" in place of it.
+ */
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <strings.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+/** Microseconds on the monotonic clock */
+static long long Now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** One record from the capture file */
+struct Record
+{
+	char type;
+	/** Microseconds since the start of the capture */
+	long long time;
+	unsigned long client;
+	std::string line;
+};
+
+/** A connection to the server */
+struct Connection
+{
+	int fd;
+	bool connected;
+	/** Shut down the sending side once everything queued has been sent, and
+	 * wait for the server to close the connection; closing it straight away
+	 * could discard lines the server has not read yet
+	 */
+	bool closing;
+	/** True once the client has sent QUIT, so the server closing the connection is expected */
+	bool quit;
+	std::string inbuf;
+	std::string outbuf;
+	bool wantwrite;
+
+	Connection() : fd(-1), connected(false), closing(false), quit(false), wantwrite(false) { }
+};
+
+/** Settings, from the command line */
+static std::string host = "127.0.0.1";
+static int port = 6667;
+static double speed = 1;
+static unsigned int sources = 1;
+static std::string oper;
+static int pid = 0;
+
+static int epfd;
+static volatile sig_atomic_t interrupted = 0;
+
+/** Connections by client number; client 0 is the monitor */
+static std::map<unsigned long, Connection*> connections;
+static unsigned long opened = 0;
+static unsigned long dropped = 0;
+static unsigned long long bytesin = 0;
+static unsigned long long bytesout = 0;
+static long long lastinput = 0;
+
+/** Replies to /STATS M read by the monitor, and whether the end of them has been seen */
+static std::vector<std::string> statslines;
+static bool statsdone = false;
+static bool monitorready = false;
+
+static bool ReadNumber(FILE* f, unsigned long& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(f);
+		if (c == EOF)
+			return false;
+		value |= (unsigned long)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static bool ReadCapture(const char* filename, std::vector<Record>& records)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f)
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+		return false;
+	}
+
+	char header[8];
+	if (fread(header, 1, 8, f) != 8 || memcmp(header, "IRCCAP1\n", 8))
+	{
+		fprintf(stderr, "%s is not a traffic capture\n", filename);
+		fclose(f);
+		return false;
+	}
+
+	long long time = 0;
+	while (true)
+	{
+		int type = fgetc(f);
+		if (type == EOF)
+			break;
+
+		Record r;
+		unsigned long delay, length;
+		r.type = type;
+		if ((type != 'L' && type != 'Q') || !ReadNumber(f, delay) || !ReadNumber(f, r.client))
+		{
+			fprintf(stderr, "%s is damaged after %lu records; replaying those\n", filename, (unsigned long)records.size());
+			break;
+		}
+		time += delay;
+		r.time = time;
+		if (type == 'L')
+		{
+			if (!ReadNumber(f, length) || length > 65536)
+				break;
+			r.line.resize(length);
+			if (length && fread(&r.line[0], 1, length, f) != length)
+				break;
+		}
+		records.push_back(r);
+	}
+	fclose(f);
+	return true;
+}
+
+static void UpdateEvents(unsigned long client, Connection* c)
+{
+	bool want = !c->outbuf.empty() || !c->connected;
+	if (want == c->wantwrite)
+		return;
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	ev.data.u64 = client;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->wantwrite = want;
+}
+
+static void Close(unsigned long client)
+{
+	std::map<unsigned long, Connection*>::iterator i = connections.find(client);
+	if (i == connections.end())
+		return;
+	epoll_ctl(epfd, EPOLL_CTL_DEL, i->second->fd, NULL);
+	close(i->second->fd);
+	delete i->second;
+	connections.erase(i);
+}
+
+static void Flush(unsigned long client, Connection* c)
+{
+	if (!c->connected)
+		return;
+	while (!c->outbuf.empty())
+	{
+		ssize_t n = send(c->fd, c->outbuf.data(), c->outbuf.length(), MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		bytesout += n;
+		c->outbuf.erase(0, n);
+	}
+	if (c->closing && c->outbuf.empty())
+		shutdown(c->fd, SHUT_WR);
+	UpdateEvents(client, c);
+}
+
+static Connection* Connect(unsigned long client)
+{
+	Connection* c = new Connection;
+	c->fd = socket(AF_INET, SOCK_STREAM, 0);
+	fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (sources > 1)
+	{
+		sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(0x7F000001 + client % sources);
+		bind(c->fd, (sockaddr*)&local, sizeof(local));
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+	connect(c->fd, (sockaddr*)&addr, sizeof(addr));
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT;
+	ev.data.u64 = client;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+	c->wantwrite = true;
+	connections[client] = c;
+	if (client)
+		opened++;
+	return c;
+}
+
+static void Send(unsigned long client, const std::string& line)
+{
+	Connection* c;
+	std::map<unsigned long, Connection*>::iterator i = connections.find(client);
+	if (i == connections.end())
+		c = Connect(client);
+	else
+		c = i->second;
+	c->outbuf.append(line).append("\r\n");
+	if (line.length() >= 4 && !strncasecmp(line.c_str(), "QUIT", 4))
+		c->quit = true;
+	Flush(client, c);
+}
+
+static void OnMonitorLine(const std::string& line)
+{
+	std::string::size_type space = line.find(' ');
+	if (space == std::string::npos)
+		return;
+	std::string numeric = line.substr(space + 1, 4);
+	if (numeric == "001 ")
+		monitorready = true;
+	else if (numeric == "249 ")
+	{
+		std::string::size_type text = line.find(" :", space);
+		if (text != std::string::npos)
+			statslines.push_back(line.substr(text + 2));
+	}
+	else if (numeric == "219 ")
+		statsdone = true;
+}
+
+static void OnReadable(unsigned long client, Connection* c)
+{
+	char buf[65536];
+	while (true)
+	{
+		ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+		{
+			if (!c->closing && !c->quit && client)
+				dropped++;
+			Close(client);
+			return;
+		}
+		if (n < 0)
+			break;
+		bytesin += n;
+		lastinput = Now();
+		c->inbuf.append(buf, n);
+	}
+
+	/* Only PINGs from the server need answering, and only the monitor cares about anything else */
+	std::string::size_type start = 0;
+	while (true)
+	{
+		std::string::size_type eol = c->inbuf.find('\n', start);
+		if (eol == std::string::npos)
+			break;
+		std::string line = c->inbuf.substr(start, eol - start);
+		if (!line.empty() && line[line.length() - 1] == '\r')
+			line.erase(line.length() - 1);
+		if (line.compare(0, 5, "PING ") == 0)
+			c->outbuf.append("PONG ").append(line, 5, std::string::npos).append("\r\n");
+		else if (!client)
+			OnMonitorLine(line);
+		start = eol + 1;
+	}
+	c->inbuf.erase(0, start);
+	Flush(client, c);
+}
+
+static void Poll(int timeout)
+{
+	epoll_event events[1024];
+	int n = epoll_wait(epfd, events, 1024, timeout);
+	for (int i = 0; i < n; i++)
+	{
+		unsigned long client = events[i].data.u64;
+		std::map<unsigned long, Connection*>::iterator c = connections.find(client);
+		if (c == connections.end())
+			continue;
+		if (!c->second->connected && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+		{
+			int err = 0;
+			socklen_t len = sizeof(err);
+			getsockopt(c->second->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+			if (err)
+			{
+				if (client)
+					dropped++;
+				Close(client);
+				continue;
+			}
+			c->second->connected = true;
+		}
+		if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+		{
+			OnReadable(client, c->second);
+			c = connections.find(client);
+			if (c == connections.end())
+				continue;
+		}
+		if (events[i].events & EPOLLOUT)
+			Flush(client, c->second);
+	}
+}
+
+/** Ask the monitor for /STATS M, and wait for the reply */
+static void ReadStats()
+{
+	statslines.clear();
+	statsdone = false;
+	Send(0, "STATS M");
+	long long until = Now() + 10000000;
+	while (!statsdone && !interrupted && Now() < until && connections.count(0))
+		Poll(100);
+	if (!statsdone)
+		fprintf(stderr, "Warning: the monitor client did not get a /STATS M reply\n");
+}
+
+/** Turn a time from /STATS M, e.g. "512us", "1.5ms" or "12s", back into microseconds */
+static double ParseTime(const std::string& text)
+{
+	char* unit;
+	double value = strtod(text.c_str(), &unit);
+	if (!strcmp(unit, "ms"))
+		return value * 1000;
+	if (!strcmp(unit, "s"))
+		return value * 1000000;
+	return value;
+}
+
+/** Per command figures from /STATS M: name -> (calls, microseconds) */
+typedef std::map<std::string, std::pair<double, double> > CommandStats;
+
+static void ParseStats(CommandStats& stats)
+{
+	for (std::vector<std::string>::iterator i = statslines.begin(); i != statslines.end(); ++i)
+	{
+		char name[64], total[32];
+		double calls, bytes;
+		if (sscanf(i->c_str(), "%63s %lf %lf %31s", name, &calls, &bytes, total) == 4)
+			stats[name] = std::make_pair(calls, ParseTime(total));
+	}
+}
+
+/** CPU time used by the server process, in microseconds, or -1 if it can't be read */
+static double GetCPUTime()
+{
+	char filename[64];
+	snprintf(filename, sizeof(filename), "/proc/%d/stat", pid);
+	FILE* f = fopen(filename, "r");
+	if (!f)
+		return -1;
+	char buf[1024];
+	size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = 0;
+
+	/* utime and stime are the 14th and 15th fields; the 2nd may contain spaces, but ends with ')' */
+	char* p = strrchr(buf, ')');
+	unsigned long utime, stime;
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		return -1;
+	return (utime + stime) * 1000000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static void Usage()
+{
+	fprintf(stderr, "Usage: replay [options] capturefile\n"
+		"  --host ADDR         server address [127.0.0.1]\n"
+		"  --port PORT         server port [6667]\n"
+		"  --speed N           replay N times faster than captured, or 0 for as fast as possible [1]\n"
+		"  --sources N         connect from N loopback addresses, 127.0.0.1 up [1]\n"
+		"  --oper NAME:PASS    oper up a monitor client to read /STATS M before and after\n"
+		"  --pid PID           report the CPU time used by this server process\n");
+	exit(1);
+}
+
+static void OnSignal(int)
+{
+	interrupted = 1;
+}
+
+static bool ByTime(const std::pair<std::string, std::pair<double, double> >& a, const std::pair<std::string, std::pair<double, double> >& b)
+{
+	return a.second.second > b.second.second;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string opt = argv[i];
+		if (opt.compare(0, 2, "--"))
+		{
+			filename = argv[i];
+			continue;
+		}
+		if (i + 1 >= argc)
+			Usage();
+		std::string val = argv[++i];
+		if (opt == "--host")
+			host = val;
+		else if (opt == "--port")
+			port = atoi(val.c_str());
+		else if (opt == "--speed")
+			speed = std::max(0.0, atof(val.c_str()));
+		else if (opt == "--sources")
+			sources = std::max(1, std::min(254, atoi(val.c_str())));
+		else if (opt == "--oper")
+			oper = val;
+		else if (opt == "--pid")
+			pid = atoi(val.c_str());
+		else
+			Usage();
+	}
+	if (!filename)
+		Usage();
+
+	std::vector<Record> records;
+	if (!ReadCapture(filename, records))
+		return 1;
+	if (records.empty())
+	{
+		fprintf(stderr, "%s has nothing in it to replay\n", filename);
+		return 1;
+	}
+
+	rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+	signal(SIGINT, OnSignal);
+	signal(SIGPIPE, SIG_IGN);
+	epfd = epoll_create(1024);
+
+	CommandStats before;
+	if (!oper.empty())
+	{
+		Send(0, "NICK replaymon");
+		Send(0, "USER replay 0 * :replay monitor");
+		long long until = Now() + 10000000;
+		while (!monitorready && !interrupted && Now() < until)
+			Poll(100);
+		std::string::size_type colon = oper.find(':');
+		Send(0, "OPER " + oper.substr(0, colon) + " " + (colon == std::string::npos ? "" : oper.substr(colon + 1)));
+		ReadStats();
+		ParseStats(before);
+	}
+	double cpubefore = pid ? GetCPUTime() : -1;
+
+	/* Send each record when its time comes */
+	unsigned long lines = 0;
+	long long start = Now();
+	long long nextreport = start + 1000000;
+	for (std::vector<Record>::iterator r = records.begin(); r != records.end() && !interrupted; )
+	{
+		long long due = speed > 0 ? start + (long long)(r->time / speed) : 0;
+		long long now = Now();
+		if (due > now)
+		{
+			Poll(std::min(100LL, (due - now) / 1000));
+		}
+		else
+		{
+			/* Send everything that is due, but stop now and then to read from the server */
+			for (int batch = 0; batch < 1000 && r != records.end() && (speed == 0 || start + (long long)(r->time / speed) <= now); batch++, ++r)
+			{
+				if (r->type == 'L')
+				{
+					Send(r->client, r->line);
+					lines++;
+				}
+				else
+				{
+					std::map<unsigned long, Connection*>::iterator c = connections.find(r->client);
+					if (c != connections.end())
+					{
+						c->second->closing = true;
+						Flush(r->client, c->second);
+					}
+				}
+			}
+			Poll(0);
+		}
+
+		if (Now() >= nextreport)
+		{
+			printf("%5.1fs: %lu of %lu records sent, %lu lines, %lu connections open, %lu dropped\n", (Now() - start) / 1000000.0,
+				(unsigned long)(r - records.begin()), (unsigned long)records.size(), lines, (unsigned long)connections.size(), dropped);
+			fflush(stdout);
+			nextreport += 1000000;
+		}
+	}
+	long long sent = Now();
+
+	/* Wait for the server to finish with what it was sent: until it goes quiet for a second */
+	lastinput = Now();
+	while (!interrupted && Now() - lastinput < 1000000 && Now() - sent < 60000000)
+		Poll(100);
+	double elapsed = (lastinput - start) / 1000000.0;
+	double cpuafter = pid ? GetCPUTime() : -1;
+
+	printf("\nReplayed %lu lines from %lu connections, captured over %.1fs, in %.1fs (%.1fx)\n", lines, opened,
+		records.back().time / 1000000.0, elapsed, records.back().time / 1000000.0 / elapsed);
+	printf("Lines sent: %.0f/s; connections dropped by the server: %lu\n", lines / elapsed, dropped);
+	printf("Client traffic: %.1f KB/s in, %.1f KB/s out\n", bytesin / 1024.0 / elapsed, bytesout / 1024.0 / elapsed);
+	if (cpubefore >= 0 && cpuafter >= 0)
+	{
+		double cpu = cpuafter - cpubefore;
+		printf("Server CPU time: %.2fs (%.0f%% of one core), %.1fus per line\n", cpu / 1000000.0, cpu / 10000.0 / elapsed, lines ? cpu / lines : 0);
+	}
+
+	if (!oper.empty() && connections.count(0))
+	{
+		CommandStats after;
+		ReadStats();
+		ParseStats(after);
+
+		/* Show commands by the time the server spent on them during the replay */
+		std::vector<std::pair<std::string, std::pair<double, double> > > deltas;
+		double totaltime = 0;
+		for (CommandStats::iterator i = after.begin(); i != after.end(); ++i)
+		{
+			std::pair<double, double> old = before.count(i->first) ? before[i->first] : std::make_pair(0.0, 0.0);
+			double calls = i->second.first - old.first;
+			if (calls <= 0)
+				continue;
+			deltas.push_back(std::make_pair(i->first, std::make_pair(calls, std::max(0.0, i->second.second - old.second))));
+			totaltime += deltas.back().second.second;
+		}
+		std::sort(deltas.begin(), deltas.end(), ByTime);
+
+		printf("\n%-16s %10s %10s %12s %10s %7s\n", "command", "calls", "calls/s", "time", "per call", "share");
+		for (size_t i = 0; i < deltas.size(); i++)
+		{
+			double calls = deltas[i].second.first;
+			double usecs = deltas[i].second.second;
+			printf("%-16s %10.0f %10.1f %10.1fms %8.1fus %6.1f%%\n", deltas[i].first.c_str(), calls, calls / elapsed,
+				usecs / 1000, usecs / calls, totaltime > 0 ? usecs * 100 / totaltime : 0);
+		}
+		printf("Times are from /STATS M, which rounds them, so small differences are not meaningful.\n");
+	}
+	return 0;
+}
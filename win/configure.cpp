@@ -330,6 +330,7 @@ void Run()
 	fprintf(f, "#define MOD_PATH \"%s\"\n", mod_path.c_str());
 	fprintf(f, "#define SOMAXCONN_S \"128\"\n");
 	fprintf(f, "#define MAXBUF 514\n");
+	fprintf(f, "#define USE_HOOK_PROFILING\n");
 
 	fprintf(f, "\n#include \"inspircd_win32wrapper.h\"");
 	fprintf(f, "\n#include \"inspircd_namedpipe.h\"");